@@ -0,0 +1,244 @@
+/**
+ * CircAdaptive.cpp - Schedule table learned from demand
+ * This file is a part of Water Circulation Pump driver
+ *
+ * Copyright (c) 2017, Rafal Kukla. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the name of the "Rafal Kukla" nor the names of its contributors may be used to endorse or
+ *   promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ */
+
+#include <stddef.h>
+#include <CircAdaptive.h>
+#include <FlashStore.h>
+#include "dbgprofile.h"
+
+static_assert(sizeof(circ_adaptive_page_t) <= FlashStore::SEGMENT_SIZE, "Page must fit flash segment");
+static_assert(DateTime::DAYS_COUNT <= 8, "Learned day types are kept as bits");
+
+const circ_shedule_table_t*   CircAdaptive::default_table;
+const circ_adaptive_config_t* CircAdaptive::config;
+uint8_t                       CircAdaptive::active;
+uint8_t                       CircAdaptive::step = CircAdaptive::IDLE;
+bool                          CircAdaptive::aging;
+uint16_t                      CircAdaptive::pending_offset;
+uint8_t                       CircAdaptive::pending;
+
+#define PAGE_OFFSET(_field_) static_cast<uint16_t>(offsetof(circ_adaptive_page_t, _field_))
+
+// Unary counter: count of cleared bits
+static inline uint8_t getUnaryCount(uint8_t unary)
+{
+    uint8_t count = CIRC_ADAPTIVE_MAX_COUNT;
+    for (; unary; unary >>= 1) count -= unary & 1;
+    return count;
+}
+
+static inline uint8_t getUnary(uint8_t count)
+{
+    return static_cast<uint8_t>(0xFF << count);
+}
+
+const circ_adaptive_page_t* CircAdaptive::getPage(uint8_t segment)
+{
+    return reinterpret_cast<const circ_adaptive_page_t*>(FlashStore::getSegment(segment));
+}
+
+const circ_adaptive_page_t* CircAdaptive::getPage()
+{
+    return getPage(active);
+}
+
+const circ_shedule_table_t* CircAdaptive::getTable()
+{
+    const circ_adaptive_page_t* page = getPage(active);
+    return (page->marker == MARKER) ? &page->table : default_table;
+}
+
+uint8_t CircAdaptive::getCount(uint8_t day, uint8_t bin)
+{
+    uint16_t offset = PAGE_OFFSET(counts) + day * CIRC_ADAPTIVE_BINS + bin;
+    return getUnaryCount(getPage(active)->counts[day][bin]) + ((offset == pending_offset) ? pending : 0);
+}
+
+bool CircAdaptive::format()
+{
+    const uint8_t marker = MARKER;
+    active = 0;
+    return FlashStore::erase(0) &&
+           FlashStore::write(0, PAGE_OFFSET(table), default_table, sizeof(circ_shedule_table_t)) &&
+           FlashStore::write(0, PAGE_OFFSET(marker), &marker, 1);
+}
+
+bool CircAdaptive::begin(const circ_shedule_table_t* table, const circ_adaptive_config_t* adaptive_config)
+{
+    default_table = table;
+    config = adaptive_config;
+    step = IDLE;
+    pending = 0;
+
+    bool valid0 = getPage(0)->marker == MARKER;
+    bool valid1 = getPage(1)->marker == MARKER;
+    if (valid0 && valid1) {
+        active = (static_cast<uint8_t>(getPage(1)->sequence - getPage(0)->sequence) < 0x80) ? 1 : 0;
+    } else if (valid0 || valid1) {
+        active = valid1 ? 1 : 0;
+    } else {
+        return format();
+    }
+    return true;
+}
+
+bool CircAdaptive::record(uint32_t local_time)
+{
+    if (local_time == DateTime::EPOCH_ERROR) return false;
+    dt_time_t time;
+    DateTime::setDateTimeFromEpoch(local_time, nullptr, &time);
+    uint8_t day = DateTime::getDayTypeFromEpoch(local_time);
+    uint8_t bin = CT(time.hour, time.minute, time.second) / CIRC_ADAPTIVE_BIN;
+    uint16_t offset = PAGE_OFFSET(counts) + day * CIRC_ADAPTIVE_BINS + bin;
+
+    if (offset != pending_offset && !flush()) return false;
+    if (getUnaryCount(getPage(active)->counts[day][bin]) + pending >= CIRC_ADAPTIVE_MAX_COUNT) return false;
+    pending_offset = offset;
+    pending++;
+    return true;
+}
+
+bool CircAdaptive::flush()
+{
+    if (!pending) return true;
+    const uint16_t offset = pending_offset;
+    const uint8_t count = pending;
+    pending = 0;
+
+    uint8_t unary = static_cast<uint8_t>(FlashStore::getSegment(active)[offset] << count);
+    if (!FlashStore::write(active, offset, &unary, 1)) return false;
+    // Day type already copied by compaction
+    if (isCompacting() && (offset - PAGE_OFFSET(counts)) / CIRC_ADAPTIVE_BINS < step) {
+        unary = static_cast<uint8_t>(FlashStore::getSegment(active ^ 1)[offset] << count);
+        return FlashStore::write(active ^ 1, offset, &unary, 1);
+    }
+    return true;
+}
+
+bool CircAdaptive::startCompaction()
+{
+    if (isCompacting()) return true;
+    if (!flush() || !FlashStore::erase(active ^ 1)) return false;
+
+    aging = false;
+    const circ_adaptive_page_t* page = getPage(active);
+    for (uint8_t day = 0; day < DateTime::DAYS_COUNT && !aging; day++) {
+        for (uint8_t bin = 0; bin < CIRC_ADAPTIVE_BINS; bin++) {
+            if (!page->counts[day][bin]) aging = true;
+        }
+    }
+    step = 0;
+    return true;
+}
+
+void CircAdaptive::fitDay(const uint8_t counts[CIRC_ADAPTIVE_BINS], const circ_adaptive_config_t* adaptive_config,
+                          circ_shedule_day_t windows)
+{
+    // Runs of bins with enough demands, when there is one more than table takes two closest ones are merged
+    uint8_t beg[CIRC_PERIODS_PER_DAY + 1];
+    uint8_t end[CIRC_PERIODS_PER_DAY + 1];
+    uint8_t found = 0;
+
+    for (uint8_t bin = 0; bin < CIRC_ADAPTIVE_BINS; bin++) {
+        if (counts[bin] < adaptive_config->min_bin_demands) continue;
+        if (found && bin - end[found - 1] <= adaptive_config->merge_gap_bins) {
+            end[found - 1] = bin + 1;
+            continue;
+        }
+        beg[found] = bin;
+        end[found] = bin + 1;
+        if (++found <= CIRC_PERIODS_PER_DAY) continue;
+
+        uint8_t closest = 0;
+        for (uint8_t i = 1; i < CIRC_PERIODS_PER_DAY; i++) {
+            if (beg[i + 1] - end[i] < beg[closest + 1] - end[closest]) closest = i;
+        }
+        end[closest] = end[closest + 1];
+        for (uint8_t i = closest + 1; i < CIRC_PERIODS_PER_DAY; i++) {
+            beg[i] = beg[i + 1];
+            end[i] = end[i + 1];
+        }
+        found--;
+    }
+
+    const uint16_t lead = S_TO_CT(adaptive_config->lead_time);
+    for (uint8_t i = 0; i < CIRC_PERIODS_PER_DAY; i++) {
+        if (i < found) {
+            uint16_t window_beg = beg[i] * CIRC_ADAPTIVE_BIN;
+            windows[i].beg = (window_beg > lead) ? window_beg - lead : 0;
+            windows[i].end = end[i] * CIRC_ADAPTIVE_BIN;
+        } else {
+            windows[i].beg = windows[i].end = 0;
+        }
+    }
+}
+
+bool CircAdaptive::compactStep()
+{
+    PROFILE_SCOPE("CircAdaptive::compactStep");
+    if (!isCompacting()) return false;
+    const uint8_t spare = active ^ 1;
+    const circ_adaptive_page_t* page = getPage(active);
+
+    if (step < DateTime::DAYS_COUNT) {
+        const uint8_t day = step;
+        uint8_t counts[CIRC_ADAPTIVE_BINS];
+        uint16_t total = 0;
+        for (uint8_t bin = 0; bin < CIRC_ADAPTIVE_BINS; bin++) {
+            counts[bin] = getUnaryCount(page->counts[day][bin]);
+            total += counts[bin];
+        }
+
+        circ_shedule_day_t windows;
+        // Once learned, day type stays learned when aging halves its counts
+        if (isLearned(day) || total >= config->min_day_demands) {
+            const uint8_t learned = getPage(spare)->learned & static_cast<uint8_t>(~(1 << day));
+            fitDay(counts, config, windows);
+            if (!FlashStore::write(spare, PAGE_OFFSET(learned), &learned, 1)) {
+                step = IDLE;
+                return false;
+            }
+        } else {
+            for (uint8_t i = 0; i < CIRC_PERIODS_PER_DAY; i++) windows[i] = (*default_table)[day][i];
+        }
+        for (uint8_t bin = 0; bin < CIRC_ADAPTIVE_BINS; bin++) {
+            // Rounded up, so established windows survive aging
+            counts[bin] = getUnary(aging ? (counts[bin] + 1) >> 1 : counts[bin]);
+        }
+
+        if (!FlashStore::write(spare, PAGE_OFFSET(table) + day * sizeof(circ_shedule_day_t), windows, sizeof(windows)) ||
+            !FlashStore::write(spare, PAGE_OFFSET(counts) + day * CIRC_ADAPTIVE_BINS, counts, CIRC_ADAPTIVE_BINS)) {
+            step = IDLE;
+            return false;
+        }
+        step++;
+        return false;
+    }
+
+    // Sequence goes first, page is complete with its marker
+    const uint8_t sequence = page->sequence + 1;
+    const uint8_t marker = MARKER;
+    step = IDLE;
+    if (!FlashStore::write(spare, PAGE_OFFSET(sequence), &sequence, 1) ||
+        !FlashStore::write(spare, PAGE_OFFSET(marker), &marker, 1)) {
+        return false;
+    }
+    active = spare;
+    return true;
+}
@@ -0,0 +1,100 @@
+/**
+ * CircAdaptive.h - Schedule table learned from demand
+ * This file is a part of Water Circulation Pump driver
+ *
+ * Copyright (c) 2017, Rafal Kukla. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the name of the "Rafal Kukla" nor the names of its contributors may be used to endorse or
+ *   promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ */
+
+#ifndef CIRCADAPTIVE_H_
+#define CIRCADAPTIVE_H_
+
+#include "CircShedule.h"
+
+#define CIRC_ADAPTIVE_BIN       CT( 0, 30, 0)
+#define CIRC_ADAPTIVE_BINS      (CT(24, 0, 0) / CIRC_ADAPTIVE_BIN)
+#define CIRC_ADAPTIVE_MAX_COUNT 8
+
+typedef struct circ_adaptive_config_s
+{
+    uint8_t  min_day_demands;   ///< Day type keeps default table until its histogram has that many demands
+    uint8_t  min_bin_demands;   ///< Bin with that many demands is in on-window
+    uint8_t  merge_gap_bins;    ///< Windows with gap up to that are merged, short breaks save little
+    uint16_t lead_time;         ///< Seconds, window starts earlier so pipes are warm at the first demand
+} circ_adaptive_config_t;
+
+/**
+ * Histogram of demands and table derived from it, one flash segment. Counter of demands is unary:
+ * every demand clears one more bit, so recording needs no erase.
+ */
+typedef struct circ_adaptive_page_s
+{
+    uint8_t              marker;        ///< CircAdaptive::MARKER when page is complete
+    uint8_t              sequence;      ///< Newer of two complete pages is used
+    uint8_t              learned;       ///< Cleared bit of every day type which has had enough demands
+    circ_shedule_table_t table;
+    uint8_t              counts[DateTime::DAYS_COUNT][CIRC_ADAPTIVE_BINS];
+} circ_adaptive_page_t;
+
+/**
+ * Demands are recorded into per day type histogram of CIRC_ADAPTIVE_BIN bins. Compaction copies it to the other
+ * flash segment together with on-windows fitted to it, one day type per step, so it never delays control loop.
+ * Day types which have never had enough demands get default table. Counts are halved when any bin saturates,
+ * so old habits fade.
+ * Demands of the current bin are counted in RAM and written once, when a demand comes in other bin or compaction
+ * starts. So a page gets at most one write per bin it has been active in besides its copy, which keeps every
+ * flash block within FlashStore::BLOCK_WRITES_MAX. Power loss drops demands of the current bin, during compaction
+ * it leaves the old page in use.
+ */
+class CircAdaptive
+{
+public:
+    static const uint8_t MARKER = 0xA5;
+
+    // Picks the newer complete page, storage is formatted with default table if there is none
+    static bool begin(const circ_shedule_table_t* default_table, const circ_adaptive_config_t* config);
+    static const circ_shedule_table_t* getTable();
+    static const circ_adaptive_page_t* getPage();
+    static uint8_t getCount(uint8_t day, uint8_t bin);
+    static bool isLearned(uint8_t day) { return !(getPage()->learned & (1 << day)); }
+    // Demand in local time, false when its bin is saturated
+    static bool record(uint32_t local_time);
+    // Writes demands of the current bin
+    static bool flush();
+
+    static bool isCompacting() { return step != IDLE; }
+    // Erases spare segment
+    static bool startCompaction();
+    // True when compaction is done and the new table is in use
+    static bool compactStep();
+
+    // On-windows fitted to bin counts, exposed for tests
+    static void fitDay(const uint8_t counts[CIRC_ADAPTIVE_BINS], const circ_adaptive_config_t* config,
+                       circ_shedule_day_t windows);
+private:
+    static const uint8_t IDLE = 0xFF;
+
+    static const circ_shedule_table_t*  default_table;
+    static const circ_adaptive_config_t* config;
+    static uint8_t                       active;     ///< Segment of the page in use
+    static uint8_t                       step;       ///< Day type compacted next, IDLE if none
+    static bool                          aging;
+    static uint16_t                      pending_offset;    ///< Counter of the bin with demands not written yet
+    static uint8_t                       pending;           ///< Demands not written yet
+
+    static const circ_adaptive_page_t* getPage(uint8_t segment);
+    static bool format();
+};
+
+#endif /* CIRCADAPTIVE_H_ */
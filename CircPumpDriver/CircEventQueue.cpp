@@ -0,0 +1,76 @@
+/**
+ * CircEventQueue.cpp - Pump events of all zones sorted by time
+ * This file is a part of Water Circulation Pump driver
+ *
+ * Copyright (c) 2017, Rafal Kukla. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the name of the "Rafal Kukla" nor the names of its contributors may be used to endorse or
+ *   promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ */
+
+#include <CircEventQueue.h>
+
+
+// Alarm2 flag is cleared when previous event fires, so there has to be a minute boundary in between
+static bool isMinuteAlarm(uint32_t prev_time, uint32_t time)
+{
+    return (prev_time != DateTime::EPOCH_ERROR) && (time / 60 > prev_time / 60) && (time - prev_time) < DateTime::ONE_HOUR;
+}
+
+void CircEventQueue::clear(circ_event_queue_t* queue)
+{
+    queue->count = 0;
+    queue->last_time = DateTime::EPOCH_ERROR;
+}
+
+uint8_t CircEventQueue::getZoneCount(const circ_event_queue_t* queue, uint8_t zone)
+{
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < queue->count; i++) {
+        if (queue->events[i].zone == zone) count++;
+    }
+    return count;
+}
+
+bool CircEventQueue::insert(circ_event_queue_t* queue, uint32_t time, bool on, uint8_t zone)
+{
+    if (time == DateTime::EPOCH_ERROR || isFull(queue)) return false;
+
+    uint8_t pos = queue->count;
+    while (pos && queue->events[pos - 1].time > time) {
+        queue->events[pos] = queue->events[pos - 1];
+        pos--;
+    }
+    queue->count++;
+
+    circ_event_t* event = &queue->events[pos];
+    dt_date_t d;
+    dt_time_t t;
+
+    DateTime::setDateTimeFromEpoch( time, &d, &t );
+    DS3231Drv::encodeAlarm1( &event->alarm, d.day, t.hour, t.minute, t.second, DS3231_MATCH_DT_H_M_S );
+    event->time = time;
+    event->on = on;
+    event->zone = zone;
+    event->minute_alarm = isMinuteAlarm(pos ? queue->events[pos - 1].time : queue->last_time, time);
+    // Following event is signalled after this one now
+    if (pos + 1 < queue->count) event[1].minute_alarm = isMinuteAlarm(time, event[1].time);
+    return true;
+}
+
+void CircEventQueue::pop(circ_event_queue_t* queue)
+{
+    if (!queue->count) return;
+    queue->last_time = queue->events[0].time;
+    queue->count--;
+    for (uint8_t i = 0; i < queue->count; i++) queue->events[i] = queue->events[i + 1];
+}
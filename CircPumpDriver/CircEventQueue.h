@@ -0,0 +1,66 @@
+/**
+ * CircEventQueue.h - Pump events of all zones sorted by time
+ * This file is a part of Water Circulation Pump driver
+ *
+ * Copyright (c) 2017, Rafal Kukla. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the name of the "Rafal Kukla" nor the names of its contributors may be used to endorse or
+ *   promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ */
+
+#ifndef CIRCEVENTQUEUE_H_
+#define CIRCEVENTQUEUE_H_
+
+#include <DS3231Drv.h>
+
+// Number of pump outputs (zones), must be defined project-wide
+#ifndef CIRC_ZONES
+# define CIRC_ZONES 1
+#endif
+
+// Pump event of one zone
+typedef struct circ_event_s {
+    uint32_t              time;          ///< RTC time of the event
+    bool                  on;            ///< Pump state set by the event
+    bool                  minute_alarm;  ///< Event is signalled by Alarm2, alarm image is not used
+    uint8_t               zone;
+    DS3231_alarm1_image_t alarm;         ///< Alarm1 registers of the event
+} circ_event_t;
+
+// Every zone keeps about two events ahead, so whole pulse is ready when the head fires
+static const uint8_t CIRC_EVENTS_MAX = 2 + 2 * CIRC_ZONES;
+
+/**
+ * Earliest-deadline queue of pump events of all zones. Only the head is set in RTC, so N zones still cost one
+ * alarm write per event. Queue is short and insertion is done in idle time, so it is kept as sorted array:
+ * head is always events[0] and neighbours of an event decide whether Alarm2 can signal it.
+ */
+typedef struct circ_event_queue_s {
+    circ_event_t events[CIRC_EVENTS_MAX];
+    uint8_t      count;
+    uint32_t     last_time;                 ///< Time of the last popped event, EPOCH_ERROR after clear()
+} circ_event_queue_t;
+
+class CircEventQueue {
+public:
+    static void clear(circ_event_queue_t* queue);
+    static inline bool isFull(const circ_event_queue_t* queue) { return queue->count >= CIRC_EVENTS_MAX; }
+    static inline const circ_event_t* getHead(const circ_event_queue_t* queue) {
+        return queue->count ? &queue->events[0] : nullptr;
+    }
+    static uint8_t getZoneCount(const circ_event_queue_t* queue, uint8_t zone);
+    // Event goes after queued events of the same time. Fails when queue is full or time is EPOCH_ERROR.
+    static bool insert(circ_event_queue_t* queue, uint32_t time, bool on, uint8_t zone);
+    static void pop(circ_event_queue_t* queue);
+};
+
+#endif /* CIRCEVENTQUEUE_H_ */
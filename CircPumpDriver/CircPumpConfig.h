@@ -0,0 +1,96 @@
+/**
+ * CircPumpConfig.h - Pump pulses and on-window tables
+ * This file is a part of Water Circulation Pump driver
+ *
+ * Copyright (c) 2017, Rafal Kukla. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the name of the "Rafal Kukla" nor the names of its contributors may be used to endorse or
+ *   promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ */
+
+#ifndef CIRCPUMPCONFIG_H_
+#define CIRCPUMPCONFIG_H_
+
+#include "CircShedule.h"
+#include "CircAdaptive.h"
+#include "CircThermal.h"
+
+// Included by the firmware and by the host tools, which use the same settings
+#if 1
+//                                              ON first, OFF first, ON next, OFF next
+static const circ_pulse_config_t pulse_config = {   4 * 60,    6 * 60,  1 * 60,   9 * 60 };
+#else
+// Used for testing
+static const circ_pulse_config_t pulse_config = {        2,         3,       2,        3 };
+#endif
+
+// On-windows in local time
+#if 0
+static const circ_shedule_table_t workweek_shedule_table = {
+        /* Monday */    { { CT( 3,55, 0 ), CT( 4,55, 0 ) }, { CT(  6,00 , 0 ), CT(  8,35, 0 ) }, { CT( 16,40, 0 ), CT( 22,40, 0 ) },  },
+        /* Tuesday */   { { CT( 3,55, 0 ), CT( 4,55, 0 ) }, { CT( 16,40 , 0 ), CT( 22,40, 0 ) }, },
+        /* Wednesday */ { { CT( 3,55, 0 ), CT( 4,55, 0 ) }, { CT( 16,40 , 0 ), CT( 22,40, 0 ) }, },
+        /* Thursay */   { { CT( 3,55, 0 ), CT( 4,55, 0 ) }, { CT( 16,40 , 0 ), CT( 24, 0, 0 ) }, },
+        /* Friday */    { { CT( 0, 0, 0 ), CT( 1, 0, 0 ) }, { CT(  3,55 , 0 ), CT(  4,55, 0 ) }, { CT(  7, 0, 0 ), CT( 24, 0, 0 ) },  },
+        /* Saturday */  { { CT( 0, 0, 0 ), CT( 2, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, },
+        /* Sunday */    { { CT( 0, 0, 0 ), CT( 2, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, },
+        /* Holiday */   { { CT( 0, 0, 0 ), CT( 2, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, }
+};
+#else
+static const circ_shedule_table_t workweek_shedule_table = {
+        /* Monday */    { { CT( 0, 0, 0 ), CT( 1, 0, 0 ) }, { CT( 3,55, 0 ), CT( 4,55, 0 ) }, { CT(  6,00 , 0 ), CT( 24, 0, 0 ) }, },
+        /* Tuesday */   { { CT( 0, 0, 0 ), CT( 1, 0, 0 ) }, { CT( 3,55, 0 ), CT( 4,55, 0 ) }, { CT(  6,00 , 0 ), CT( 24, 0, 0 ) }, },
+        /* Wednesday */ { { CT( 0, 0, 0 ), CT( 1, 0, 0 ) }, { CT( 3,55, 0 ), CT( 4,55, 0 ) }, { CT(  6,00 , 0 ), CT( 24, 0, 0 ) }, },
+        /* Thursay */   { { CT( 0, 0, 0 ), CT( 1, 0, 0 ) }, { CT( 3,55, 0 ), CT( 4,55, 0 ) }, { CT(  6,00 , 0 ), CT( 24, 0, 0 ) }, },
+        /* Friday */    { { CT( 0, 0, 0 ), CT( 1, 0, 0 ) }, { CT( 3,55, 0 ), CT( 4,55, 0 ) }, { CT(  6,00 , 0 ), CT( 24, 0, 0 ) }, },
+        /* Saturday */  { { CT( 0, 0, 0 ), CT( 3, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, },
+        /* Sunday */    { { CT( 0, 0, 0 ), CT( 2, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, },
+        /* Holiday */   { { CT( 0, 0, 0 ), CT( 3, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, }
+};
+#endif
+static const circ_shedule_table_t vacations_shedule_table = {
+        /* Monday */    { { CT( 0, 0, 0 ), CT( 1, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, },
+        /* Tuesday */   { { CT( 0, 0, 0 ), CT( 1, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, },
+        /* Wednesday */ { { CT( 0, 0, 0 ), CT( 1, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, },
+        /* Thursay */   { { CT( 0, 0, 0 ), CT( 1, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, },
+        /* Friday */    { { CT( 0, 0, 0 ), CT( 1, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, },
+        /* Saturday */  { { CT( 0, 0, 0 ), CT( 2, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, },
+        /* Sunday */    { { CT( 0, 0, 0 ), CT( 2, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, },
+        /* Holiday */   { { CT( 0, 0, 0 ), CT( 2, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, }
+};
+
+// Schedule tables of every pump output (zone) in work week and vacations mode. Pump pins are in CircPumpDriver.ino,
+// number of zones is set by CIRC_ZONES (see CircEventQueue.h). Only one zone may be learned.
+typedef struct circ_zone_tables_s {
+    const circ_shedule_table_t* workweek;
+    const circ_shedule_table_t* vacations;
+    bool                        learned;    ///< Work week table is learned from demand input, starting with "workweek"
+} circ_zone_tables_t;
+
+static constexpr circ_zone_tables_t zone_tables[] = {
+        { &workweek_shedule_table, &vacations_shedule_table, true },
+#if CIRC_ZONES > 1
+        // Second loop, e.g. guest rooms, used on weekend schedule all the time
+        { &vacations_shedule_table, &vacations_shedule_table, false },
+#endif
+};
+
+// Learning of work week table, see CircAdaptive.h
+//                                                  day demands, bin demands, merged gap, lead time
+static const circ_adaptive_config_t adaptive_config = {        8,           2,          1,    10 * 60 };
+
+// Pulses stopped by return pipe temperature of the zone, see CircThermal.h. Sensor input of a zone without NTC
+// and its 10k pull-up floats, so every fitted NTC must be enabled here (bit 0 - first zone).
+//                                                       warm,          stop, sensor zones
+static const circ_thermal_config_t thermal_config = { CIRC_TEMP(41), CIRC_TEMP(44),         0x00 };
+
+#endif /* CIRCPUMPCONFIG_H_ */
@@ -20,22 +20,54 @@
 
 #ifndef SIMULATION
 //#define _DEBUG
+//#define PROFILE /* Must be defined project-wide, see dbgprofile.h */
 #include "DateTime.h" /* Due to some *hacks* this file must be included as first */
 #include "CircShedule.h"
 #endif
 
 
 #include <DS3231Drv.h>
+#include "CircEventQueue.h"
+#include "CircAdaptive.h"
+#include "CircThermal.h"
+#include "Dcf77.h"
+#include "CircPumpConfig.h" /* Pump pulses and schedule tables */
 
 #define PRINT(_s_)                    Serial.print(_s_)
 #define PRINTLN(_s_)                  Serial.println(_s_)
 #include <dbgprint.h>
+#include <dbgprofile.h>
 
 
 // ========================================================================================================= Consts
 
-const uint8_t PUMP_PIN = P2_3;
+// Relay of every zone, schedules are in zone_tables
+const uint8_t PUMP_PINS[] = {
+        P2_3,
+#if CIRC_ZONES > 1
+        P2_4,
+#endif
+};
+static_assert(sizeof(PUMP_PINS) == CIRC_ZONES && sizeof(zone_tables) / sizeof(*zone_tables) == CIRC_ZONES,
+              "Pump pin and schedule tables needed for every zone");
+static_assert(CIRC_ZONES <= 8, "Zones are kept as bits");
+// CircAdaptive is single, begin() of another zone would take its table over
+static constexpr uint8_t getLearnedZones(uint8_t zone) {
+    return (zone < CIRC_ZONES) ? zone_tables[zone].learned + getLearnedZones(zone + 1) : 0;
+}
+static_assert(getLearnedZones(0) <= 1, "Only one zone may have learned table");
+// Return pipe NTC of every zone with 10k to Vcc, read only when enabled in thermal_config
+const uint8_t RETURN_TEMP_PINS[] = {
+        P1_4,
+#if CIRC_ZONES > 1
+        P1_5,
+#endif
+};
+static_assert(sizeof(RETURN_TEMP_PINS) == CIRC_ZONES, "Return temperature pin needed for every zone");
 const uint8_t MODE_BTN_PIN = PUSH2; //Pin 1_3
+const uint8_t DEMAND_PIN = P2_5;    // Flow switch to ground, short press of mode button works as well
+const uint8_t DCF77_PIN = P2_0;     // DCF77 receiver output
+const uint8_t DCF77_PULSE_LEVEL = HIGH;         // Output level during carrier reduction
 
 const unsigned TICK_TIME = 100; //ms
 const unsigned HEARTBEAT_ON_TICKS = 10;
@@ -43,72 +75,58 @@ const unsigned HEARTBEAT_OFF_TICKS = 2;
 const unsigned RTC_READ_TICKS=5;
 const unsigned CHECK_PUMP_TICKS=5;
 const unsigned MODE_CHANGE_TICKS=20; // 2s
-#if 1
-static const uint16_t ON_TIME_FIRST  =  4 * 60;
-static const uint16_t OFF_TIME_FIRST =  6 * 60;
-static const uint16_t ON_TIME_NEXT   =  1 * 60;
-static const uint16_t OFF_TIME_NEXT  =  9 * 60;
-#else
-// Used for testing
-static const uint16_t ON_TIME_FIRST  =  2;
-static const uint16_t OFF_TIME_FIRST =  3;
-static const uint16_t ON_TIME_NEXT   =  2;
-static const uint16_t OFF_TIME_NEXT  =  3;
-#endif
-
-// ========================================================================================================= Shedule Tables
-#if 0
-static const circ_shedule_table_t workweek_shedule_table = {
-        /* Monday */    { { CT( 3,55, 0 ), CT( 4,55, 0 ) }, { CT(  6,00 , 0 ), CT(  8,35, 0 ) }, { CT( 16,40, 0 ), CT( 22,40, 0 ) },  },
-        /* Tuesday */   { { CT( 3,55, 0 ), CT( 4,55, 0 ) }, { CT( 16,40 , 0 ), CT( 22,40, 0 ) }, },
-        /* Wednesday */ { { CT( 3,55, 0 ), CT( 4,55, 0 ) }, { CT( 16,40 , 0 ), CT( 22,40, 0 ) }, },
-        /* Thursay */   { { CT( 3,55, 0 ), CT( 4,55, 0 ) }, { CT( 16,40 , 0 ), CT( 24, 0, 0 ) }, },
-        /* Friday */    { { CT( 0, 0, 0 ), CT( 1, 0, 0 ) }, { CT(  3,55 , 0 ), CT(  4,55, 0 ) }, { CT(  7, 0, 0 ), CT( 24, 0, 0 ) },  },
-        /* Saturday */  { { CT( 0, 0, 0 ), CT( 2, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, },
-        /* Sunday */    { { CT( 0, 0, 0 ), CT( 2, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, },
-        /* Holiday */   { { CT( 0, 0, 0 ), CT( 2, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, }
-};
-#else
-static const circ_shedule_table_t workweek_shedule_table = {
-        /* Monday */    { { CT( 0, 0, 0 ), CT( 1, 0, 0 ) }, { CT( 3,55, 0 ), CT( 4,55, 0 ) }, { CT(  6,00 , 0 ), CT( 24, 0, 0 ) }, },
-        /* Tuesday */   { { CT( 0, 0, 0 ), CT( 1, 0, 0 ) }, { CT( 3,55, 0 ), CT( 4,55, 0 ) }, { CT(  6,00 , 0 ), CT( 24, 0, 0 ) }, },
-        /* Wednesday */ { { CT( 0, 0, 0 ), CT( 1, 0, 0 ) }, { CT( 3,55, 0 ), CT( 4,55, 0 ) }, { CT(  6,00 , 0 ), CT( 24, 0, 0 ) }, },
-        /* Thursay */   { { CT( 0, 0, 0 ), CT( 1, 0, 0 ) }, { CT( 3,55, 0 ), CT( 4,55, 0 ) }, { CT(  6,00 , 0 ), CT( 24, 0, 0 ) }, },
-        /* Friday */    { { CT( 0, 0, 0 ), CT( 1, 0, 0 ) }, { CT( 3,55, 0 ), CT( 4,55, 0 ) }, { CT(  6,00 , 0 ), CT( 24, 0, 0 ) }, },
-        /* Saturday */  { { CT( 0, 0, 0 ), CT( 3, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, },
-        /* Sunday */    { { CT( 0, 0, 0 ), CT( 2, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, },
-        /* Holiday */   { { CT( 0, 0, 0 ), CT( 3, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, }
-};
-#endif
-static const circ_shedule_table_t vacations_shedule_table = {
-        /* Monday */    { { CT( 0, 0, 0 ), CT( 1, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, },
-        /* Tuesday */   { { CT( 0, 0, 0 ), CT( 1, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, },
-        /* Wednesday */ { { CT( 0, 0, 0 ), CT( 1, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, },
-        /* Thursay */   { { CT( 0, 0, 0 ), CT( 1, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, },
-        /* Friday */    { { CT( 0, 0, 0 ), CT( 1, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, },
-        /* Saturday */  { { CT( 0, 0, 0 ), CT( 2, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, },
-        /* Sunday */    { { CT( 0, 0, 0 ), CT( 2, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, },
-        /* Holiday */   { { CT( 0, 0, 0 ), CT( 2, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, }
-};
-
-static const circ_shedule_table_t* current_shedule_table = &workweek_shedule_table;
-
-static inline bool isWorkweekScheduleTable()   { return current_shedule_table == &workweek_shedule_table; }
-static inline void setWorkweekScheduleTable()  { current_shedule_table = &workweek_shedule_table; }
-static inline void setVacationsScheduleTable() { current_shedule_table = &vacations_shedule_table; }
-
+const uint8_t RETURN_TEMP_SAMPLES = 4;          // ADC readings averaged
+const uint32_t DEMAND_BURST_TIME = 3 * 60;      // s
+const uint32_t DEMAND_COOLDOWN_TIME = 15 * 60;  // s, from the end of burst
+const uint32_t DEMAND_BUTTON_GUARD_TIME = 2;    // s, after mode change, so button release does not start a burst
+const uint32_t ADAPTIVE_COMPACTION_TIME = 3 * DateTime::ONE_HOUR;  // Local time of daily compaction
+const uint32_t DCF77_CORRECTION_TIME = 2;       // s, RTC off by that much is set from DCF77
+const uint32_t DCF77_CONFIRMED_TIME = 10000;    // ms, confirmed minute is used that long, CPU clock is not precise
 
 // ========================================================================================================= Globals
 
-uint32_t current_rtc_time;
-uint32_t current_local_time;
-
-uint32_t ticks=0;        ///< System ticks. Increased every TICK_TIME ms
+// Pump output with its own schedule and pulses
+typedef struct circ_zone_s {
+    bool                        pump_on;                ///< State set by schedule, relay may be off by return temperature
+    uint32_t                    last_pump_off_time;
+    int16_t                     return_temp;            ///< CircThermal::TEMP_ERROR without NTC
+    uint8_t                     pulse;                  ///< circ_pulse_state_t of the current pulse
+    // Planner state: time of the last event of the zone in queue and pump state just before it
+    uint32_t                    plan_time;
+    bool                        plan_pump_on;
+    uint32_t                    plan_last_pump_off_time;
+} circ_zone_t;
+
+// Whole control state of the driver in one place, so host tools can save, restore or replace it
+typedef struct circ_context_s {
+    uint32_t                    ticks;                  ///< System ticks. Increased every TICK_TIME ms
+    uint32_t                    current_rtc_time;
+    uint32_t                    current_local_time;
+    DS3231_snapshot_t           rtc_snapshot;           ///< Time and flags from the last single burst read of the RTC
+    circ_zone_t                 zones[CIRC_ZONES];
+    bool                        vacations;              ///< Schedule tables of all zones
+    uint16_t                    mode_button_timer;
+    uint16_t                    rtc_errors;
+    circ_event_queue_t          events;                 ///< Head is the one set in RTC
+    uint32_t                    demand_until;           ///< RTC time of the end of demand burst, EPOCH_ERROR if none
+    uint32_t                    demand_armed_time;      ///< RTC time when demand input is enabled again
+    uint16_t                    adaptive_day;           ///< Local day of the last compaction of learned table
+    bool                        dcf77_pending;          ///< Confirmed DCF77 minute not compared with RTC yet
+} circ_context_t;
+
+static circ_context_t ctx = {};
+
+static inline bool isWorkweekScheduleTable()   { return !ctx.vacations; }
+static inline void setWorkweekScheduleTable()  { ctx.vacations = false; }
+static inline void setVacationsScheduleTable() { ctx.vacations = true; }
+static inline const circ_shedule_table_t* getZoneScheduleTable(uint8_t zone) {
+    if (ctx.vacations) return zone_tables[zone].vacations;
+    return zone_tables[zone].learned ? CircAdaptive::getTable() : zone_tables[zone].workweek;
+}
 
-uint32_t last_pump_off_time=0;
-static bool pump_on = false;
 
 void DisplayDateTime(const char* start_str, uint32_t epoch);
+static void saveWarmState();
 // ========================================================================================================= System utilities
 static inline void reset() {
     WDTCTL = 0; // Writing to Watchdog control register without "password" ( 05Ah in the upper byte) causes reset
@@ -128,7 +146,7 @@ static void dead_loop()
 
 #define ASSERT(_expr_) do { auto i = _expr_; \
     if (! i) { \
-        DisplayDateTime("ASSERT: ", current_local_time); \
+        DisplayDateTime("ASSERT: ", ctx.current_local_time); \
         PRINT5(#_expr_, " : ",__FILE__,":",__LINE__);\
         dead_loop(); \
     } } while(0)
@@ -136,27 +154,56 @@ static void dead_loop()
 # define ASSERT(_expr_) do { auto i = _expr_; if (! i) reset(); } while(0)
 #endif
 // ========================================================================================================= RTC Handling
-// Repeat operation twice and do reset if failing
+// Failed operation is repeated after bus recovery, reset is done only when all retries fail
+const uint8_t RTC_RETRIES = 2;
+
 #define RTC_CHECK( _operation_ ) do { \
-    if (! (_operation_) ) { \
-        ASSERT(_operation_); \
+    for (uint8_t _retry_ = 0; !(_operation_); _retry_++) { \
+        if (ctx.rtc_errors != 0xFFFF) ctx.rtc_errors++; \
+        DS3231Drv::recoverBus(); \
+        if (_retry_ == RTC_RETRIES) { \
+            ASSERT(_operation_); \
+            break; \
+        } \
     } } while(0)
 
 
 static void initRtc() {
     DS3231Drv::begin();
+    DS3231Drv::beginBatch();
     RTC_CHECK(DS3231Drv::enableOscilatorOnBattery(true));
     RTC_CHECK(DS3231Drv::armAlarm1(false));
-    RTC_CHECK(DS3231Drv::armAlarm2(false));
+    RTC_CHECK(DS3231Drv::setAlarm2(0, 0, 0, DS3231_EVERY_MINUTE, false));
     RTC_CHECK(DS3231Drv::clearAlarm1());
     RTC_CHECK(DS3231Drv::clearAlarm2());
+    RTC_CHECK(DS3231Drv::clearOscilatorStopFlag());
+    RTC_CHECK(DS3231Drv::commitBatch());
+}
+
+// RTC keeps running and Alarm1 is still armed for next pump event, so there is nothing to initialize
+static bool isRtcWarm() {
+    bool osc_stopped = true;
+    DS3231Drv::begin();
+    if (! DS3231Drv::readOscilatorStopFlag(osc_stopped) || osc_stopped ) return false;
+    return DS3231Drv::isArmed1();
 }
 
+// Simulation may fit return pipe sensors at run time
+#ifndef THERMAL_CONFIG
+# define THERMAL_CONFIG thermal_config
+#endif
+
+// Simulation may pretend other build date
+#ifndef BUILD_DATE
+# define BUILD_DATE __DATE__
+# define BUILD_TIME __TIME__
+#endif
+
 static uint32_t getBuildDateTime() {
     dt_date_t build_date;
-    if (! DateTime::getDateFromStr(__DATE__, &build_date) ) return DateTime::EPOCH_ERROR;
+    if (! DateTime::getDateFromStr(BUILD_DATE, &build_date) ) return DateTime::EPOCH_ERROR;
     dt_time_t build_time;
-    if (! DateTime::getTimeFromStr(__TIME__, &build_time) ) return DateTime::EPOCH_ERROR;
+    if (! DateTime::getTimeFromStr(BUILD_TIME, &build_time) ) return DateTime::EPOCH_ERROR;
 
     return DateTime::getEpochFromDateTime(&build_date,&build_time);
 }
@@ -179,8 +226,9 @@ static void setRtcDateTime(uint32_t datetime_to_set)
 
 static void readDateTimeFromRtc()
 {
-    current_rtc_time = getRtcDateTime();
-    current_local_time = DateTime::getLocalDateTimeFromUtc( current_rtc_time );
+    RTC_CHECK( DS3231Drv::readSnapshot(&ctx.rtc_snapshot) );
+    ctx.current_rtc_time = DateTime::getEpochFromDateTime(&ctx.rtc_snapshot.date, &ctx.rtc_snapshot.time);
+    ctx.current_local_time = DateTime::getLocalDateTimeFromUtc( ctx.current_rtc_time );
 }
 
 
@@ -223,75 +271,410 @@ static void ReadAndAdjustRTC()
 
 // ========================================================================================================= Circulation Pump handling
 
-static inline bool isCircOnOffTime() {
-    bool isAlarm = false;
-    RTC_CHECK( DS3231Drv::readAlarm1(isAlarm) );
-    return isAlarm;
-}
 
-static void setCircOnOffRtcTime(uint32_t epoch)
+static inline bool isDemandBurst();
+static inline bool isPumpRelayOn(uint8_t zone) {
+   return ctx.zones[zone].pulse == CIRC_PULSE_RUNNING || isDemandBurst();
+}
+// New pulse is skipped right away if the loop is still warm
+static void setCircPumpOnOff(uint8_t zone, bool on, uint32_t time)
 {
-    if (epoch== DateTime::EPOCH_ERROR) return;
-    dt_date_t d;
-    dt_time_t t;
+   circ_zone_t* z = &ctx.zones[zone];
+   z->pump_on = on;
+   z->pulse = CircThermal::updatePulse(&THERMAL_CONFIG, CIRC_PULSE_IDLE, on, z->return_temp);
+   digitalWrite(PUMP_PINS[zone], isPumpRelayOn(zone) ? HIGH : LOW);
+   if (!on) z->last_pump_off_time = time;
+}
+static void printTemperature(int16_t temperature) {
+   if (temperature < 0) {
+       PRINT("-");
+       temperature = -temperature;
+   }
+   uint8_t hundredths = (temperature & 0x03) * 25;
+   PRINT2(temperature >> 2, hundredths ? "." : ".0");
+   PRINTLN(hundredths);
+}
+// Logged with pump transitions, as RTC drift depends on it
+static void displayTemperature() {
+   int16_t temperature;
+   if (!DS3231Drv::readTemperature(&temperature)) return;
+
+   PRINT("Temperature: ");
+   printTemperature(temperature);
+}
+static void displayPulseDone(uint8_t zone, bool skipped) {
+   if (zone) PRINT2("Pump ", zone + 1);
+   PRINT(zone ? " pulse " : "Pulse ");
+   PRINT(skipped ? "skipped, return: " : "stopped, return: ");
+   printTemperature(ctx.zones[zone].return_temp);
+}
+// First zone is logged as single pump, "Pump 2 is ON:  ..." for the others
+static void displayCircPumpOnOff(uint8_t zone, bool on) {
+   if (zone) PRINT2("Pump ", zone + 1);
+   DisplayDateTime(zone ? (on ? " is ON:  " : " is OFF: ") : (on ? "Pump is ON:  " : "Pump is OFF: "), ctx.current_local_time);
+   displayTemperature();
+   if (on && ctx.zones[zone].pulse == CIRC_PULSE_DONE) displayPulseDone(zone, true);
+}
 
-    DateTime::setDateTimeFromEpoch( epoch, &d, &t );
-    RTC_CHECK( DS3231Drv::setAlarm1(d.day, t.hour, t.minute, t.second, DS3231_MATCH_DT_H_M_S) );
+static inline uint32_t getNextOffRtcTime(uint32_t now, uint32_t last_off_time) {
+    return CircShedule::getNextPulseOffTime(&pulse_config, now, last_off_time);
 }
 
+static inline uint32_t getNextOnRtcTime(uint8_t zone, uint32_t now, uint32_t last_off_time) {
+    return CircShedule::getNextPulseOnTime(getZoneScheduleTable(zone), &pulse_config, now, last_off_time);
+}
 
+// ========================================================================================================= Pump events lookahead
+// Next pump events are computed in idle time, so when alarm fires there is only relay to switch
+// and already encoded alarm of the following event to be sent to RTC.
+// Pulses inside on-window are driven by Alarm2 firing every minute: its flag is only cleared at the edge
+// and the edge happens once the flag is set again and RTC time reaches the event, so Alarm2 is never reprogrammed.
+// Alarm1 with full date match is reserved for window boundaries.
 
-static inline bool isCircPumpOn() { return pump_on; }
-static void setCircPumpOnOff(bool on)
-{
-   DisplayDateTime(on ? "Pump is ON:  " : "Pump is OFF: ", current_local_time);
-   pump_on = on;
-   digitalWrite(PUMP_PIN, on ? HIGH : LOW);
-   if (!on) last_pump_off_time = current_rtc_time;
-}
-
-static inline uint32_t getNextOffRtcTime() {
-    // First time after longer perdiod we'll let Pump be on for longer time as pipes may be colder
-    return current_rtc_time + ( ( (current_rtc_time-last_pump_off_time) > 2*OFF_TIME_FIRST ) ? ON_TIME_FIRST : ON_TIME_NEXT );
-}
-static inline void setupCircOnOffRtcTime(uint32_t time) {
-    setCircOnOffRtcTime(time);
-    IFDEBUG( DisplayDateTime("Next event:  ",DateTime::getLocalDateTimeFromUtc(time) ) );
-}
-
-static inline uint32_t getNextOnRtcTime() {
-    uint32_t on_time =  current_rtc_time + ( ( (current_rtc_time-last_pump_off_time) > 2*OFF_TIME_FIRST ) ? OFF_TIME_FIRST : OFF_TIME_NEXT );
-    // Schedule tables are in local time
-    on_time = DateTime::getUtcDateTimeFromLocal(
-                CircShedule::getNextOnTime(current_shedule_table, DateTime::getLocalDateTimeFromUtc( on_time ) )
-            );
-    // Check Daylight Saving Time case
-    if (on_time < current_rtc_time) {
-        on_time += ((current_rtc_time - on_time) / DateTime::ONE_HOUR + 1) * DateTime::ONE_HOUR;
+static void clearEvents() {
+    CircEventQueue::clear(&ctx.events);
+    for (uint8_t zone = 0; zone < CIRC_ZONES; zone++) ctx.zones[zone].plan_time = DateTime::EPOCH_ERROR;
+}
+
+static bool addEvent(uint8_t zone, uint32_t time, bool on) {
+    ctx.zones[zone].plan_time = time;
+    return CircEventQueue::insert(&ctx.events, time, on, zone);
+}
+
+// Starts plan of the zone with its first event, pump_on and last_pump_off_time describe state before that event
+static bool startZoneEvents(uint8_t zone, uint32_t time, bool on) {
+    circ_zone_t* z = &ctx.zones[zone];
+    z->plan_pump_on = !on;
+    z->plan_last_pump_off_time = z->last_pump_off_time;
+    return addEvent(zone, time, on);
+}
+
+// Computes one event after the last one of the zone in queue, exactly as it would be computed when that event fires
+static bool planZoneEvent(uint8_t zone) {
+    circ_zone_t* z = &ctx.zones[zone];
+    if (z->plan_time == DateTime::EPOCH_ERROR || CircEventQueue::isFull(&ctx.events)) return false;
+
+    uint32_t time;
+    if (z->plan_pump_on) {
+        time = getNextOnRtcTime(zone, z->plan_time, z->plan_last_pump_off_time);
+        z->plan_last_pump_off_time = z->plan_time;
+    } else {
+        time = getNextOffRtcTime(z->plan_time, z->plan_last_pump_off_time);
+    }
+    z->plan_pump_on = !z->plan_pump_on;
+    return addEvent(zone, time, !z->plan_pump_on);
+}
+
+// Extends the zone planned least ahead, so queue holds the nearest events of all zones.
+// Every planned zone has an event in queue, so new event never goes before the head.
+static bool planNextEvent() {
+    uint8_t next = CIRC_ZONES;
+    for (uint8_t zone = 0; zone < CIRC_ZONES; zone++) {
+        uint32_t plan_time = ctx.zones[zone].plan_time;
+        if (plan_time != DateTime::EPOCH_ERROR && (next == CIRC_ZONES || plan_time < ctx.zones[next].plan_time)) next = zone;
     }
-    return on_time ;
+    return (next != CIRC_ZONES) && planZoneEvent(next);
+}
+
+static inline const circ_event_t* getPendingEvent() {
+    return CircEventQueue::getHead(&ctx.events);
 }
 
+static inline void displayPendingEvent() {
+    IFDEBUG( if (getPendingEvent()) DisplayDateTime("Next event:  ",DateTime::getLocalDateTimeFromUtc(getPendingEvent()->time) ) );
+}
+
+// ========================================================================================================= Pump events handling
+
 static void setupFirstOn() {
-    uint32_t time = CircShedule::getNextOnTime(current_shedule_table, current_local_time);
-    if (time == current_local_time) {
-        time = getNextOffRtcTime();
-        setCircPumpOnOff(true);
-    } else {
-        time = DateTime::getUtcDateTimeFromLocal( time );
-        setCircPumpOnOff(false);
+    clearEvents();
+    for (uint8_t zone = 0; zone < CIRC_ZONES; zone++) {
+        uint32_t time = CircShedule::getNextOnTime(getZoneScheduleTable(zone), ctx.current_local_time);
+        bool on = (time == ctx.current_local_time);
+
+        setCircPumpOnOff(zone, on, ctx.current_rtc_time);
+        displayCircPumpOnOff(zone, on);
+
+        time = (on) ? getNextOffRtcTime(ctx.current_rtc_time, ctx.zones[zone].last_pump_off_time) : DateTime::getUtcDateTimeFromLocal( time );
+        startZoneEvents(zone, time, !on);
+    }
+    if (getPendingEvent()) {
+        ctx.events.events[0].minute_alarm = false;
+        RTC_CHECK( DS3231Drv::setAlarm1( &getPendingEvent()->alarm ) );
+        displayPendingEvent();
     }
-    setupCircOnOffRtcTime(time);
+    saveWarmState();
 }
 
 
+// Alarm flags come from the snapshot taken by readDateTimeFromRtc() in the same tick
+static inline bool isCircOnOffTime(const circ_event_t* event) {
+    if (event->minute_alarm) return ctx.rtc_snapshot.alarm2 && ctx.current_rtc_time >= event->time;
+    return ctx.rtc_snapshot.alarm1;
+}
+
+// Flag of the next event source is cleared as well, it may be set by Alarm1 matching its old time
+// or by Alarm2 since the last pulse
+static bool writeEventAlarm(const circ_event_t* event) {
+    if (event->minute_alarm) return DS3231Drv::clearAlarm2();
+    return DS3231Drv::writeAlarm1( &event->alarm ) && DS3231Drv::clearAlarm1();
+}
+
 static void CheckCircPumpEvent() {
-    if (isCircOnOffTime()) {
-        bool on = isCircPumpOn();
-        uint32_t t = (on) ? getNextOnRtcTime() : getNextOffRtcTime();
-        setCircPumpOnOff(!on);
-        setupCircOnOffRtcTime(t);
+    PROFILE_SCOPE("CheckCircPumpEvent");
+    const circ_event_t* event = getPendingEvent();
+    if (!event || !isCircOnOffTime(event)) return;
+
+    // Critical path: relays, then fired alarm flags and next alarm in single burst. Alarm1 stays armed.
+    // Events of other zones which are already due are fired together with the head. Warm state is saved
+    // before the burst, so reset on its failure keeps the relays and does not fire the events again.
+    uint8_t fired_zones = 0;
+    bool alarm1_fired = false;
+    bool alarm2_fired = false;
+    do {
+        if (event->minute_alarm) alarm2_fired = true; else alarm1_fired = true;
+        fired_zones |= 1 << event->zone;
+        setCircPumpOnOff(event->zone, event->on, event->time);
+        CircEventQueue::pop(&ctx.events);
+        event = getPendingEvent();
+    } while (event && event->time <= ctx.current_rtc_time);
+    // Zone left without event may be the next one to fire
+    for (uint8_t zone = 0; zone < CIRC_ZONES; zone++) {
+        if ((fired_zones & (1 << zone)) && !CircEventQueue::getZoneCount(&ctx.events, zone)) planZoneEvent(zone);
+    }
+    saveWarmState();
+
+    DS3231Drv::beginBatch();
+    if (alarm1_fired) RTC_CHECK( DS3231Drv::clearAlarm1() );
+    if (alarm2_fired) RTC_CHECK( DS3231Drv::clearAlarm2() );
+    if ( getPendingEvent() ) {
+        RTC_CHECK( writeEventAlarm( getPendingEvent() ) );
     }
+    RTC_CHECK( DS3231Drv::commitBatch() );
+
+    for (uint8_t zone = 0; zone < CIRC_ZONES; zone++) {
+        if (fired_zones & (1 << zone)) displayCircPumpOnOff(zone, ctx.zones[zone].pump_on);
+    }
+    displayPendingEvent();
+}
+
+// ========================================================================================================= Demand handling
+// Edge of demand input switches relays of all zones right in the interrupt. Burst is bounded and merged with
+// schedule: relay stays on while either of them wants it. Input is disabled during burst and cooldown,
+// so it costs at most one relay cycle per cooldown period.
+
+static volatile bool demand_armed;
+static volatile bool demand_started;
+static volatile uint8_t demand_edges;   ///< Edges of demand input not recorded yet
+
+static inline bool isDemandBurst() {
+    return demand_started || ctx.demand_until != DateTime::EPOCH_ERROR;
+}
+
+static void onDemandEdge() {
+    if (!demand_armed) return;
+    demand_armed = false;
+    demand_started = true;
+    for (uint8_t zone = 0; zone < CIRC_ZONES; zone++) digitalWrite(PUMP_PINS[zone], HIGH);
+}
+
+// Every edge is a demand, also in burst or cooldown
+static void onDemandInputEdge() {
+    if (demand_edges != 0xFF) demand_edges++;
+    onDemandEdge();
+}
+
+static void setDemandRelays() {
+    for (uint8_t zone = 0; zone < CIRC_ZONES; zone++) {
+        digitalWrite(PUMP_PINS[zone], isPumpRelayOn(zone) ? HIGH : LOW);
+    }
+}
+
+static void stopDemandBurst(uint32_t armed_time) {
+    demand_armed = false;
+    demand_started = false;
+    ctx.demand_until = DateTime::EPOCH_ERROR;
+    ctx.demand_armed_time = armed_time;
+}
+
+static void HandleDemand() {
+    // One demand per tick, flash is written only when demand comes in other bin
+    if (demand_edges) {
+        demand_edges--;
+        CircAdaptive::record(ctx.current_local_time);
+    }
+    if (demand_started) {
+        ctx.demand_until = ctx.current_rtc_time + DEMAND_BURST_TIME;
+        demand_started = false;
+        // Relay write of the loop may be interrupted by the edge and overwrite it
+        setDemandRelays();
+        DisplayDateTime("Demand burst: ", ctx.current_local_time);
+    } else if (ctx.demand_until != DateTime::EPOCH_ERROR) {
+        if (ctx.current_rtc_time < ctx.demand_until) return;
+        stopDemandBurst(ctx.current_rtc_time + DEMAND_COOLDOWN_TIME);
+        setDemandRelays();
+        DisplayDateTime("Demand end:   ", ctx.current_local_time);
+    } else if (!demand_armed && ctx.current_rtc_time >= ctx.demand_armed_time) {
+        demand_armed = true;
+    }
+}
+
+// ========================================================================================================= Return temperature
+// Read with pump event checks. Pulse is stopped once the loop is hot, relay is written only when it changes.
+
+static int16_t readReturnTemp(uint8_t zone) {
+    if (!CircThermal::hasSensor(&THERMAL_CONFIG, zone)) return CircThermal::TEMP_ERROR;
+    uint16_t adc = 0;
+    for (uint8_t i = 0; i < RETURN_TEMP_SAMPLES; i++) adc += analogRead(RETURN_TEMP_PINS[zone]);
+    return CircThermal::getTemperature(adc / RETURN_TEMP_SAMPLES);
+}
+
+static void readReturnTemps() {
+    for (uint8_t zone = 0; zone < CIRC_ZONES; zone++) ctx.zones[zone].return_temp = readReturnTemp(zone);
+}
+
+static void HandleReturnTemp() {
+    readReturnTemps();
+    bool changed = false;
+    for (uint8_t zone = 0; zone < CIRC_ZONES; zone++) {
+        circ_zone_t* z = &ctx.zones[zone];
+        circ_pulse_state_t pulse = CircThermal::updatePulse(&THERMAL_CONFIG, static_cast<circ_pulse_state_t>(z->pulse),
+                                                            z->pump_on, z->return_temp);
+        if (pulse == z->pulse) continue;
+
+        bool relay_on = isPumpRelayOn(zone);
+        bool skipped = (z->pulse == CIRC_PULSE_IDLE);
+        z->pulse = pulse;
+        if (isPumpRelayOn(zone) != relay_on) digitalWrite(PUMP_PINS[zone], relay_on ? LOW : HIGH);
+        if (pulse == CIRC_PULSE_DONE) displayPulseDone(zone, skipped);
+        changed = true;
+    }
+    // Stopped pulse stays stopped after reset
+    if (changed) saveWarmState();
+}
+
+// ========================================================================================================= Learned schedule
+// Compaction runs once a day, one step per tick. Events already planned keep the old table.
+
+static void HandleAdaptive() {
+    if (CircAdaptive::isCompacting()) {
+        if (CircAdaptive::compactStep()) {
+            IFDEBUG( PRINTLN("Learned schedule updated") );
+        }
+        return;
+    }
+    if (ctx.current_local_time == DateTime::EPOCH_ERROR) return;
+    uint16_t day = static_cast<uint16_t>(ctx.current_local_time / DateTime::ONE_DAY);
+    if (day != ctx.adaptive_day && ctx.current_local_time % DateTime::ONE_DAY >= ADAPTIVE_COMPACTION_TIME) {
+        ctx.adaptive_day = day;
+        CircAdaptive::startCompaction();
+    }
+}
+
+// ========================================================================================================= DCF77 time
+// Edges are only time stamped in the interrupt. Confirmed minute is compared with the RTC time read by the loop
+// right after DCF77 second starts, as the RTC write restarts its second. Events are planned again after correction.
+
+static void onDcf77Edge() {
+    bool high = digitalRead(DCF77_PIN) == HIGH;
+    Dcf77::onEdge(millis(), high == (DCF77_PULSE_LEVEL == HIGH));
+    // Port interrupt has one edge, the other one comes next
+    attachInterrupt(DCF77_PIN, onDcf77Edge, high ? FALLING : RISING);
+}
+
+static void HandleDcf77() {
+    if (Dcf77::process()) ctx.dcf77_pending = true;
+    if (!ctx.dcf77_pending) return;
+
+    const dcf77_minute_t* minute = Dcf77::getConfirmed();
+    uint32_t elapsed = millis() - minute->ms;
+    if (elapsed >= DCF77_CONFIRMED_TIME) {
+        ctx.dcf77_pending = false;
+        return;
+    }
+    if (elapsed % 1000 >= TICK_TIME) return;
+    ctx.dcf77_pending = false;
+
+    uint32_t time = minute->time + elapsed / 1000;
+    uint32_t rtc = ctx.current_rtc_time;
+    if (rtc != DateTime::EPOCH_ERROR && ((rtc > time) ? rtc - time : time - rtc) < DCF77_CORRECTION_TIME) return;
+
+    setRtcDateTime(time);
+    DisplayDateTime("DCF77 date:  ", DateTime::getLocalDateTimeFromUtc(time));
+    readDateTimeFromRtc();
+    setupFirstOn();
+}
+
+// ========================================================================================================= Warm restart state
+
+#ifndef NOINIT
+# define NOINIT __attribute__ ((section (".noinit")))
+#endif
+
+// Kept in RAM section which is not cleared by startup code, so it survives reset() but not power loss
+static const uint16_t WARM_STATE_MAGIC = 0xC1C7;
+static const uint8_t  WARM_STATE_VACATIONS_FLAG = 0x02;
+static const uint8_t  WARM_STATE_MINUTE_ALARM_FLAG = 0x04;
+
+static struct warm_state_s {
+    uint16_t magic;
+    uint8_t  flags;
+    uint8_t  pumps_on;                          ///< Bit of every zone
+    uint8_t  pulses_done;                       ///< Bit of every zone with pulse stopped or skipped
+    uint32_t last_pump_off_time[CIRC_ZONES];
+    uint32_t next_event_time[CIRC_ZONES];       ///< The earliest event of every zone, the first one is set in RTC
+    uint16_t check;
+} warm_state NOINIT;
+
+static inline uint16_t getCheck(uint32_t value) {
+    return static_cast<uint16_t>(value) ^ static_cast<uint16_t>(value >> 16);
+}
+
+static uint16_t getWarmStateCheck() {
+    uint16_t check = warm_state.magic ^ warm_state.flags ^ (static_cast<uint16_t>(warm_state.pumps_on) << 8) ^
+                     (static_cast<uint16_t>(warm_state.pulses_done) << 4);
+    for (uint8_t zone = 0; zone < CIRC_ZONES; zone++) {
+        check ^= getCheck(warm_state.last_pump_off_time[zone]) ^ getCheck(warm_state.next_event_time[zone]);
+    }
+    return ~check;
+}
+
+static void saveWarmState() {
+    warm_state.magic = WARM_STATE_MAGIC;
+    warm_state.flags = (isWorkweekScheduleTable() ? 0 : WARM_STATE_VACATIONS_FLAG) |
+                       ( (getPendingEvent() && getPendingEvent()->minute_alarm) ? WARM_STATE_MINUTE_ALARM_FLAG : 0 );
+    warm_state.pumps_on = 0;
+    warm_state.pulses_done = 0;
+    for (uint8_t zone = 0; zone < CIRC_ZONES; zone++) {
+        if (ctx.zones[zone].pump_on) warm_state.pumps_on |= 1 << zone;
+        if (ctx.zones[zone].pulse == CIRC_PULSE_DONE) warm_state.pulses_done |= 1 << zone;
+        warm_state.last_pump_off_time[zone] = ctx.zones[zone].last_pump_off_time;
+        warm_state.next_event_time[zone] = DateTime::EPOCH_ERROR;
+    }
+    for (uint8_t i = ctx.events.count; i--; ) {
+        warm_state.next_event_time[ctx.events.events[i].zone] = ctx.events.events[i].time;
+    }
+    warm_state.check = getWarmStateCheck();
+}
+
+static bool restoreWarmState() {
+    if (warm_state.magic != WARM_STATE_MAGIC || warm_state.check != getWarmStateCheck()) return false;
+
+    if (warm_state.flags & WARM_STATE_VACATIONS_FLAG) setVacationsScheduleTable(); else setWorkweekScheduleTable();
+    // Pending events are still set in RTC, rebuild lookahead from them
+    clearEvents();
+    for (uint8_t zone = 0; zone < CIRC_ZONES; zone++) {
+        ctx.zones[zone].pump_on = (warm_state.pumps_on & (1 << zone)) ? true : false;
+        // Pulse runs while pump is on, unless return temperature has stopped it
+        if (ctx.zones[zone].pump_on) {
+            ctx.zones[zone].pulse = (warm_state.pulses_done & (1 << zone)) ? CIRC_PULSE_DONE : CIRC_PULSE_RUNNING;
+        }
+        ctx.zones[zone].last_pump_off_time = warm_state.last_pump_off_time[zone];
+        startZoneEvents(zone, warm_state.next_event_time[zone], !ctx.zones[zone].pump_on);
+    }
+    if (!getPendingEvent()) return false;
+    ctx.events.events[0].minute_alarm = (warm_state.flags & WARM_STATE_MINUTE_ALARM_FLAG) ? true : false;
+    return true;
 }
 
 // ========================================================================================================= Heartbeat handling
@@ -318,6 +701,8 @@ static void ChangePumpScheduleMode()
     }
 
     setModeLedOnOff( workweek_mode );
+    // Long press started a burst as well
+    stopDemandBurst(ctx.current_rtc_time + DEMAND_BUTTON_GUARD_TIME);
     setupFirstOn();
 }
 
@@ -329,48 +714,109 @@ static bool isModeButtonOn()
 static void HandleModeButton()
 {
     static const uint16_t ALREADY_HANDLED= 0xFFFF;
-    static uint16_t on_timer = 0;
 
     if (! isModeButtonOn()) {
-        on_timer = 0;
+        ctx.mode_button_timer = 0;
         return;
-    } else if ( on_timer==ALREADY_HANDLED ) {
+    } else if ( ctx.mode_button_timer==ALREADY_HANDLED ) {
         return;
     }
 
-    on_timer++;
+    ctx.mode_button_timer++;
 
-    if (on_timer>MODE_CHANGE_TICKS) {
-        on_timer = ALREADY_HANDLED;
+    if (ctx.mode_button_timer>MODE_CHANGE_TICKS) {
+        ctx.mode_button_timer = ALREADY_HANDLED;
         ChangePumpScheduleMode();
     }
 }
 
+// ========================================================================================================= Serial commands handling
+
+static void HandleSerialCommands()
+{
+    if (!Serial.available()) return;
+
+    switch (Serial.read()) {
+    case 'e': {
+        i2c_bus_stats_t bus_stats;
+        DS3231Drv::getBusStats(&bus_stats);
+        PRINT2("RTC errors: ", ctx.rtc_errors);
+        PRINT2(", I2C NACKs: ", bus_stats.nacks);
+        PRINT2(", timeouts: ", bus_stats.timeouts);
+        PRINTLN2(", recoveries: ", bus_stats.recoveries);
+        break;
+    }
+    case 'd':
+        PRINT2("DCF77 frames: ", Dcf77::stats.frames);
+        PRINT2(", errors: ", Dcf77::stats.errors);
+        PRINT2(", confirmed: ", Dcf77::stats.confirmed);
+        PRINT2(", glitches: ", Dcf77::stats.glitches);
+        PRINTLN2(", overflows: ", Dcf77::stats.overflows);
+        break;
+#ifdef PROFILE
+    case 'p':
+        PROFILE_DUMP();
+        break;
+#endif
+    default:
+        break;
+    }
+}
+
 // ========================================================================================================= setup()
 void setup()
 {
   Serial.begin(9600);
+  readReturnTemps();
+
+  // Learned table has to be ready before schedule is used, it starts as work week table of its zone
+  for (uint8_t zone = CIRC_ZONES; zone--; ) {
+      if (zone_tables[zone].learned) CircAdaptive::begin(zone_tables[zone].workweek, &adaptive_config);
+  }
 
-  // Initialize DS3231
-  PRINTLN("Initializing Circulation Pump Driver...");
+  // Restart after reset() - pump, pulse and mode are restored and relay keeps its state
+  bool warm = restoreWarmState();
 
-  digitalWrite(PUMP_PIN, LOW);
-  pinMode(PUMP_PIN, OUTPUT);
+  PRINTLN(warm ? "Restarting Circulation Pump Driver..." : "Initializing Circulation Pump Driver...");
+
+  // Demand burst is not restored, relay follows the restored pulse
+  stopDemandBurst(0);
+  for (uint8_t zone = 0; zone < CIRC_ZONES; zone++) {
+      digitalWrite(PUMP_PINS[zone], isPumpRelayOn(zone) ? HIGH : LOW);
+      pinMode(PUMP_PINS[zone], OUTPUT);
+  }
 
   pinMode(MODE_BTN_PIN, INPUT_PULLUP);
+  pinMode(DEMAND_PIN, INPUT_PULLUP);
+  pinMode(DCF77_PIN, INPUT);
+  Dcf77::begin();
 
-  digitalWrite(RED_LED, LOW);
+  setModeLedOnOff( !isWorkweekScheduleTable() );
   pinMode(RED_LED, OUTPUT);
 
   digitalWrite(GREEN_LED, LOW);
   pinMode(GREEN_LED, OUTPUT);
 
-
-  initRtc();
-  ReadAndAdjustRTC();
-
-  readDateTimeFromRtc();
-  setupFirstOn();
+  PROFILE_INIT();
+
+  if (warm && isRtcWarm()) {
+      // Pending pump event is already set in RTC Alarm1 or signalled by Alarm2. Reset during the alarm burst of
+      // CheckCircPumpEvent() leaves the fired flag and old Alarm1, so event not due yet is armed again.
+      readDateTimeFromRtc();
+      if (getPendingEvent()->time > ctx.current_rtc_time) {
+          RTC_CHECK( writeEventAlarm( getPendingEvent() ) );
+          readDateTimeFromRtc();
+      }
+  } else {
+      initRtc();
+      ReadAndAdjustRTC();
+
+      readDateTimeFromRtc();
+      setupFirstOn();
+  }
+  attachInterrupt(DEMAND_PIN, onDemandInputEdge, FALLING);
+  attachInterrupt(MODE_BTN_PIN, onDemandEdge, FALLING);
+  attachInterrupt(DCF77_PIN, onDcf77Edge, (DCF77_PULSE_LEVEL == HIGH) ? RISING : FALLING);
   PRINTLN("Entering main loop...");
 }
 
@@ -378,24 +824,31 @@ void setup()
 
 void loop()
 {
-    ticks++;
+    ctx.ticks++;
 
-    if (!(ticks % RTC_READ_TICKS)) {
+    if (!(ctx.ticks % RTC_READ_TICKS)) {
         readDateTimeFromRtc();
     }
 
     HandleModeButton();
+    HandleDemand();
+    HandleAdaptive();
+    HandleDcf77();
+    HandleSerialCommands();
 
-    if ( !(ticks % CHECK_PUMP_TICKS) ) {
+    if ( !(ctx.ticks % CHECK_PUMP_TICKS) ) {
         CheckCircPumpEvent();
+        HandleReturnTemp();
     }
 
-    if (!(ticks % HEARTBEAT_ON_TICKS) ) {
+    if (!(ctx.ticks % HEARTBEAT_ON_TICKS) ) {
         setHeartbeatLedOnOff(true);
-    } else  if (!(ticks % HEARTBEAT_OFF_TICKS) ) {
+    } else  if (!(ctx.ticks % HEARTBEAT_OFF_TICKS) ) {
         setHeartbeatLedOnOff(false);
     }
 
+    planNextEvent();
+
     delay(TICK_TIME);
 }
 
@@ -18,10 +18,12 @@
  */
 
 #include <CircShedule.h>
+#include "dbgprofile.h"
 
 
 uint32_t CircShedule::getNextOnTime(const circ_shedule_table_t* shedule_table, uint32_t epoch)
 {
+    PROFILE_SCOPE("CircShedule::getNextOnTime");
     if (!shedule_table || epoch == DateTime::EPOCH_ERROR) return DateTime::EPOCH_ERROR;
 
     dt_time_t time;
@@ -42,8 +44,35 @@ uint32_t CircShedule::getNextOnTime(const circ_shedule_table_t* shedule_table, u
             return epoch;
         }
     }
-    // We found not entry for this day, so get first entry for next day
-    epoch += DateTime::ONE_DAY;
-    day = DateTime::getDayTypeFromEpoch(epoch);
-    return epoch - CT_TO_S(ct- ((*shedule_table)[day][0]).beg);
+    // We found not entry for this day, so get first entry of the next day which has any (learned tables may have
+    // days without windows)
+    for (uint8_t days = 0; days < DateTime::DAYS_COUNT; days++) {
+        epoch += DateTime::ONE_DAY;
+        day = DateTime::getDayTypeFromEpoch(epoch);
+        day_table = &((*shedule_table)[day][0]);
+        if (day_table->beg < day_table->end) return epoch - CT_TO_S(ct - day_table->beg);
+    }
+    return DateTime::EPOCH_ERROR;
+}
+
+uint32_t CircShedule::getNextPulseOffTime(const circ_pulse_config_t* pulse, uint32_t now, uint32_t last_off_time)
+{
+    // First time after longer perdiod we'll let Pump be on for longer time as pipes may be colder
+    return now + ( isFirstPulse(pulse, now, last_off_time) ? pulse->on_time_first : pulse->on_time_next );
+}
+
+uint32_t CircShedule::getNextPulseOnTime(const circ_shedule_table_t* shedule_table, const circ_pulse_config_t* pulse,
+                                         uint32_t now, uint32_t last_off_time)
+{
+    PROFILE_SCOPE("CircShedule::getNextPulseOnTime");
+    uint32_t on_time =  now + ( isFirstPulse(pulse, now, last_off_time) ? pulse->off_time_first : pulse->off_time_next );
+    // Schedule tables are in local time
+    on_time = DateTime::getUtcDateTimeFromLocal(
+                getNextOnTime(shedule_table, DateTime::getLocalDateTimeFromUtc( on_time ) )
+            );
+    // Check Daylight Saving Time case
+    if (on_time < now) {
+        on_time += ((now - on_time) / DateTime::ONE_HOUR + 1) * DateTime::ONE_HOUR;
+    }
+    return on_time;
 }
@@ -36,10 +36,26 @@ typedef circ_shedule_entry_t circ_shedule_day_t[CIRC_PERIODS_PER_DAY];
 
 typedef circ_shedule_entry_t circ_shedule_table_t[DateTime::DAYS_COUNT][CIRC_PERIODS_PER_DAY];
 
+// Pump pulses inside on-window, in seconds
+typedef struct circ_pulse_config_s
+{
+    uint16_t on_time_first;     ///< Used after break longer than 2*off_time_first, as pipes may be colder
+    uint16_t off_time_first;
+    uint16_t on_time_next;
+    uint16_t off_time_next;
+} circ_pulse_config_t;
+
 
 class CircShedule {
 public:
     static uint32_t getNextOnTime(const circ_shedule_table_t* shedule_table, uint32_t timestamp);
+    // Pulse edges, all times are RTC (UTC) ones
+    static bool isFirstPulse(const circ_pulse_config_t* pulse, uint32_t now, uint32_t last_off_time) {
+        return (now - last_off_time) > 2U * pulse->off_time_first;
+    }
+    static uint32_t getNextPulseOffTime(const circ_pulse_config_t* pulse, uint32_t now, uint32_t last_off_time);
+    static uint32_t getNextPulseOnTime(const circ_shedule_table_t* shedule_table, const circ_pulse_config_t* pulse,
+                                       uint32_t now, uint32_t last_off_time);
 };
 
 #endif /* CIRCSHEDULE_H_ */
@@ -0,0 +1,60 @@
+/**
+ * CircThermal.cpp - Return pipe temperature and pump pulses stopped by it
+ * This file is a part of Water Circulation Pump driver
+ *
+ * Copyright (c) 2017, Rafal Kukla. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the name of the "Rafal Kukla" nor the names of its contributors may be used to endorse or
+ *   promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ */
+
+#include <CircThermal.h>
+
+
+// ADC readings at 0, 10, ... 100 Celsius degrees, linear between them is within 0.5 degree
+static const uint16_t NTC_ADC[] = { 788, 684, 569, 456, 354, 270, 204, 153, 115, 87, 67 };
+static const uint8_t  NTC_STEPS = sizeof(NTC_ADC) / sizeof(*NTC_ADC) - 1;
+static const int16_t  NTC_STEP_TEMP = CIRC_TEMP(10);
+// Beyond them sensor or its wiring is broken
+static const uint16_t NTC_ADC_SHORTED = 20;
+static const uint16_t NTC_ADC_OPEN = 1000;
+
+const int16_t CircThermal::TEMP_ERROR;
+
+int16_t CircThermal::getTemperature(uint16_t adc)
+{
+    if (adc <= NTC_ADC_SHORTED || adc >= NTC_ADC_OPEN) return TEMP_ERROR;
+    if (adc >= NTC_ADC[0]) return 0;
+
+    uint8_t step = 0;
+    while (step < NTC_STEPS && adc < NTC_ADC[step + 1]) step++;
+    if (step == NTC_STEPS) return NTC_STEPS * NTC_STEP_TEMP;
+
+    int16_t span = NTC_ADC[step] - NTC_ADC[step + 1];
+    return step * NTC_STEP_TEMP + (static_cast<int16_t>(NTC_ADC[step] - adc) * NTC_STEP_TEMP + span / 2) / span;
+}
+
+circ_pulse_state_t CircThermal::updatePulse(const circ_thermal_config_t* config, circ_pulse_state_t state, bool pump_on,
+                                            int16_t temperature)
+{
+    if (!pump_on) return CIRC_PULSE_IDLE;
+    if (temperature == TEMP_ERROR) return (state == CIRC_PULSE_DONE) ? state : CIRC_PULSE_RUNNING;
+
+    switch (state) {
+    case CIRC_PULSE_IDLE:
+        return (temperature >= config->warm_temp) ? CIRC_PULSE_DONE : CIRC_PULSE_RUNNING;
+    case CIRC_PULSE_RUNNING:
+        return (temperature >= config->stop_temp) ? CIRC_PULSE_DONE : CIRC_PULSE_RUNNING;
+    default:
+        return state;
+    }
+}
@@ -0,0 +1,64 @@
+/**
+ * CircThermal.h - Return pipe temperature and pump pulses stopped by it
+ * This file is a part of Water Circulation Pump driver
+ *
+ * Copyright (c) 2017, Rafal Kukla. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the name of the "Rafal Kukla" nor the names of its contributors may be used to endorse or
+ *   promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ */
+
+#ifndef CIRCTHERMAL_H_
+#define CIRCTHERMAL_H_
+
+#include <stdint.h>
+
+// Temperature in 1/4 of Celsius degree, as DS3231 gives it
+#define CIRC_TEMP(_deg_) ((_deg_) * 4)
+
+typedef struct circ_thermal_config_s
+{
+    int16_t warm_temp;      ///< Pulse is skipped when return pipe is at least that warm at its start
+    int16_t stop_temp;      ///< Running pulse is stopped when return pipe gets that warm
+    uint8_t sensor_zones;   ///< Bit of every zone with NTC fitted, the others are not read and get TEMP_ERROR
+} circ_thermal_config_t;
+
+// Pump pulse of one zone gated by its return temperature
+typedef enum
+{
+    CIRC_PULSE_IDLE,        ///< Pump is off by schedule
+    CIRC_PULSE_RUNNING,
+    CIRC_PULSE_DONE         ///< Stopped or skipped, pump stays off till the end of the pulse
+} circ_pulse_state_t;
+
+/**
+ * NTC on the return pipe of a zone, read by ADC. Schedule and its RTC alarms are not changed, pulse only drives
+ * the relay while the loop is cold. Sensor fault gives TEMP_ERROR and plain time based pulses.
+ */
+class CircThermal
+{
+public:
+    static const int16_t TEMP_ERROR = INT16_MIN;
+
+    // 10-bit ADC of 10k B3950 NTC to ground with 10k to Vcc, open or shorted sensor gives TEMP_ERROR
+    static int16_t getTemperature(uint16_t adc);
+    // Zone without NTC is not read, its pulses are never gated
+    static bool hasSensor(const circ_thermal_config_t* config, uint8_t zone)
+    {
+        return (config->sensor_zones & (1 << zone)) ? true : false;
+    }
+    // Pulse state after a new reading, pump_on is the state set by schedule
+    static circ_pulse_state_t updatePulse(const circ_thermal_config_t* config, circ_pulse_state_t state, bool pump_on,
+                                          int16_t temperature);
+};
+
+#endif /* CIRCTHERMAL_H_ */
@@ -19,6 +19,7 @@
 
 
 #include <DS3231Drv.h>
+#include "dbgprofile.h"
 
 #if 0
 #if ARDUINO >= 100
@@ -28,11 +29,6 @@
 #endif
 #endif 
 
-extern "C" {
-#include <twi.h>
-}
-
-
 #define DS3231_ADDRESS              (0x68)
 
 #define DS3231_REG_TIME             (0x00)
@@ -40,8 +36,17 @@ extern "C" {
 #define DS3231_REG_ALARM_2          (0x0B)
 #define DS3231_REG_CONTROL          (0x0E)
 #define DS3231_REG_STATUS           (0x0F)
+#define DS3231_REG_AGING            (0x10)
 #define DS3231_REG_TEMPERATURE      (0x11)
 
+/*
+Aging Offset (10h):
+    Two's complement value added to the capacitance array registers, positive values add capacitance
+    and lower the oscillator frequency. At +25C one LSB is typically 0.1ppm.
+    New value is used after next temperature conversion.
+*/
+static const int16_t DS3231_AGING_LSB_PPB = 100;
+
 /*
 Control Register(0Eh) Bits:
 
@@ -222,6 +227,11 @@ static_assert(sizeof(ds3231_datetime_req) == ds3231_datetime_req::size, "Wrong c
 typedef ds3231_reg_req<ds3231_datetime_req> ds3231_datetime_reg_req;
 static_assert(sizeof(ds3231_datetime_reg_req) == ds3231_datetime_reg_req::size, "Wrong compiler alignment configuration");
 
+// Alarm registers fields
+static const uint8_t FIELD_IGNORE_MASK = 0b10000000;    ///< AxMy bit
+static const uint8_t FIELD_MATCH_MASK = static_cast<uint8_t>(~FIELD_IGNORE_MASK);
+static const uint8_t FIELD_MATCH_DAY_OF_WEEK_MASK = 0b01000000;
+
 struct ds3231_alarm1_s {
     uint8_t second;
     uint8_t minute;
@@ -234,82 +244,271 @@ static_assert(sizeof(ds3231_alarm1_req) == ds3231_alarm1_req::size, "Wrong compi
 
 typedef ds3231_reg_req<ds3231_alarm1_req>  ds3231_alarm1_reg_req;
 static_assert(sizeof(ds3231_alarm1_reg_req) == ds3231_alarm1_reg_req::size, "Wrong compiler alignment configuration");
+static_assert(sizeof(DS3231_alarm1_image_t) == ds3231_alarm1_reg_req::size, "Alarm 1 image does not match request size");
+
+struct ds3231_alarm2_s {
+    uint8_t minute;
+    uint8_t hour;
+    uint8_t day;
+};
+
+typedef ds3231_req<ds3231_alarm2_s> ds3231_alarm2_req;
+static_assert(sizeof(ds3231_alarm2_req) == ds3231_alarm2_req::size, "Wrong compiler alignment configuration");
+
+typedef ds3231_reg_req<ds3231_alarm2_req>  ds3231_alarm2_reg_req;
+static_assert(sizeof(ds3231_alarm2_reg_req) == ds3231_alarm2_reg_req::size, "Wrong compiler alignment configuration");
+static_assert(sizeof(DS3231_alarm2_image_t) == ds3231_alarm2_reg_req::size, "Alarm 2 image does not match request size");
+
+// All registers from Time up to Temperature
+struct ds3231_snapshot_s {
+    struct ds3231_datetime_s datetime;
+    struct ds3231_alarm1_s   alarm1;
+    struct ds3231_alarm2_s   alarm2;
+    uint8_t                  control;
+    uint8_t                  status;
+    uint8_t                  aging;
+    uint8_t                  temperature[2];
+};
+
+typedef ds3231_req<ds3231_snapshot_s> ds3231_snapshot_req;
+static_assert(sizeof(ds3231_snapshot_req) == ds3231_snapshot_req::size, "Wrong compiler alignment configuration");
+static_assert(offsetof(ds3231_snapshot_s, aging) == DS3231_REG_STATUS + 1, "Snapshot does not match registers map");
+static_assert(offsetof(ds3231_snapshot_s, temperature) == DS3231_REG_TEMPERATURE, "Snapshot does not match registers map");
 
 #pragma pack(pop)
 
-bool DS3231Drv::begin()
+// Shadow copy of Alarm 1, Alarm 2, Control and Status registers.
+// Read-modify-write of those registers needs no read, unchanged values are not written at all and
+// writes done between beginBatch() and commitBatch() are merged into single burst.
+// Shadow is re-read from device after any I2C error or when Oscillator Stop Flag is set.
+// NOTE: Alarm flags are not tracked in Status shadow - they are always read from device
+#define DS3231_SHADOW_FIRST         DS3231_REG_ALARM_1
+#define DS3231_SHADOW_LAST          DS3231_REG_STATUS
+#define DS3231_SHADOW_SIZE          (DS3231_SHADOW_LAST - DS3231_SHADOW_FIRST + 1)
+#define DS3231_SHADOW_NONE          (0xFF)
+
+struct ds3231_shadow_s {
+    uint8_t regs[DS3231_SHADOW_SIZE];
+    uint8_t dirty_first;    ///< First register to be written or DS3231_SHADOW_NONE
+    uint8_t dirty_last;     ///< Last register to be written
+    uint8_t batch;          ///< beginBatch() nesting level
+    bool    valid;
+
+    static bool isShadowed(uint8_t reg) { return reg >= DS3231_SHADOW_FIRST && reg <= DS3231_SHADOW_LAST; }
+    uint8_t& reg(uint8_t reg)           { return regs[reg - DS3231_SHADOW_FIRST]; }
+    bool isDirty() const                { return dirty_first != DS3231_SHADOW_NONE; }
+    bool isDirty(uint8_t reg) const     { return isDirty() && reg >= dirty_first && reg <= dirty_last; }
+
+    void reset()
+    {
+        dirty_first = dirty_last = DS3231_SHADOW_NONE;
+        batch = 0;
+        valid = false;
+    }
+
+    void update(uint8_t reg, const uint8_t* data, uint8_t size)
+    {
+        for (; size; size--, reg++, data++) {
+            if (isShadowed(reg)) this->reg(reg) = *data;
+            if (reg == DS3231_REG_STATUS && (*data & DS3231_REG_STATUS_OSF_BIT_MASK)) valid = false;
+        }
+    }
+
+    void set(uint8_t reg, uint8_t value)
+    {
+        this->reg(reg) = value;
+        if (dirty_first == DS3231_SHADOW_NONE || reg < dirty_first) dirty_first = reg;
+        if (dirty_last  == DS3231_SHADOW_NONE || reg > dirty_last)  dirty_last = reg;
+    }
+};
+
+template <class Bus>
+ds3231_shadow_s DS3231DrvT<Bus>::shadow;
+
+template <class Bus>
+bool DS3231DrvT<Bus>::busWrite(const uint8_t* request, uint8_t request_size)
+{
+    PROFILE_SCOPE("DS3231Drv::writeRequest");
+    return Bus::write(DS3231_ADDRESS, request[0], request + 1, request_size - 1);
+}
+
+template <class Bus>
+bool DS3231DrvT<Bus>::busRead(uint8_t reg, uint8_t* request, uint8_t request_size)
+{
+    PROFILE_SCOPE("DS3231Drv::readReg");
+    return Bus::read(DS3231_ADDRESS, reg, request, request_size);
+}
+
+// Writes all dirty shadow registers in one burst
+template <class Bus>
+bool DS3231DrvT<Bus>::flushShadow()
 {
-    twi_init();
+    if (!shadow.isDirty()) return true;
+
+    uint8_t request[DS3231_SHADOW_SIZE + 1];
+    uint8_t size = 0;
 
+    request[size++] = shadow.dirty_first;
+    for (uint8_t reg = shadow.dirty_first; reg <= shadow.dirty_last; reg++) {
+        request[size++] = shadow.reg(reg);
+    }
+    if (! busWrite(request, size) ) {
+        // Registers stay dirty, so they are written by the next flush
+        shadow.valid = false;
+        return false;
+    }
+    shadow.dirty_first = shadow.dirty_last = DS3231_SHADOW_NONE;
     return true;
 }
 
-// First byte of request buffer must be a register address
-bool DS3231Drv::writeRequest(const uint8_t* request, uint8_t request_size)
+template <class Bus>
+bool DS3231DrvT<Bus>::validateShadow()
+{
+    if (shadow.valid) return true;
+
+    uint8_t regs[DS3231_SHADOW_SIZE];
+    shadow.valid = true; // Cleared by readReg() on error or when OSF is set
+    return readReg(DS3231_SHADOW_FIRST, regs, DS3231_SHADOW_SIZE);
+}
+
+template <class Bus>
+bool DS3231DrvT<Bus>::writeShadowRegs(const uint8_t* request, uint8_t request_size)
+{
+    if (! validateShadow() ) return false;
+
+    uint8_t reg = request[0];
+    for (uint8_t i=1; i<request_size; i++, reg++) {
+        if (shadow.isDirty(reg) || shadow.reg(reg) != request[i]) {
+            shadow.set(reg, request[i]);
+        }
+    }
+    return shadow.batch ? true : flushShadow();
+}
+
+template <class Bus>
+bool DS3231DrvT<Bus>::begin()
 {
-    return ( twi_writeTo(DS3231_ADDRESS, const_cast<uint8_t*>(request), request_size, true, true) == 0 );
+    shadow.reset();
+
+    return Bus::begin();
 }
 
-bool DS3231Drv::readReg(uint8_t reg, uint8_t* request, uint8_t request_size)
+template <class Bus>
+void DS3231DrvT<Bus>::recoverBus()
 {
-    if ( twi_writeTo(DS3231_ADDRESS, &reg, 1, true, true) ) return false;
-    if ( twi_readFrom( DS3231_ADDRESS, request, request_size, true) != request_size) return false;
+    Bus::recover();
+    shadow.valid = false;
+}
 
+template <class Bus>
+void DS3231DrvT<Bus>::beginBatch()
+{
+    shadow.batch++;
+}
+
+template <class Bus>
+bool DS3231DrvT<Bus>::commitBatch()
+{
+    if (shadow.batch) shadow.batch--;
+    return shadow.batch ? true : flushShadow();
+}
+
+// First byte of request buffer must be a register address
+template <class Bus>
+bool DS3231DrvT<Bus>::writeRequest(const uint8_t* request, uint8_t request_size)
+{
+    if (! flushShadow() ) return false;
+    if (! busWrite(request, request_size) ) {
+        shadow.valid = false;
+        return false;
+    }
+    shadow.update(request[0], request + 1, request_size - 1);
+    return true;
+}
+
+template <class Bus>
+bool DS3231DrvT<Bus>::readReg(uint8_t reg, uint8_t* request, uint8_t request_size)
+{
+    if (! flushShadow() ) return false;
+    if (! busRead(reg, request, request_size) ) {
+        shadow.valid = false;
+        return false;
+    }
+    shadow.update(reg, request, request_size);
     return true;
 }
 
-bool DS3231Drv::writeMaskReg(uint8_t reg, uint8_t value, uint8_t mask)
+template <class Bus>
+bool DS3231DrvT<Bus>::writeMaskReg(uint8_t reg, uint8_t value, uint8_t mask)
 {
     uint8_t read;
-    if (! readReg(reg,&read) ) return false;
+
+    if (ds3231_shadow_s::isShadowed(reg)) {
+        if (! validateShadow() ) return false;
+        read = shadow.reg(reg);
+        if (reg == DS3231_REG_STATUS && !shadow.isDirty(reg)) {
+            // Alarm and oscillator stop flags can be only cleared, writing 1 leaves them unchanged.
+            // Shadow may be older than a flag set by device since.
+            read |= DS3231_REG_STATUS_A1F_BIT_MASK | DS3231_REG_STATUS_A2F_BIT_MASK | DS3231_REG_STATUS_OSF_BIT_MASK;
+        }
+    } else if (! readReg(reg,&read) ) {
+        return false;
+    }
 
     read &= ~mask;
     read |= value & mask;
 
+    if (ds3231_shadow_s::isShadowed(reg)) {
+        // Status is always written, as its flags are set by device
+        if (reg != DS3231_REG_STATUS && !shadow.isDirty(reg) && read == shadow.reg(reg)) return true;
+        shadow.set(reg, read);
+        return shadow.batch ? true : flushShadow();
+    }
     return writeReg(reg, read);
 }
 
 
-bool DS3231Drv::readStatusReg(uint8_t* out_status)
+template <class Bus>
+bool DS3231DrvT<Bus>::readStatusReg(uint8_t* out_status)
 {
     return readReg(DS3231_REG_STATUS, out_status, 1);
 }
 
-bool DS3231Drv::writeStatusReg(uint8_t status)
+template <class Bus>
+bool DS3231DrvT<Bus>::writeStatusReg(uint8_t status)
 {
     return writeReg(DS3231_REG_STATUS, status);
 }
 
-bool DS3231Drv::readControlReg(uint8_t* out_control)
+template <class Bus>
+bool DS3231DrvT<Bus>::readControlReg(uint8_t* out_control)
 {
     return readReg(DS3231_REG_CONTROL, out_control, 1);
 }
 
-bool DS3231Drv::writeControlReg(uint8_t control)
+template <class Bus>
+bool DS3231DrvT<Bus>::writeControlReg(uint8_t control)
 {
     return writeReg(DS3231_REG_CONTROL, control);
 }
 
 
-bool DS3231Drv::getDateTime(dt_date_t* date, dt_time_t* time)
+template <class Bus>
+bool DS3231DrvT<Bus>::decodeDateTime(const ds3231_datetime_s* regs, dt_date_t* date, dt_time_t* time)
 {
     bool result = true;
 
-    ds3231_datetime_req req;
-
-    if (!readReg(DS3231_REG_TIME, req.buf,req.size) ) return false;
-
     if (date) {
-        date->year =   bcd2dec(req.req.date.year) + 2000;
-        date->month =  bcd2dec(req.req.date.month & 0x7F);
-        date->day =    bcd2dec(req.req.date.day);
+        date->year =   bcd2dec(regs->date.year) + 2000;
+        date->month =  bcd2dec(regs->date.month & 0x7F);
+        date->day =    bcd2dec(regs->date.day);
 
         result &= DateTime::isDateValid(date);
     }
     if (time) {
-        time->hour =   bcd2dec(req.req.time.hour & 0x3F);
-        time->minute = bcd2dec(req.req.time.minute);
-        time->second = bcd2dec(req.req.time.second);
+        time->hour =   bcd2dec(regs->time.hour & 0x3F);
+        time->minute = bcd2dec(regs->time.minute);
+        time->second = bcd2dec(regs->time.second);
 
         result &= DateTime::isTimeValid(time);
     }
@@ -317,9 +516,95 @@ bool DS3231Drv::getDateTime(dt_date_t* date, dt_time_t* time)
     return result;
 }
 
+template <class Bus>
+bool DS3231DrvT<Bus>::getDateTime(dt_date_t* date, dt_time_t* time)
+{
+    ds3231_datetime_req req;
+
+    if (!readReg(DS3231_REG_TIME, req.buf,req.size) ) return false;
+
+    return decodeDateTime(&req.req, date, time);
+}
+
+// 10 bit two's complement value, upper byte is integer part, bits 7:6 of lower byte are quarters
+static inline int16_t decodeTemperature(const uint8_t* temp)
+{
+    return static_cast<int16_t>( (static_cast<uint16_t>(temp[0]) << 8) | temp[1] ) >> 6;
+}
+
+template <class Bus>
+bool DS3231DrvT<Bus>::readSnapshot(DS3231_snapshot_t* snapshot, bool with_temperature)
+{
+    ds3231_snapshot_req req;
+    uint8_t size = with_temperature ? req.size : offsetof(ds3231_snapshot_s, aging);
+
+    if (!readReg(DS3231_REG_TIME, req.buf, size) ) return false;
+    // Whole shadow was just read
+    shadow.valid = !(req.req.status & DS3231_REG_STATUS_OSF_BIT_MASK);
+
+    snapshot->alarm1      = (req.req.status  & DS3231_REG_STATUS_A1F_BIT_MASK) ? true : false;
+    snapshot->alarm2      = (req.req.status  & DS3231_REG_STATUS_A2F_BIT_MASK) ? true : false;
+    snapshot->osc_stopped = (req.req.status  & DS3231_REG_STATUS_OSF_BIT_MASK) ? true : false;
+    snapshot->armed1      = (req.req.control & DS3231_REG_CONTROL_A1IE_BIT_MASK) ? true : false;
+    snapshot->armed2      = (req.req.control & DS3231_REG_CONTROL_A2IE_BIT_MASK) ? true : false;
+    snapshot->temperature = with_temperature ? decodeTemperature(req.req.temperature) : DS3231_NO_TEMPERATURE;
+
+    return decodeDateTime(&req.req.datetime, &snapshot->date, &snapshot->time);
+}
+
+template <class Bus>
+bool DS3231DrvT<Bus>::readTemperature(int16_t* out_temperature)
+{
+    uint8_t temp[2];
+    if (!readReg(DS3231_REG_TEMPERATURE, temp, sizeof(temp)) ) return false;
 
+    *out_temperature = decodeTemperature(temp);
+    return true;
+}
 
-bool DS3231Drv::setDateTime(const dt_date_t* date, const dt_time_t* time, uint32_t epoch)
+// When conversion is already in progress nothing is done, the next one starts within 64s anyway
+template <class Bus>
+bool DS3231DrvT<Bus>::startTemperatureConversion()
+{
+    uint8_t status;
+    if (!readStatusReg(&status) ) return false;
+    if (status & DS3231_REG_STATUS_BSY_BIT_MASK) return true;
+
+    return regBitSet(DS3231_REG_CONTROL, DS3231_REG_CONTROL_CONV_BIT);
+}
+
+template <class Bus>
+bool DS3231DrvT<Bus>::readAgingOffset(int8_t* out_offset)
+{
+    uint8_t value;
+    if (!readReg(DS3231_REG_AGING, &value) ) return false;
+
+    *out_offset = static_cast<int8_t>(value);
+    return true;
+}
+
+template <class Bus>
+bool DS3231DrvT<Bus>::writeAgingOffset(int8_t offset)
+{
+    return writeReg(DS3231_REG_AGING, static_cast<uint8_t>(offset)) && startTemperatureConversion();
+}
+
+template <class Bus>
+int8_t DS3231DrvT<Bus>::computeAgingOffset(int8_t offset, int32_t drift_ppb)
+{
+    // Rounded to the nearest LSB, clock running fast needs more capacitance
+    int32_t correction = (drift_ppb + ((drift_ppb < 0) ? -DS3231_AGING_LSB_PPB/2 : DS3231_AGING_LSB_PPB/2)) / DS3231_AGING_LSB_PPB;
+    int32_t result = offset + correction;
+
+    if (result > 127)  return 127;
+    if (result < -128) return -128;
+    return static_cast<int8_t>(result);
+}
+
+
+
+template <class Bus>
+bool DS3231DrvT<Bus>::setDateTime(const dt_date_t* date, const dt_time_t* time, uint32_t epoch)
 {
     ds3231_datetime_reg_req req;
 
@@ -335,20 +620,23 @@ bool DS3231Drv::setDateTime(const dt_date_t* date, const dt_time_t* time, uint32
     return writeRequest(req.buf,req.size);
 }
 
-bool DS3231Drv::setDateTime(uint32_t epoch)
+template <class Bus>
+bool DS3231DrvT<Bus>::setDateTime(uint32_t epoch)
 {
     dt_date_t date;
     dt_time_t time;
     DateTime::setDateTimeFromEpoch(epoch, &date, &time);
     return  setDateTime(&date, &time, epoch);
 }
-bool DS3231Drv::setDateTime(const dt_date_t* date, const dt_time_t* time)
+template <class Bus>
+bool DS3231DrvT<Bus>::setDateTime(const dt_date_t* date, const dt_time_t* time)
 {
     return setDateTime(date, time, DateTime::getEpochFromDateTime(date, time));
 }
 
 
-bool DS3231Drv::readAlarm(uint8_t status_reg_bit_maks, bool& result,  bool clear)
+template <class Bus>
+bool DS3231DrvT<Bus>::readAlarm(uint8_t status_reg_bit_maks, bool& result,  bool clear)
 {
     uint8_t status;
     if ( !readStatusReg(&status) ) return false;
@@ -363,77 +651,80 @@ bool DS3231Drv::readAlarm(uint8_t status_reg_bit_maks, bool& result,  bool clear
     return true;
 }
 
-bool DS3231Drv::clearAlarm1(void)
+template <class Bus>
+bool DS3231DrvT<Bus>::clearAlarm1(void)
 {
-    bool ignore = false;
-    return readAlarm1(ignore,true);
+    return writeMaskReg(DS3231_REG_STATUS, 0, DS3231_REG_STATUS_A1F_BIT_MASK);
 }
 
-bool DS3231Drv::readAlarm1(bool& result, bool clear)
+template <class Bus>
+bool DS3231DrvT<Bus>::readAlarm1(bool& result, bool clear)
 {
     return readAlarm(DS3231_REG_STATUS_A1F_BIT_MASK, result, clear);
 }
 
-bool DS3231Drv::isAlarm1(bool clear)
+template <class Bus>
+bool DS3231DrvT<Bus>::isAlarm1(bool clear)
 {
     bool isAlarm = false;
     readAlarm1(isAlarm,clear);
     return isAlarm;
 }
 
-bool DS3231Drv::armAlarm1(bool armed)
+template <class Bus>
+bool DS3231DrvT<Bus>::armAlarm1(bool armed)
 {
     uint8_t value = armed ? DS3231_REG_CONTROL_A1IE_BIT_MASK : 0;
 
     return  writeMaskReg(DS3231_REG_CONTROL, value, DS3231_REG_CONTROL_A1IE_BIT_MASK);
 }
 
-bool DS3231Drv::isArmed1(void)
+template <class Bus>
+bool DS3231DrvT<Bus>::isArmed1(void)
 {
-    uint8_t value;
-    if (! readStatusReg(&value) ) return false;
-    return (value & DS3231_REG_CONTROL_A1IE_BIT_MASK) ? true : false;
+    if (!validateShadow()) return false;
+    return (shadow.reg(DS3231_REG_CONTROL) & DS3231_REG_CONTROL_A1IE_BIT_MASK) ? true : false;
 }
 
 
-bool DS3231Drv::clearAlarm2(void)
+template <class Bus>
+bool DS3231DrvT<Bus>::clearAlarm2(void)
 {
-    bool ignore = false;
-    return readAlarm2(ignore,true);
+    return writeMaskReg(DS3231_REG_STATUS, 0, DS3231_REG_STATUS_A2F_BIT_MASK);
 }
 
-bool DS3231Drv::readAlarm2(bool& result, bool clear) {
+template <class Bus>
+bool DS3231DrvT<Bus>::readAlarm2(bool& result, bool clear) {
     return readAlarm(DS3231_REG_STATUS_A2F_BIT_MASK, result, clear);
 }
 
-bool DS3231Drv::isAlarm2(bool clear)
+template <class Bus>
+bool DS3231DrvT<Bus>::isAlarm2(bool clear)
 {
     bool isAlarm = false;
     readAlarm2(isAlarm,clear);
     return isAlarm;
 }
 
-bool DS3231Drv::armAlarm2(bool armed)
+template <class Bus>
+bool DS3231DrvT<Bus>::armAlarm2(bool armed)
 {
     uint8_t value = armed ? DS3231_REG_CONTROL_A2IE_BIT_MASK : 0;
 
     return  writeMaskReg(DS3231_REG_CONTROL, value, DS3231_REG_CONTROL_A2IE_BIT_MASK);
 }
 
-bool DS3231Drv::isArmed2(void)
+template <class Bus>
+bool DS3231DrvT<Bus>::isArmed2(void)
 {
-    uint8_t value;
-    if (!readStatusReg(&value)) return false;
-    return (value & DS3231_REG_CONTROL_A2IE_BIT_MASK) ? true : false ;
+    if (!validateShadow()) return false;
+    return (shadow.reg(DS3231_REG_CONTROL) & DS3231_REG_CONTROL_A2IE_BIT_MASK) ? true : false;
 }
 
 
-bool DS3231Drv::setAlarm1(uint8_t dydw, uint8_t hour, uint8_t minute, uint8_t second, DS3231_alarm1_t mode, bool armed)
+template <class Bus>
+void DS3231DrvT<Bus>::encodeAlarm1(DS3231_alarm1_image_t* image, uint8_t dydw, uint8_t hour, uint8_t minute, uint8_t second, DS3231_alarm1_t mode)
 {
-    static const uint8_t FIELD_IGNORE_MASK = 0b10000000;
-    static const uint8_t FIELD_MATCH_MASK = static_cast<uint8_t>(~FIELD_IGNORE_MASK);
-    static const uint8_t FIELD_MATCH_DAY_OF_WEEK_MASK = 0b01000000;
-
     second = dec2bcd(second) & FIELD_MATCH_MASK;
     minute = dec2bcd(minute) & FIELD_MATCH_MASK;
     hour   = dec2bcd(hour)   & FIELD_MATCH_MASK;
@@ -466,25 +757,128 @@ bool DS3231Drv::setAlarm1(uint8_t dydw, uint8_t hour, uint8_t minute, uint8_t se
     request.req.req.hour   = hour;
     request.req.req.day    = dydw;
 
-    if (!  writeRequest(request.buf, request.size) ) return false;
+    for (uint8_t i=0; i<request.size; i++) {
+        image->buf[i] = request.buf[i];
+    }
+}
+
+template <class Bus>
+bool DS3231DrvT<Bus>::writeAlarm1(const DS3231_alarm1_image_t* image)
+{
+    return writeShadowRegs(image->buf, sizeof(image->buf));
+}
 
-    if (! armAlarm1(armed) ) return false;
-    clearAlarm1();
+// Alarm registers, Control and Status are written in single burst
+template <class Bus>
+bool DS3231DrvT<Bus>::setAlarm1(const DS3231_alarm1_image_t* image, bool armed)
+{
+    beginBatch();
+    bool result = writeAlarm1(image) && armAlarm1(armed) && clearAlarm1();
 
-    return true;
+    return commitBatch() && result;
+}
+
+template <class Bus>
+bool DS3231DrvT<Bus>::setAlarm1(uint8_t dydw, uint8_t hour, uint8_t minute, uint8_t second, DS3231_alarm1_t mode, bool armed)
+{
+    DS3231_alarm1_image_t image;
+    encodeAlarm1(&image, dydw, hour, minute, second, mode);
+    return setAlarm1(&image, armed);
 }
 
-bool DS3231Drv::enableOscilatorOnBattery(bool enabled) {
-    uint8_t control;
-    if (!readControlReg(&control)) return false;
+template <class Bus>
+void DS3231DrvT<Bus>::encodeAlarm2(DS3231_alarm2_image_t* image, uint8_t dydw, uint8_t hour, uint8_t minute, DS3231_alarm2_t mode)
+{
+    minute = dec2bcd(minute) & FIELD_MATCH_MASK;
+    hour   = dec2bcd(hour)   & FIELD_MATCH_MASK;
+    dydw   = dec2bcd(dydw)   & FIELD_MATCH_MASK;
 
-    if (enabled)
+    switch (mode)
     {
-        control &= 0b01111011;
-    } else {
-        control |= 0b10000000;
+        // NOTE: no break;'s here is intented
+    case DS3231_EVERY_MINUTE:
+        minute |= FIELD_IGNORE_MASK;
+        /* fall through */
+    case DS3231_MATCH_M:
+        hour   |= FIELD_IGNORE_MASK;
+        /* fall through */
+    case DS3231_MATCH_H_M:
+        dydw   |= FIELD_IGNORE_MASK;
+        break;
+    case DS3231_MATCH_DY_H_M:
+        dydw   |= FIELD_MATCH_DAY_OF_WEEK_MASK;
+        break;
+    case DS3231_MATCH_DT_H_M:
+    default:
+        break;
     }
 
+    struct ds3231_reg_req<ds3231_alarm2_req> request;
+    request.reg_addr       = DS3231_REG_ALARM_2;
+    request.req.req.minute = minute;
+    request.req.req.hour   = hour;
+    request.req.req.day    = dydw;
+
+    for (uint8_t i=0; i<request.size; i++) {
+        image->buf[i] = request.buf[i];
+    }
+}
 
-    return writeControlReg(control);
+template <class Bus>
+bool DS3231DrvT<Bus>::writeAlarm2(const DS3231_alarm2_image_t* image)
+{
+    return writeShadowRegs(image->buf, sizeof(image->buf));
 }
+
+// Alarm registers, Control and Status are written in single burst
+template <class Bus>
+bool DS3231DrvT<Bus>::setAlarm2(const DS3231_alarm2_image_t* image, bool armed)
+{
+    beginBatch();
+    bool result = writeAlarm2(image) && armAlarm2(armed) && clearAlarm2();
+
+    return commitBatch() && result;
+}
+
+template <class Bus>
+bool DS3231DrvT<Bus>::setAlarm2(uint8_t dydw, uint8_t hour, uint8_t minute, DS3231_alarm2_t mode, bool armed)
+{
+    DS3231_alarm2_image_t image;
+    encodeAlarm2(&image, dydw, hour, minute, mode);
+    return setAlarm2(&image, armed);
+}
+
+template <class Bus>
+bool DS3231DrvT<Bus>::readOscilatorStopFlag(bool& result)
+{
+    uint8_t status;
+    if ( !readStatusReg(&status) ) return false;
+
+    result = (status & DS3231_REG_STATUS_OSF_BIT_MASK) ? true : false;
+    return true;
+}
+
+template <class Bus>
+bool DS3231DrvT<Bus>::clearOscilatorStopFlag()
+{
+    // Alarm flags are written back as read, writing 1 to them leaves them unchanged
+    return writeMaskReg(DS3231_REG_STATUS, 0, DS3231_REG_STATUS_OSF_BIT_MASK);
+}
+
+template <class Bus>
+bool DS3231DrvT<Bus>::enableOscilatorOnBattery(bool enabled) {
+    // Enabling oscillator selects also square wave output on INT/SQW pin (INTCN=0)
+    if (enabled) {
+        return writeMaskReg(DS3231_REG_CONTROL, 0, DS3231_REG_CONTROL_EOSC_BIT_MASK | DS3231_REG_CONTROL_INTCN_BIT_MASK);
+    }
+    return writeMaskReg(DS3231_REG_CONTROL, DS3231_REG_CONTROL_EOSC_BIT_MASK, DS3231_REG_CONTROL_EOSC_BIT_MASK);
+}
+
+// Buses the driver is built for
+template class DS3231DrvT<TwiAsyncBus>;
+#if defined(__linux__)
+template class DS3231DrvT<LinuxI2cBus>;
+#endif
+#if !defined(__MSP430__) || defined(MEMORY_I2C_BUS)
+template class DS3231DrvT<MemoryI2cBus>;
+#endif
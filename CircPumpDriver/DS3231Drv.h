@@ -21,6 +21,7 @@
 #define DS3231DRV_H_
 
 #include <DateTime.h>
+#include <I2cBus.h>
 
 typedef enum
 {
@@ -41,9 +42,53 @@ typedef enum
     DS3231_MATCH_DY_H_M = 0b00010000
 } DS3231_alarm2_t;
 
+// Alarm 1 request encoded in advance, so it may be sent in single I2C transaction
+typedef struct
+{
+    uint8_t buf[5]; ///< Register address followed by Alarm 1 registers
+} DS3231_alarm1_image_t;
+
+typedef struct
+{
+    uint8_t buf[4]; ///< Register address followed by Alarm 2 registers
+} DS3231_alarm2_image_t;
+
+// Decoded content of all timekeeping, alarm, control and status registers, read in single I2C transaction
+static const int16_t DS3231_NO_TEMPERATURE = -0x7FFF - 1;
+typedef struct
+{
+    dt_date_t date;
+    dt_time_t time;
+    bool      alarm1;       ///< Alarm 1 Flag (A1F)
+    bool      alarm2;       ///< Alarm 2 Flag (A2F)
+    bool      armed1;       ///< Alarm 1 Interrupt Enable (A1IE)
+    bool      armed2;       ///< Alarm 2 Interrupt Enable (A2IE)
+    bool      osc_stopped;  ///< Oscillator Stop Flag (OSF)
+    int16_t   temperature;  ///< In 1/4 of Celsius degree or DS3231_NO_TEMPERATURE
+} DS3231_snapshot_t;
+
+struct ds3231_datetime_s;
+struct ds3231_shadow_s;
 
-class DS3231Drv {
+/**
+ * Driver is parameterized with bus policy, a class with static methods:
+ *       static bool begin();
+ *       static bool write(uint8_t address, uint8_t reg, const uint8_t* data, uint8_t size);
+ *       static bool read(uint8_t address, uint8_t reg, uint8_t* data, uint8_t size);
+ *       static void recover();
+ *       static void getStats(i2c_bus_stats_t* stats);
+ * See I2cBus.h. Each instantiation has its own register shadow.
+ */
+template <class Bus>
+class DS3231DrvT {
 private:
+    static ds3231_shadow_s shadow;
+
+    static bool busWrite(const uint8_t* request, uint8_t request_size);
+    static bool busRead(uint8_t reg, uint8_t* request, uint8_t request_size);
+    static bool flushShadow();
+    static bool validateShadow();
+    static bool writeShadowRegs(const uint8_t* request, uint8_t request_size);
 
     static uint8_t bcd2dec(uint8_t bcd)
     {
@@ -57,7 +102,15 @@ public:
 
 
     static bool begin();
+    // Frees the bus after failed transfer. Unwritten registers are kept, so failed operation may be simply repeated
+    static void recoverBus();
+    static void getBusStats(i2c_bus_stats_t* stats) { Bus::getStats(stats); }
+    // Register writes between beginBatch() and commitBatch() are sent in single I2C transaction
+    static void beginBatch();
+    static bool commitBatch();
     static bool enableOscilatorOnBattery(bool enabled);
+    static bool readOscilatorStopFlag(bool& result);
+    static bool clearOscilatorStopFlag();
     static bool writeRequest(const uint8_t* request, uint8_t request_size);
     static bool writeReg(uint8_t reg, uint8_t value)
     {
@@ -90,7 +143,17 @@ public:
 
 
     static bool getDateTime(dt_date_t* date, dt_time_t* time);
+    // Temperature makes the burst 19 bytes long instead of 16
+    static bool readSnapshot(DS3231_snapshot_t* snapshot, bool with_temperature = false);
+    static bool readTemperature(int16_t* out_temperature);
+    // Forces TCXO update, so new aging offset is used at once
+    static bool startTemperatureConversion();
+    static bool readAgingOffset(int8_t* out_offset);
+    static bool writeAgingOffset(int8_t offset);
+    // Aging offset trimming measured drift (in ppb, positive when RTC runs fast) for given current offset
+    static int8_t computeAgingOffset(int8_t offset, int32_t drift_ppb);
 private:
+    static bool decodeDateTime(const ds3231_datetime_s* regs, dt_date_t* date, dt_time_t* time);
     static bool setDateTime(const dt_date_t* date, const dt_time_t* time, uint32_t epoch);
     static bool readAlarm(uint8_t status_reg_bit_maks, bool& result, bool clear);
 public:
@@ -108,6 +171,22 @@ public:
     static bool armAlarm2(bool armed);
     static bool isArmed2();
     static bool setAlarm1(uint8_t dydw, uint8_t hour, uint8_t minute, uint8_t second, DS3231_alarm1_t mode, bool armed = true);
+    static bool setAlarm1(const DS3231_alarm1_image_t* image, bool armed = true);
+    static void encodeAlarm1(DS3231_alarm1_image_t* image, uint8_t dydw, uint8_t hour, uint8_t minute, uint8_t second, DS3231_alarm1_t mode);
+    static bool writeAlarm1(const DS3231_alarm1_image_t* image);
+
+    // Alarm 2 has no seconds, it fires at 00 seconds of matching minute
+    static bool setAlarm2(uint8_t dydw, uint8_t hour, uint8_t minute, DS3231_alarm2_t mode, bool armed = true);
+    static bool setAlarm2(const DS3231_alarm2_image_t* image, bool armed = true);
+    static void encodeAlarm2(DS3231_alarm2_image_t* image, uint8_t dydw, uint8_t hour, uint8_t minute, DS3231_alarm2_t mode);
+    static bool writeAlarm2(const DS3231_alarm2_image_t* image);
 };
 
+// Build for Linux gateway with -DDS3231_BUS=LinuxI2cBus
+#ifndef DS3231_BUS
+#define DS3231_BUS  TwiAsyncBus
+#endif
+
+typedef DS3231DrvT<DS3231_BUS> DS3231Drv;
+
 #endif /* DS3231DRV_H_ */
@@ -23,6 +23,7 @@
 const uint8_t  LAST_DAY_OF_MONTH[] = { 31,28,31,30,31,30,31,31,30,31,30,31 };
 const uint16_t DAYS_UP_TO_MONTH_REGULAR_YEAR[] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
 const uint16_t DAYS_UP_TO_MONTH_LEAP_YEAR[] = { 0, 31, 60, 91, 121, 152, 182, 213, 244, 274, 305, 335 };
+const uint32_t DAYS_TILL_2100_MARCH = 47541;  // 1970-01-01 to 2100-03-01
 
 
 const char* DateTime::MONTH_ABBREV[DateTime::MONTHS_COUNT] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
@@ -274,10 +275,12 @@ void DateTime::setDateTimeFromEpoch(uint32_t epoch, dt_date_t* date, dt_time_t*
     secs %= 60;
     hour = mins / 60;
     mins %= 60;
+    // Below every 4th year is leap, till 2106 only 2100 is not, so from 2100-03-01 one day is skipped over its February 29
+    if (day >= DAYS_TILL_2100_MARCH) day++;
     year = (((day * 4U) + 2) / 1461U);
     day -= ((year * 1461U) + 1) / 4;
     year += 1970U;
-    leap = isLeapYear(year) ? 1: 0;
+    leap = (year % 4) ? 0 : 1;
     day += (day > 58U + leap) ? ((leap) ? 1 : 2) : 0;
     month = ((day * 12) + 6) / 367;
     day += 1 - ((month * 367U) + 5) / 12;
@@ -24,6 +24,7 @@
 # define __STDC_LIMIT_MACROS
 #endif
 #include <stdint.h>
+#include "dbgprofile.h"
 
 extern const uint8_t LAST_DAY_OF_MONTH[];
 extern const uint16_t HOLIDAYS[];
@@ -204,6 +205,7 @@ public:
 
     static uint32_t getLocalDateTimeFromUtc(uint32_t epoch)
     {
+        PROFILE_SCOPE("DateTime::getLocalDateTimeFromUtc");
         return epoch + ONE_HOUR*(isUtcInDstTime(epoch) ? UTC_OFFSET_HOUR_DST : UTC_OFFSET_HOUR_NORM);
     }
 
@@ -0,0 +1,231 @@
+/**
+ * Dcf77.cpp - DCF77 time signal decoder
+ * This file is a part of Water Circulation Pump driver
+ *
+ * Copyright (c) 2017, Rafal Kukla. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the name of the "Rafal Kukla" nor the names of its contributors may be used to endorse or
+ *   promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ */
+
+#include <Dcf77.h>
+
+
+// Pulse starts are 1s apart, 2s around minute marker. Receivers shift edges by tens of ms.
+static const uint16_t SECOND_MIN_MS = 900;
+static const uint16_t SECOND_MAX_MS = 1100;
+static const uint16_t MINUTE_MIN_MS = 1900;
+static const uint16_t MINUTE_MAX_MS = 2100;
+// Longer pulses are 1, up to PULSE_MAX_MS
+static const uint16_t PULSE_ONE_MS = 150;
+static const uint16_t PULSE_MAX_MS = 260;
+static const uint8_t  FRAME_INVALID = 0xFF;
+
+// Bits of the frame
+static const uint8_t START_OF_MINUTE = 0;
+static const uint8_t CEST = 17;
+static const uint8_t CET = 18;
+static const uint8_t START_OF_TIME = 20;
+static const uint8_t MINUTES = 21;          // 7 bits and parity
+static const uint8_t HOURS = 29;            // 6 bits and parity
+static const uint8_t DAY = 36;              // Date fields and one parity
+static const uint8_t WEEK_DAY = 42;
+static const uint8_t MONTH = 45;
+static const uint8_t YEAR = 50;
+static const uint8_t DATE_PARITY = 58;
+
+dcf77_stats_t     Dcf77::stats;
+volatile uint32_t Dcf77::edges[Dcf77::EDGES];
+volatile uint8_t  Dcf77::edges_head;
+volatile uint8_t  Dcf77::edges_tail;
+volatile bool     Dcf77::overflow;
+bool              Dcf77::in_pulse;
+bool              Dcf77::pulse_pending;
+uint32_t          Dcf77::pulse_start;
+uint32_t          Dcf77::pulse_end;
+uint32_t          Dcf77::second_start;
+uint64_t          Dcf77::frame;
+uint8_t           Dcf77::frame_bits;
+dcf77_minute_t    Dcf77::votes[Dcf77::VOTES - 1];
+dcf77_minute_t    Dcf77::confirmed;
+
+static inline uint8_t getBits(uint64_t frame, uint8_t first, uint8_t count)
+{
+    return static_cast<uint8_t>(frame >> first) & static_cast<uint8_t>((1 << count) - 1);
+}
+
+// BCD with 4 bits of units, 0xFF if not valid
+static uint8_t getBcd(uint64_t frame, uint8_t first, uint8_t count)
+{
+    uint8_t bcd = getBits(frame, first, count);
+    if ((bcd & 0x0F) > 9) return 0xFF;
+    return (bcd >> 4) * 10 + (bcd & 0x0F);
+}
+
+// Even parity over bits and their parity bit
+static bool isParityValid(uint64_t frame, uint8_t first, uint8_t count)
+{
+    bool parity = false;
+    for (uint8_t bit = first; bit < first + count; bit++) parity ^= (frame >> bit) & 1;
+    return !parity;
+}
+
+void Dcf77::begin()
+{
+    edges_head = edges_tail = 0;
+    overflow = false;
+    in_pulse = pulse_pending = false;
+    frame_bits = FRAME_INVALID;
+    for (uint8_t i = 0; i < VOTES - 1; i++) votes[i].time = DateTime::EPOCH_ERROR;
+    confirmed.time = DateTime::EPOCH_ERROR;
+    stats = dcf77_stats_t();
+}
+
+void Dcf77::onEdge(uint32_t ms, bool pulse)
+{
+    uint8_t head = (edges_head + 1) % EDGES;
+    if (head == edges_tail) {
+        overflow = true;
+        return;
+    }
+    edges[edges_head] = (ms & ~1UL) | (pulse ? 1 : 0);
+    edges_head = head;
+}
+
+bool Dcf77::process()
+{
+    bool result = false;
+    while (edges_tail != edges_head) {
+        uint32_t edge = edges[edges_tail];
+        edges_tail = (edges_tail + 1) % EDGES;
+        result |= onLevel(edge & ~1UL, edge & 1);
+    }
+    if (overflow) {
+        overflow = false;
+        stats.overflows++;
+        frame_bits = FRAME_INVALID;
+    }
+    return result;
+}
+
+// Pulse is taken when the next one starts, as the gap may be a glitch
+bool Dcf77::onLevel(uint32_t ms, bool pulse)
+{
+    if (pulse == in_pulse) return false;
+    in_pulse = pulse;
+
+    if (!pulse) {
+        if (ms - pulse_start < GLITCH_MS) {
+            stats.glitches++;
+            return false;
+        }
+        pulse_end = ms;
+        pulse_pending = true;
+        return false;
+    }
+
+    bool result = false;
+    if (pulse_pending) {
+        if (ms - pulse_end < GLITCH_MS) {
+            stats.glitches++;
+            pulse_pending = false;
+            return false;
+        }
+        result = endPulse();
+    }
+    pulse_start = ms;
+    pulse_pending = false;
+    return result;
+}
+
+bool Dcf77::endPulse()
+{
+    uint32_t gap = pulse_start - second_start;
+    uint32_t width = pulse_end - pulse_start;
+    bool result = false;
+    second_start = pulse_start;
+
+    if (gap >= MINUTE_MIN_MS && gap <= MINUTE_MAX_MS) {
+        result = endFrame(pulse_start);
+        frame = 0;
+        frame_bits = 0;
+    } else if (gap < SECOND_MIN_MS || gap > SECOND_MAX_MS) {
+        frame_bits = FRAME_INVALID;
+    }
+    if (frame_bits >= FRAME_BITS || width > PULSE_MAX_MS) {
+        frame_bits = FRAME_INVALID;
+        return result;
+    }
+    if (width >= PULSE_ONE_MS) frame |= static_cast<uint64_t>(1) << frame_bits;
+    frame_bits++;
+    return result;
+}
+
+bool Dcf77::endFrame(uint32_t ms)
+{
+    if (frame_bits != FRAME_BITS) {
+        stats.errors++;
+        return false;
+    }
+    stats.frames++;
+    uint32_t time = decodeFrame(frame);
+    if (time == DateTime::EPOCH_ERROR) {
+        stats.errors++;
+        return false;
+    }
+    return vote(time, ms);
+}
+
+// Earlier minutes vote for the time they would have now
+bool Dcf77::vote(uint32_t time, uint32_t ms)
+{
+    uint8_t agree = 1;
+    for (uint8_t i = 0; i < VOTES - 1; i++) {
+        if (votes[i].time == DateTime::EPOCH_ERROR) continue;
+        uint32_t elapsed = ms - votes[i].ms;
+        if (elapsed < VOTES * 60000UL && votes[i].time + (elapsed + 500) / 1000 == time) agree++;
+    }
+    for (uint8_t i = VOTES - 2; i > 0; i--) votes[i] = votes[i - 1];
+    votes[0].time = time;
+    votes[0].ms = ms;
+
+    if (2 * agree <= VOTES) return false;
+    confirmed = votes[0];
+    stats.confirmed++;
+    return true;
+}
+
+uint32_t Dcf77::decodeFrame(uint64_t bits)
+{
+    if (getBits(bits, START_OF_MINUTE, 1) || !getBits(bits, START_OF_TIME, 1)) return DateTime::EPOCH_ERROR;
+    if (getBits(bits, CEST, 1) == getBits(bits, CET, 1)) return DateTime::EPOCH_ERROR;
+    if (!isParityValid(bits, MINUTES, 8) || !isParityValid(bits, HOURS, 7) ||
+        !isParityValid(bits, DAY, DATE_PARITY - DAY + 1)) {
+        return DateTime::EPOCH_ERROR;
+    }
+
+    uint8_t minute = getBcd(bits, MINUTES, 7);
+    uint8_t hour = getBcd(bits, HOURS, 6);
+    uint8_t day = getBcd(bits, DAY, 6);
+    uint8_t week_day = getBits(bits, WEEK_DAY, 3);
+    uint8_t month = getBcd(bits, MONTH, 5);
+    uint8_t year = getBcd(bits, YEAR, 8);
+    if (minute > 59 || hour > 23 || year > 99) return DateTime::EPOCH_ERROR;
+    if (!DateTime::isDateValid(2000 + year, month, day)) return DateTime::EPOCH_ERROR;
+
+    uint32_t local = DateTime::getEpochFromDateTime(2000 + year, month, day, hour, minute, 0);
+    // Monday is 1
+    if (local == DateTime::EPOCH_ERROR || DateTime::getWeekDayFromEpoch(local) + 1 != week_day) return DateTime::EPOCH_ERROR;
+
+    uint8_t offset = getBits(bits, CEST, 1) ? DateTime::UTC_OFFSET_HOUR_DST : DateTime::UTC_OFFSET_HOUR_NORM;
+    return local - offset * DateTime::ONE_HOUR;
+}
@@ -0,0 +1,90 @@
+/**
+ * Dcf77.h - DCF77 time signal decoder
+ * This file is a part of Water Circulation Pump driver
+ *
+ * Copyright (c) 2017, Rafal Kukla. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the name of the "Rafal Kukla" nor the names of its contributors may be used to endorse or
+ *   promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ */
+
+#ifndef DCF77_H_
+#define DCF77_H_
+
+#include "DateTime.h"
+
+typedef struct dcf77_stats_s
+{
+    uint16_t frames;        ///< Minutes with all 59 pulses
+    uint16_t errors;        ///< Frames failed on pulse timing, markers, parity or range
+    uint16_t confirmed;     ///< Minutes confirmed by majority vote
+    uint16_t glitches;      ///< Pulses or gaps shorter than GLITCH_MS, dropped
+    uint16_t overflows;     ///< Edges lost, queue was full
+} dcf77_stats_t;
+
+// Decoded minute: UTC at its start and millis() of its first pulse
+typedef struct dcf77_minute_s
+{
+    uint32_t time;
+    uint32_t ms;
+} dcf77_minute_t;
+
+/**
+ * Pulse edges are time stamped by pin interrupt and queued, loop() decodes them. Second starts with carrier
+ * reduction of 100ms (0) or 200ms (1), missing pulse marks the start of minute. Frame sent during a minute gives
+ * local time of the next one, it is checked for markers, parities and ranges. Time is confirmed when the majority
+ * of the last VOTES minutes agrees on it, so a single corrupted frame that passes the parity is never used.
+ */
+class Dcf77
+{
+public:
+    static const uint8_t  FRAME_BITS = 59;
+    static const uint8_t  VOTES = 3;
+    static const uint16_t GLITCH_MS = 40;
+    static dcf77_stats_t  stats;
+
+    static void begin();
+    // Called by pin interrupt with millis() of the edge, pulse is the carrier reduction
+    static void onEdge(uint32_t ms, bool pulse);
+    // Decodes queued edges, true when a new minute has been confirmed
+    static bool process();
+    // Confirmed minute, its time is EPOCH_ERROR before the first one
+    static const dcf77_minute_t* getConfirmed() { return &confirmed; }
+
+    // UTC of the minute which follows the frame, EPOCH_ERROR if it is not valid. Bit 0 is the first one.
+    static uint32_t decodeFrame(uint64_t bits);
+
+private:
+    static const uint8_t EDGES = 4;
+
+    static volatile uint32_t edges[EDGES];      ///< millis(), lowest bit is the pulse level
+    static volatile uint8_t  edges_head;
+    static volatile uint8_t  edges_tail;
+    static volatile bool     overflow;
+
+    static bool              in_pulse;
+    static bool              pulse_pending;     ///< Ended pulse waits for the next one, short gap joins them
+    static uint32_t          pulse_start;
+    static uint32_t          pulse_end;
+    static uint32_t          second_start;      ///< Start of the last pulse taken as a second
+    static uint64_t          frame;
+    static uint8_t           frame_bits;        ///< Bits received since minute start, FRAME_INVALID if broken
+    static dcf77_minute_t    votes[VOTES - 1];  ///< The last decoded minutes
+    static dcf77_minute_t    confirmed;
+
+    static bool onLevel(uint32_t ms, bool pulse);
+    static bool endPulse();
+    static bool endFrame(uint32_t ms);
+    static bool vote(uint32_t time, uint32_t ms);
+};
+
+#endif /* DCF77_H_ */
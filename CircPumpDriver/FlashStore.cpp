@@ -0,0 +1,127 @@
+/**
+ * FlashStore.cpp - Data segments in MSP430 main flash
+ * This file is a part of Water Circulation Pump driver
+ *
+ * Copyright (c) 2017, Rafal Kukla. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the name of the "Rafal Kukla" nor the names of its contributors may be used to endorse or
+ *   promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ */
+
+#include <FlashStore.h>
+
+#if defined(__MSP430__)
+#include <msp430.h>
+
+// Programmed as zeros with the firmware, so the user sees it as not formatted
+static const uint8_t storage[FlashStore::SEGMENTS][FlashStore::SEGMENT_SIZE]
+    __attribute__((section(".text.flashstore"), aligned(FlashStore::SEGMENT_SIZE), used)) = {};
+
+const uint8_t* FlashStore::getSegment(uint8_t segment)
+{
+    const uint8_t* p = storage[segment];
+    // Content changes behind compiler's back, so it must not be folded from the initializer
+    __asm__ __volatile__("" : "+r"(p));
+    return p;
+}
+
+static void unlock(uint16_t mode)
+{
+    FCTL2 = FWKEY | FSSEL_1 | (40 - 1);     // MCLK/40, 400 kHz at 16 MHz
+    FCTL3 = FWKEY;
+    FCTL1 = FWKEY | mode;
+}
+
+static bool lock()
+{
+    FCTL1 = FWKEY;
+    bool ok = !(FCTL3 & FAIL);
+    FCTL3 = FWKEY | LOCK;
+    return ok;
+}
+
+bool FlashStore::erase(uint8_t segment)
+{
+    if (segment >= SEGMENTS) return false;
+    uint16_t sr = __get_SR_register();
+    __disable_interrupt();
+    unlock(ERASE);
+    *const_cast<volatile uint8_t*>(getSegment(segment)) = 0;
+    bool ok = lock();
+    __bis_SR_register(sr & GIE);
+    return ok;
+}
+
+bool FlashStore::write(uint8_t segment, uint16_t offset, const void* data, uint16_t size)
+{
+    if (segment >= SEGMENTS || offset + size > SEGMENT_SIZE) return false;
+    volatile uint8_t* dst = const_cast<volatile uint8_t*>(getSegment(segment)) + offset;
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    uint16_t sr = __get_SR_register();
+    __disable_interrupt();
+    unlock(WRT);
+    for (; size; size--) *dst++ = *src++;
+    bool ok = lock();
+    __bis_SR_register(sr & GIE);
+    return ok;
+}
+
+#else
+
+uint8_t  FlashStore::storage[SEGMENTS][SEGMENT_SIZE];
+unsigned FlashStore::erases;
+unsigned FlashStore::writes;
+unsigned FlashStore::overwrites;
+uint16_t FlashStore::block_writes[SEGMENTS][SEGMENT_SIZE / BLOCK_SIZE];
+uint16_t FlashStore::max_block_writes;
+
+void FlashStore::reset()
+{
+    for (auto& segment : storage) {
+        for (auto& b : segment) b = 0;
+    }
+    for (auto& segment : block_writes) {
+        for (auto& w : segment) w = 0;
+    }
+    erases = writes = overwrites = max_block_writes = 0;
+}
+
+const uint8_t* FlashStore::getSegment(uint8_t segment)
+{
+    return storage[segment];
+}
+
+bool FlashStore::erase(uint8_t segment)
+{
+    if (segment >= SEGMENTS) return false;
+    for (auto& b : storage[segment]) b = 0xFF;
+    for (auto& w : block_writes[segment]) w = 0;
+    erases++;
+    return true;
+}
+
+bool FlashStore::write(uint8_t segment, uint16_t offset, const void* data, uint16_t size)
+{
+    if (segment >= SEGMENTS || offset + size > SEGMENT_SIZE) return false;
+    uint8_t* dst = storage[segment] + offset;
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    for (; size; size--, dst++, src++, offset++) {
+        if (*src & ~*dst) overwrites++;
+        *dst &= *src;
+        uint16_t& block = block_writes[segment][offset / BLOCK_SIZE];
+        if (++block > max_block_writes) max_block_writes = block;
+    }
+    writes++;
+    return true;
+}
+
+#endif
@@ -0,0 +1,55 @@
+/**
+ * FlashStore.h - Data segments in MSP430 main flash
+ * This file is a part of Water Circulation Pump driver
+ *
+ * Copyright (c) 2017, Rafal Kukla. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the name of the "Rafal Kukla" nor the names of its contributors may be used to endorse or
+ *   promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ */
+
+#ifndef FLASHSTORE_H_
+#define FLASHSTORE_H_
+
+#include <stdint.h>
+
+/**
+ * Segments of main flash reserved for data. Erased segment reads 0xFF and writing can only clear bits,
+ * so data which only grows is written without erasing. Host build keeps segments in RAM under the same rules.
+ * Flash is programmed with MCLK/40, so it works with Energia 16 MHz clock. CPU is held during erase (~12 ms)
+ * and interrupts wait till it is done.
+ * Cumulative program time of a 64 byte block between erases is limited to 10 ms (tCPT), one byte takes ~75 us,
+ * so callers must keep below BLOCK_WRITES_MAX bytes written into any block of a segment.
+ */
+class FlashStore {
+public:
+    static const uint16_t SEGMENT_SIZE = 512;
+    static const uint8_t  SEGMENTS = 2;
+    static const uint8_t  BLOCK_SIZE = 64;
+    static const uint8_t  BLOCK_WRITES_MAX = 130;
+
+    static const uint8_t* getSegment(uint8_t segment);
+    static bool erase(uint8_t segment);
+    static bool write(uint8_t segment, uint16_t offset, const void* data, uint16_t size);
+#if !defined(__MSP430__)
+    static uint8_t  storage[SEGMENTS][SEGMENT_SIZE];
+    static unsigned erases;
+    static unsigned writes;
+    static unsigned overwrites;     ///< Writes which would need to set erased bit, flash keeps it cleared
+    static uint16_t block_writes[SEGMENTS][SEGMENT_SIZE / BLOCK_SIZE];  ///< Bytes written since erase
+    static uint16_t max_block_writes;
+    // As after programming the firmware
+    static void reset();
+#endif
+};
+
+#endif /* FLASHSTORE_H_ */
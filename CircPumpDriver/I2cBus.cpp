@@ -0,0 +1,149 @@
+/**
+ * I2cBus.cpp - I2C bus policies for compile time parameterized drivers
+ *
+ * Copyright (c) 2017, Rafal Kukla. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the name of the "Rafal Kukla" nor the names of its contributors may be used to endorse or
+ *   promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ */
+
+
+#include <I2cBus.h>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+const char* const LinuxI2cBus::DEFAULT_DEVICE = "/dev/i2c-1";
+int LinuxI2cBus::fd = -1;
+const char* LinuxI2cBus::path = NULL;
+i2c_bus_stats_t LinuxI2cBus::stats;
+
+// Adapter drivers report missing ACK as ENXIO or EREMOTEIO, lost arbitration and stuck bus mostly as ETIMEDOUT
+bool LinuxI2cBus::count(bool ok)
+{
+    if (ok) return true;
+    if (errno == ETIMEDOUT) stats.timeouts++;
+    else                    stats.nacks++;
+    return false;
+}
+
+bool LinuxI2cBus::open(const char* device)
+{
+    close();
+    path = device;
+    fd = ::open(device, O_RDWR);
+    return fd >= 0;
+}
+
+void LinuxI2cBus::close()
+{
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+}
+
+bool LinuxI2cBus::begin()
+{
+    return (fd >= 0) ? true : open(DEFAULT_DEVICE);
+}
+
+void LinuxI2cBus::recover()
+{
+    stats.recoveries++;
+    if (path) open(path);
+}
+
+bool LinuxI2cBus::write(uint8_t address, uint8_t reg, const uint8_t* data, uint8_t size)
+{
+    uint8_t buf[1 + 255];
+    buf[0] = reg;
+    memcpy(buf + 1, data, size);
+
+    struct i2c_msg msg;
+    msg.addr  = address;
+    msg.flags = 0;
+    msg.len   = static_cast<uint16_t>(size + 1);
+    msg.buf   = buf;
+
+    struct i2c_rdwr_ioctl_data xfer = { &msg, 1 };
+    return count(ioctl(fd, I2C_RDWR, &xfer) == 1);
+}
+
+bool LinuxI2cBus::read(uint8_t address, uint8_t reg, uint8_t* data, uint8_t size)
+{
+    struct i2c_msg msgs[2];
+    msgs[0].addr  = address;
+    msgs[0].flags = 0;
+    msgs[0].len   = 1;
+    msgs[0].buf   = &reg;
+    msgs[1].addr  = address;
+    msgs[1].flags = I2C_M_RD;
+    msgs[1].len   = size;
+    msgs[1].buf   = data;
+
+    // Both messages in one ioctl are joined with repeated START
+    struct i2c_rdwr_ioctl_data xfer = { msgs, 2 };
+    return count(ioctl(fd, I2C_RDWR, &xfer) == 2);
+}
+#endif
+
+#if !defined(__MSP430__) || defined(MEMORY_I2C_BUS)
+uint8_t  MemoryI2cBus::regs[MEMORY_I2C_BUS_SIZE];
+uint8_t  MemoryI2cBus::address;
+unsigned MemoryI2cBus::writes;
+unsigned MemoryI2cBus::reads;
+unsigned MemoryI2cBus::fail_countdown;
+unsigned MemoryI2cBus::nacks;
+unsigned MemoryI2cBus::recoveries;
+uint8_t  MemoryI2cBus::flags_reg;
+uint8_t  MemoryI2cBus::flags_mask;
+
+void MemoryI2cBus::reset(uint8_t slave_address)
+{
+    for (auto& r : regs) r = 0;
+    address = slave_address;
+    writes = reads = fail_countdown = nacks = recoveries = 0;
+    flags_reg = flags_mask = 0;
+}
+
+bool MemoryI2cBus::accept(uint8_t slave_address)
+{
+    if (slave_address == address && !(fail_countdown && !--fail_countdown)) return true;
+    nacks++;
+    return false;
+}
+
+bool MemoryI2cBus::write(uint8_t slave_address, uint8_t reg, const uint8_t* data, uint8_t size)
+{
+    if (!accept(slave_address)) return false;
+    for (; size; size--, reg++) {
+        uint8_t& r = regs[reg & (MEMORY_I2C_BUS_SIZE - 1)];
+        uint8_t value = *data++;
+        r = (reg == flags_reg) ? (value & ~flags_mask) | (value & r & flags_mask) : value;
+    }
+    writes++;
+    return true;
+}
+
+bool MemoryI2cBus::read(uint8_t slave_address, uint8_t reg, uint8_t* data, uint8_t size)
+{
+    if (!accept(slave_address)) return false;
+    for (; size; size--) *data++ = regs[reg++ & (MEMORY_I2C_BUS_SIZE - 1)];
+    reads++;
+    return true;
+}
+#endif
@@ -0,0 +1,118 @@
+/**
+ * I2cBus.h - I2C bus policies for compile time parameterized drivers
+ *
+ * Copyright (c) 2017, Rafal Kukla. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the name of the "Rafal Kukla" nor the names of its contributors may be used to endorse or
+ *   promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ */
+
+
+#ifndef I2CBUS_H_
+#define I2CBUS_H_
+
+#include <stdint.h>
+#include <TwiAsync.h>
+
+/**
+ * Every policy transfers blocks of registers starting at register address "reg":
+ *       write: START addr+W reg data[0] .. data[size-1] STOP
+ *       read:  START addr+W reg RESTART addr+R data[0] .. data[size-1] STOP
+ * recover() brings bus back after failed transfer, caller decides whether to retry.
+ * getStats() reports error counters, those the policy cannot tell stay 0.
+ * All methods are static, so drivers using them have no virtual call overhead.
+ */
+typedef twi_async_stats_t i2c_bus_stats_t;
+
+// MSP430 USCI_B0 (host: TwiFake) through TwiAsync queue, blocking until transfer is done
+class TwiAsyncBus {
+public:
+    static bool begin()
+    {
+        TwiAsync::begin();
+        return true;
+    }
+    static bool write(uint8_t address, uint8_t reg, const uint8_t* data, uint8_t size)
+    {
+        twi_async_req_t req;
+        TwiAsync::setupWrite(&req, address, reg, data, size);
+        return TwiAsync::transfer(&req);
+    }
+    static bool read(uint8_t address, uint8_t reg, uint8_t* data, uint8_t size)
+    {
+        twi_async_req_t req;
+        TwiAsync::setupRead(&req, address, reg, data, size);
+        return TwiAsync::transfer(&req);
+    }
+    static void recover() { TwiAsync::recover(); }
+    static void getStats(i2c_bus_stats_t* stats) { *stats = TwiAsync::stats; }
+};
+
+#if defined(__linux__)
+// Linux /dev/i2c-N adapter, every transfer is single ioctl(I2C_RDWR)
+class LinuxI2cBus {
+public:
+    static const char* const DEFAULT_DEVICE;    ///< "/dev/i2c-1", as on Raspberry Pi
+
+    static bool open(const char* device);
+    static void close();
+    // Opens DEFAULT_DEVICE unless other adapter has been opened already
+    static bool begin();
+    static bool write(uint8_t address, uint8_t reg, const uint8_t* data, uint8_t size);
+    static bool read(uint8_t address, uint8_t reg, uint8_t* data, uint8_t size);
+    // Adapter driver does the bus recovery itself, device is only reopened
+    static void recover();
+    static void getStats(i2c_bus_stats_t* out_stats) { *out_stats = stats; }
+private:
+    static int             fd;
+    static const char*     path;
+    static i2c_bus_stats_t stats;
+    static bool count(bool ok);
+};
+#endif
+
+#if !defined(__MSP430__) || defined(MEMORY_I2C_BUS)
+// Register file size, power of 2. On-target benchmarks (-DMEMORY_I2C_BUS) use smaller one, as RAM is 512 bytes
+#ifndef MEMORY_I2C_BUS_SIZE
+#define MEMORY_I2C_BUS_SIZE 256
+#endif
+
+// In-memory register file of single slave, for tests and benchmarks
+class MemoryI2cBus {
+public:
+    static uint8_t  regs[MEMORY_I2C_BUS_SIZE];
+    static uint8_t  address;        ///< Only this slave acknowledges
+    static unsigned writes;         ///< Successful write transactions
+    static unsigned reads;          ///< Successful read transactions
+    static unsigned fail_countdown; ///< Transaction which fails, counted from 1, 0 - none
+    static unsigned nacks;
+    static unsigned recoveries;
+    static uint8_t  flags_reg;      ///< Register with flags set by device
+    static uint8_t  flags_mask;     ///< Flags of flags_reg which are only cleared by writing 0, 0 - none
+
+    static void reset(uint8_t slave_address);
+    static bool begin() { return true; }
+    static bool write(uint8_t address, uint8_t reg, const uint8_t* data, uint8_t size);
+    static bool read(uint8_t address, uint8_t reg, uint8_t* data, uint8_t size);
+    static void recover() { recoveries++; }
+    static void getStats(i2c_bus_stats_t* stats)
+    {
+        stats->nacks = static_cast<uint16_t>(nacks);
+        stats->timeouts = 0;
+        stats->recoveries = static_cast<uint16_t>(recoveries);
+    }
+private:
+    static bool accept(uint8_t address);
+};
+#endif
+
+#endif /* I2CBUS_H_ */
@@ -0,0 +1,331 @@
+/**
+ * TwiAsync.cpp - Non-blocking I2C master with request queue
+ *
+ * Copyright (c) 2017, Rafal Kukla. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the name of the "Rafal Kukla" nor the names of its contributors may be used to endorse or
+ *   promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ */
+
+#include <TwiAsync.h>
+
+#if defined(__MSP430__)
+#include <msp430.h>
+extern "C" {
+#include <twi.h>
+}
+
+#define TWI_ASYNC_CRITICAL_BEGIN()  uint16_t _twi_sr_ = __get_SR_register(); __disable_interrupt()
+#define TWI_ASYNC_CRITICAL_END()    __bis_SR_register(_twi_sr_ & GIE)
+
+// ========================================================================================================= USCI_B0 backend
+/**
+ * NOTE: Energia core owns USCIAB0TX/USCIAB0RX vectors (shared with UART), so USCI_B0 interrupts stay disabled here
+ *       and TwiAsync::service() must be called from the core handler, a timer ISR or the main loop.
+ *       Every step only checks flags, it never waits for the bus.
+ */
+void twi_port_init()
+{
+    twi_init();                         // Pins, master mode, clock - as configured by Energia
+    UC0IE &= ~(UCB0TXIE | UCB0RXIE);
+    UCB0I2CIE = 0;
+}
+
+void twi_port_start(uint8_t address, bool read, bool stop_after_first)
+{
+    UCB0I2CSA = address;
+    if (read) UCB0CTL1 &= ~UCTR;
+    else      UCB0CTL1 |= UCTR;
+    UCB0CTL1 |= UCTXSTT;
+
+    if (stop_after_first) {
+        // STOP has to be requested while address is being sent, it is the only (short) wait in this driver
+        while ( (UCB0CTL1 & UCTXSTT) && !(UCB0STAT & UCNACKIFG) );
+        UCB0CTL1 |= UCTXSTP;
+    }
+}
+
+twi_port_event_t twi_port_poll()
+{
+    if (UCB0STAT & UCNACKIFG) return TWI_PORT_NACK;
+    if (IFG2 & UCB0RXIFG)     return TWI_PORT_RX;
+    if (IFG2 & UCB0TXIFG)     return TWI_PORT_TX;
+    return TWI_PORT_NONE;
+}
+
+void twi_port_tx(uint8_t value) { UCB0TXBUF = value; }
+
+uint8_t twi_port_rx(bool stop_next)
+{
+    if (stop_next) UCB0CTL1 |= UCTXSTP;
+    return UCB0RXBUF;
+}
+
+void twi_port_stop()
+{
+    UCB0CTL1 |= UCTXSTP;
+    UCB0STAT &= ~UCNACKIFG;
+    IFG2 &= ~UCB0TXIFG;
+}
+
+bool twi_port_busy() { return (UCB0CTL1 & UCTXSTP) ? true : false; }
+
+// USCI_B0 pins: P1.6 SCL, P1.7 SDA. Lines are driven as open drain: low by output, high by releasing to pull-up
+#define TWI_SCL                     BIT6
+#define TWI_SDA                     BIT7
+#define TWI_HALF_BIT_CYCLES         (F_CPU / 200000)    // 100kHz
+
+void twi_port_recover()
+{
+    UCB0CTL1 |= UCSWRST;
+    P1SEL  &= ~(TWI_SCL | TWI_SDA);
+    P1SEL2 &= ~(TWI_SCL | TWI_SDA);
+    P1OUT  &= ~(TWI_SCL | TWI_SDA);
+    P1DIR  &= ~(TWI_SCL | TWI_SDA);
+
+    // Slave in the middle of read releases SDA at most after 9 clocks
+    for (uint8_t i = 0; i < 9 && !(P1IN & TWI_SDA); i++) {
+        P1DIR |= TWI_SCL;
+        __delay_cycles(TWI_HALF_BIT_CYCLES);
+        P1DIR &= ~TWI_SCL;
+        __delay_cycles(TWI_HALF_BIT_CYCLES);
+    }
+    // STOP: SDA rising while SCL is high
+    P1DIR |= TWI_SDA;
+    __delay_cycles(TWI_HALF_BIT_CYCLES);
+    P1DIR &= ~TWI_SDA;
+    __delay_cycles(TWI_HALF_BIT_CYCLES);
+
+    twi_port_init();
+}
+
+#else
+
+#define TWI_ASYNC_CRITICAL_BEGIN()  do {} while(0)
+#define TWI_ASYNC_CRITICAL_END()    do {} while(0)
+
+#endif
+
+// ========================================================================================================= Request queue
+
+typedef enum
+{
+    TWI_STATE_IDLE = 0,
+    TWI_STATE_ADDRESS,      ///< START and address sent, waiting for place for register pointer
+    TWI_STATE_REGISTER,     ///< Register pointer sent, waiting to RESTART for read
+    TWI_STATE_DATA_TX,
+    TWI_STATE_DATA_RX,
+    TWI_STATE_STOP,         ///< Waiting for STOP condition
+} twi_async_state_t;
+
+static struct twi_async_bus_s {
+    twi_async_req_t*    head;
+    twi_async_req_t*    tail;
+    uint8_t             state;      ///< twi_async_state_t
+    uint8_t             index;      ///< Data byte being transferred
+    uint8_t             result;     ///< twi_async_status_t of current request
+    volatile bool       in_service;
+} bus;
+
+twi_async_stats_t TwiAsync::stats;
+
+static inline void countError(uint16_t& counter)
+{
+    if (counter != 0xFFFF) counter++;
+}
+
+static void startRequest()
+{
+    twi_async_req_t* req = bus.head;
+    req->status = TWI_ASYNC_BUSY;
+    bus.index = 0;
+    bus.state = TWI_STATE_ADDRESS;
+    twi_port_start(req->address, false, false);
+}
+
+static void completeRequest()
+{
+    twi_async_req_t* req;
+
+    TWI_ASYNC_CRITICAL_BEGIN();
+    req = bus.head;
+    bus.head = req->next;
+    if (!bus.head) bus.tail = NULL;
+    TWI_ASYNC_CRITICAL_END();
+
+    req->next = NULL;
+    bus.state = TWI_STATE_IDLE;
+    req->status = bus.result;
+    if (req->done) req->done(req);
+}
+
+// Returns false if event does not move current request forward
+static bool handleEvent(twi_port_event_t event)
+{
+    twi_async_req_t* req = bus.head;
+
+    if (event == TWI_PORT_NACK) {
+        countError(TwiAsync::stats.nacks);
+        twi_port_stop();
+        bus.result = TWI_ASYNC_NACK;
+        bus.state = TWI_STATE_STOP;
+        return true;
+    }
+
+    switch (bus.state) {
+    case TWI_STATE_ADDRESS:
+        if (event != TWI_PORT_TX) return false;
+        twi_port_tx(req->reg);
+        bus.state = req->read ? TWI_STATE_REGISTER : TWI_STATE_DATA_TX;
+        return true;
+
+    case TWI_STATE_REGISTER:
+        if (event != TWI_PORT_TX) return false;
+        twi_port_start(req->address, true, req->size == 1);
+        bus.state = TWI_STATE_DATA_RX;
+        return true;
+
+    case TWI_STATE_DATA_TX:
+        if (event != TWI_PORT_TX) return false;
+        if (bus.index < req->size) {
+            twi_port_tx(req->data[bus.index++]);
+        } else {
+            twi_port_stop();
+            bus.result = TWI_ASYNC_DONE;
+            bus.state = TWI_STATE_STOP;
+        }
+        return true;
+
+    case TWI_STATE_DATA_RX:
+        if (event != TWI_PORT_RX) return false;
+        // STOP for the last byte has to be requested while the previous one is read
+        req->data[bus.index] = twi_port_rx( (bus.index + 2) == req->size );
+        if (++bus.index == req->size) {
+            bus.result = TWI_ASYNC_DONE;
+            bus.state = TWI_STATE_STOP;
+        }
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+void TwiAsync::begin()
+{
+    bus.head = bus.tail = NULL;
+    bus.state = TWI_STATE_IDLE;
+    bus.in_service = false;
+    twi_port_init();
+}
+
+void TwiAsync::setupWrite(twi_async_req_t* req, uint8_t address, uint8_t reg, const uint8_t* data, uint8_t size,
+                          twi_async_cb_t done, void* user)
+{
+    req->next = NULL;
+    req->data = const_cast<uint8_t*>(data);
+    req->size = size;
+    req->address = address;
+    req->reg = reg;
+    req->read = false;
+    req->status = TWI_ASYNC_IDLE;
+    req->done = done;
+    req->user = user;
+}
+
+void TwiAsync::setupRead(twi_async_req_t* req, uint8_t address, uint8_t reg, uint8_t* data, uint8_t size,
+                         twi_async_cb_t done, void* user)
+{
+    setupWrite(req, address, reg, data, size, done, user);
+    req->read = true;
+}
+
+bool TwiAsync::submit(twi_async_req_t* req)
+{
+    if ( isPending(req) ) return false;
+    if ( req->read && !req->size ) return false;
+
+    req->next = NULL;
+    req->status = TWI_ASYNC_QUEUED;
+
+    TWI_ASYNC_CRITICAL_BEGIN();
+    if (bus.tail) bus.tail->next = req;
+    else          bus.head = req;
+    bus.tail = req;
+    TWI_ASYNC_CRITICAL_END();
+
+    service();
+    return true;
+}
+
+void TwiAsync::service()
+{
+    TWI_ASYNC_CRITICAL_BEGIN();
+    bool reentered = bus.in_service;
+    bus.in_service = true;
+    TWI_ASYNC_CRITICAL_END();
+    if (reentered) return;
+
+    for (;;) {
+        if (bus.state == TWI_STATE_IDLE) {
+            if (!bus.head) break;
+            startRequest();
+        } else if (bus.state == TWI_STATE_STOP) {
+            if ( twi_port_busy() ) break;
+            completeRequest();
+        } else {
+            twi_port_event_t event = twi_port_poll();
+            if ( event == TWI_PORT_NONE || !handleEvent(event) ) break;
+        }
+    }
+
+    bus.in_service = false;
+}
+
+bool TwiAsync::isIdle()
+{
+    return bus.head == NULL;
+}
+
+void TwiAsync::recover()
+{
+    twi_async_req_t* req;
+
+    TWI_ASYNC_CRITICAL_BEGIN();
+    req = bus.head;
+    bus.head = bus.tail = NULL;
+    bus.state = TWI_STATE_IDLE;
+    TWI_ASYNC_CRITICAL_END();
+
+    countError(stats.recoveries);
+    twi_port_recover();
+
+    while (req) {
+        twi_async_req_t* next = req->next;
+        req->next = NULL;
+        req->status = TWI_ASYNC_ERROR;
+        if (req->done) req->done(req);
+        req = next;
+    }
+}
+
+bool TwiAsync::wait(twi_async_req_t* req)
+{
+    for (uint16_t polls = WAIT_POLLS; isPending(req); ) {
+        service();
+        if (!--polls && isPending(req)) {
+            countError(stats.timeouts);
+            recover();
+        }
+    }
+    return req->status == TWI_ASYNC_DONE;
+}
@@ -0,0 +1,130 @@
+/**
+ * TwiAsync.h - Non-blocking I2C master with request queue
+ *
+ * Copyright (c) 2017, Rafal Kukla. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the name of the "Rafal Kukla" nor the names of its contributors may be used to endorse or
+ *   promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ */
+
+#ifndef TWIASYNC_H_
+#define TWIASYNC_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Usage:
+ *       static uint8_t buf[7];
+ *       static twi_async_req_t req;
+ *       TwiAsync::setupRead(&req, 0x68, 0x00, buf, sizeof(buf), on_time_read);
+ *       TwiAsync::submit(&req);
+ *       ...
+ *       TwiAsync::service();   // from USCI interrupt or main loop, until request completes
+ *
+ * Every request is "register pointer" transfer:
+ *       write: START addr+W reg data[0] .. data[size-1] STOP
+ *       read:  START addr+W reg RESTART addr+R data[0] .. data[size-1] STOP
+ *
+ * Requests are queued in submit() order and completed in the same order.
+ * Request and its data must stay valid until completion callback is called.
+ */
+
+typedef enum
+{
+    TWI_ASYNC_IDLE = 0,     ///< Never submitted or already completed and reused
+    TWI_ASYNC_QUEUED,       ///< Waiting in queue
+    TWI_ASYNC_BUSY,         ///< Transfer in progress
+    TWI_ASYNC_DONE,         ///< Completed successfully
+    TWI_ASYNC_NACK,         ///< Address or data byte not acknowledged
+    TWI_ASYNC_ERROR,        ///< Aborted by bus recovery (e.g. after timeout)
+} twi_async_status_t;
+
+typedef struct
+{
+    uint16_t nacks;
+    uint16_t timeouts;      ///< wait() gave up on stuck bus
+    uint16_t recoveries;
+} twi_async_stats_t;
+
+struct twi_async_req_s;
+typedef void (*twi_async_cb_t)(struct twi_async_req_s* req);
+
+typedef struct twi_async_req_s
+{
+    struct twi_async_req_s*     next;
+    uint8_t*                    data;
+    uint8_t                     size;
+    uint8_t                     address;
+    uint8_t                     reg;
+    bool                        read;
+    volatile uint8_t            status;     ///< twi_async_status_t
+    twi_async_cb_t              done;       ///< Called from service() context, may be NULL
+    void*                       user;
+} twi_async_req_t;
+
+class TwiAsync {
+public:
+    static void begin();
+
+    static void setupWrite(twi_async_req_t* req, uint8_t address, uint8_t reg, const uint8_t* data, uint8_t size,
+                           twi_async_cb_t done = NULL, void* user = NULL);
+    static void setupRead(twi_async_req_t* req, uint8_t address, uint8_t reg, uint8_t* data, uint8_t size,
+                          twi_async_cb_t done = NULL, void* user = NULL);
+
+    // Returns false if request is still queued or busy
+    static bool submit(twi_async_req_t* req);
+    // Advances state machine as far as bus allows without waiting
+    static void service();
+    static bool isIdle();
+    static bool isPending(const twi_async_req_t* req) {
+        return req->status == TWI_ASYNC_QUEUED || req->status == TWI_ASYNC_BUSY;
+    }
+
+    // Aborts all requests with TWI_ASYNC_ERROR, frees the bus from a slave holding SDA low and re-initializes USCI
+    static void recover();
+
+    // Blocking helpers used by synchronous drivers, stuck bus is recovered after WAIT_POLLS service() calls
+    static const uint16_t WAIT_POLLS = 20000;   // ~60ms on MSP430 @ 16MHz
+    static bool wait(twi_async_req_t* req);
+    static bool transfer(twi_async_req_t* req) { return submit(req) && wait(req); }
+
+    static twi_async_stats_t stats;
+};
+
+/**
+ * Bus backend driven by TwiAsync state machine.
+ * MSP430 - USCI_B0 in TwiAsync.cpp
+ * Host   - provided by the application (see CircPumpDriverApp/TwiFake.cpp)
+ */
+typedef enum
+{
+    TWI_PORT_NONE = 0,      ///< Nothing happened yet
+    TWI_PORT_TX,            ///< Transmit buffer empty, next byte can be written
+    TWI_PORT_RX,            ///< Byte received
+    TWI_PORT_NACK,          ///< Slave did not acknowledge
+} twi_port_event_t;
+
+void             twi_port_init();
+// Generates START (or repeated START) with slave address, stop_after_first is used for single byte reads
+void             twi_port_start(uint8_t address, bool read, bool stop_after_first);
+twi_port_event_t twi_port_poll();
+void             twi_port_tx(uint8_t value);
+// stop_next requests STOP after the byte being currently received
+uint8_t          twi_port_rx(bool stop_next);
+void             twi_port_stop();
+// True until STOP condition is generated
+bool             twi_port_busy();
+// Up to 9 SCL pulses until slave releases SDA, STOP condition and twi_port_init()
+void             twi_port_recover();
+
+#endif /* TWIASYNC_H_ */
@@ -0,0 +1,127 @@
+/*
+ * dbgprofile.h
+ *
+ *  Scoped timers for measuring hot paths. Everything compiles out unless PROFILE is defined.
+ */
+
+#ifndef _DBG_PROFILE_H_
+#define _DBG_PROFILE_H_
+
+/**
+ * Usage:
+ *       void hot_function() {
+ *           PROFILE_SCOPE("hot_function");
+ *           ...
+ *       }
+ *
+ *       PROFILE_INIT();  // once, from setup()
+ *       PROFILE_DUMP();  // prints count/min/max/mean of every site hit so far
+ *
+ * NOTE: PROFILE must be defined project-wide (-DPROFILE), as sites live also in DateTime, CircShedule and DS3231Drv.
+ *       PROFILE_DUMP() requires the same PRINT/PRINTLN macros as dbgprint.h
+ *
+ * Units:  MSP430 - CPU cycles, measured with Timer1_A running from SMCLK/8,
+ *                  so resolution is 8 cycles and a single scope must not exceed 65535*8 cycles (~32ms @ 16MHz)
+ *         Host   - nanoseconds from std::chrono::steady_clock
+ */
+
+#ifdef PROFILE
+
+#include <stdint.h>
+
+#if defined(__MSP430__)
+#include <msp430.h>
+
+typedef uint16_t profile_ticks_t;
+typedef uint32_t profile_sum_t;
+#define PROFILE_UNIT "cycles"
+
+static inline void profile_timer_init()
+{
+    TA1CTL = TASSEL_2 | ID_3 | MC_2 | TACLR; // SMCLK/8, continuous mode
+}
+static inline profile_ticks_t profile_timer_now() { return TA1R; }
+static inline uint32_t profile_ticks_to_units(uint32_t ticks) { return ticks << 3; }
+
+#else
+#include <chrono>
+
+typedef uint32_t profile_ticks_t;
+typedef uint64_t profile_sum_t;
+#define PROFILE_UNIT "ns"
+
+static inline void profile_timer_init() {}
+static inline profile_ticks_t profile_timer_now()
+{
+    return static_cast<profile_ticks_t>( std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count() );
+}
+static inline uint32_t profile_ticks_to_units(uint32_t ticks) { return ticks; }
+#endif
+
+
+struct ProfileSite
+{
+    const char*     name;
+    ProfileSite*    next;
+    uint16_t        count;
+    profile_ticks_t min;
+    profile_ticks_t max;
+    profile_sum_t   sum;
+
+    explicit ProfileSite(const char* site_name) : name(site_name), next(first()), count(0), min(0), max(0), sum(0)
+    {
+        first() = this;
+    }
+
+    void add(profile_ticks_t ticks)
+    {
+        if (!count || ticks < min) min = ticks;
+        if (ticks > max) max = ticks;
+        sum += ticks;
+        // Fold the sum before the counter wraps, so mean stays meaningful in long runs
+        if (++count == 0xFFFF) { sum = sum / count; count = 1; }
+    }
+
+    uint32_t mean() const { return count ? static_cast<uint32_t>(sum / count) : 0; }
+
+    static ProfileSite*& first()
+    {
+        static ProfileSite* head = nullptr;
+        return head;
+    }
+};
+
+class ProfileScope
+{
+    ProfileSite&    site;
+    profile_ticks_t start;
+public:
+    explicit ProfileScope(ProfileSite& s) : site(s), start(profile_timer_now()) {}
+    ~ProfileScope() { site.add( static_cast<profile_ticks_t>(profile_timer_now() - start) ); }
+};
+
+#define PROFILE_CONCAT_(_a_,_b_)      _a_##_b_
+#define PROFILE_CONCAT(_a_,_b_)       PROFILE_CONCAT_(_a_,_b_)
+
+#define PROFILE_INIT()                profile_timer_init()
+#define PROFILE_SCOPE(_name_)         static ProfileSite PROFILE_CONCAT(_profile_site_,__LINE__)(_name_); \
+                                      ProfileScope PROFILE_CONCAT(_profile_scope_,__LINE__)(PROFILE_CONCAT(_profile_site_,__LINE__))
+#define PROFILE_DUMP()                do { \
+    PRINTLN("Profile [" PROFILE_UNIT "]: site: count / min / max / mean"); \
+    for (const ProfileSite* _s_ = ProfileSite::first(); _s_; _s_ = _s_->next) { \
+        PRINT4("  ", _s_->name, ": ", _s_->count); \
+        PRINT2(" / ", profile_ticks_to_units(_s_->min)); \
+        PRINT2(" / ", profile_ticks_to_units(_s_->max)); \
+        PRINTLN2(" / ", profile_ticks_to_units(_s_->mean())); \
+    } } while(0)
+
+#else
+
+#define PROFILE_INIT()                do {} while(0)
+#define PROFILE_SCOPE(_name_)
+#define PROFILE_DUMP()                do {} while(0)
+
+#endif /* PROFILE */
+
+#endif /* _DBG_PROFILE_H_ */
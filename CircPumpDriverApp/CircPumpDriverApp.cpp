@@ -4,8 +4,14 @@
 #include <iostream>
 #include "DateTime.h"
 #include "CircShedule.h"
+#include "RtcCalibration.h"
+#include "Sweep.h"
+#include "Fleet.h"
+#include "Trace.h"
+#include "Verify.h"
 #include <time.h>
 #include <iomanip>
+#include <string.h>
 
 using namespace std;
 
@@ -20,71 +26,6 @@ void checkHoliday(uint16_t year, uint8_t  month, uint8_t  day)
 }
 
 
-// Returns number of days since civil 1970-01-01.  Negative values indicate
-//    days prior to 1970-01-01.
-// Preconditions:  y-m-d represents a date in the civil (Gregorian) calendar
-//                 m is in [1, 12]
-//                 d is in [1, last_day_of_month(y, m)]
-//                 y is "approximately" in
-//                   [numeric_limits<Int>::min()/366, numeric_limits<Int>::max()/366]
-//                 Exact range of validity is:
-//                 [civil_from_days(numeric_limits<Int>::min()),
-//                  civil_from_days(numeric_limits<Int>::max()-719468)]
-template <class Int>
-constexpr
-Int
-days_from_civil(Int y, unsigned m, unsigned d) noexcept
-{
-    static_assert(std::numeric_limits<unsigned>::digits >= 18,
-        "This algorithm has not been ported to a 16 bit unsigned integer");
-    static_assert(std::numeric_limits<Int>::digits >= 20,
-        "This algorithm has not been ported to a 16 bit signed integer");
-    y -= m <= 2;
-    const Int era = (y >= 0 ? y : y - 399) / 400;
-    const unsigned yoe = static_cast<unsigned>(y - era * 400);      // [0, 399]
-    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;  // [0, 365]
-    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;         // [0, 146096]
-    return era * 146097 + static_cast<Int>(doe) - 719468;
-}
-
-// Returns year/month/day triple in civil calendar
-// Preconditions:  z is number of days since 1970-01-01 and is in the range:
-//                   [numeric_limits<Int>::min(), numeric_limits<Int>::max()-719468].
-template <class Int>
-constexpr
-std::tuple<Int, unsigned, unsigned>
-civil_from_days(Int z) noexcept
-{
-    static_assert(std::numeric_limits<unsigned>::digits >= 18,
-        "This algorithm has not been ported to a 16 bit unsigned integer");
-    static_assert(std::numeric_limits<Int>::digits >= 20,
-        "This algorithm has not been ported to a 16 bit signed integer");
-    z += 719468;
-    const Int era = (z >= 0 ? z : z - 146096) / 146097;
-    const unsigned doe = static_cast<unsigned>(z - era * 146097);          // [0, 146096]
-    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;  // [0, 399]
-    const Int y = static_cast<Int>(yoe) + era * 400;
-    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);                // [0, 365]
-    const unsigned mp = (5 * doy + 2) / 153;                                   // [0, 11]
-    const unsigned d = doy - (153 * mp + 2) / 5 + 1;                             // [1, 31]
-    const unsigned m = mp + (mp < 10 ? 3 : -9);                            // [1, 12]
-    return std::tuple<Int, unsigned, unsigned>(y + (m <= 2), m, d);
-}
-
-// Returns day of week in civil calendar [0, 6] -> [Sun, Sat]
-// Preconditions:  z is number of days since 1970-01-01 and is in the range:
-//                   [numeric_limits<Int>::min(), numeric_limits<Int>::max()-4].
-
-constexpr
-uint8_t
-weekday_from_days(uint32_t timestamp) noexcept
-{
-    return static_cast<uint8_t>((timestamp + 3) % 7);
-}
-
-
-
-
 /* Set the tm_t fields for the local time. */
 
 void checkHolidays()
@@ -177,10 +118,35 @@ void DisplayNextCircOnTime(uint16_t year, uint8_t month, uint8_t day, uint8_t ho
 }
 
 extern void start_simulation();
-int main()
+extern int run_simulation(int argc, char* argv[]);
+extern int run_replay(int argc, char* argv[]);
+
+// Command name is followed by its options, without a command the simulation runs forever in real tick steps
+static const struct {
+    const char* name;
+    int (*run)(int argc, char* argv[]);
+} commands[] = {
+    { "simulate",  run_simulation },
+    { "calibrate", run_calibration },
+    { "sweep",     run_sweep },
+    { "fleet",     run_fleet },
+    { "trace",     run_trace },
+    { "replay",    run_replay },
+    { "verify",    run_verify },
+};
+
+int main(int argc, char* argv[])
 {
     //checkHolidays();
 
+    if (argc > 1) {
+        for (const auto& command : commands) {
+            if (!strcmp(argv[1], command.name)) return command.run(argc - 2, argv + 2);
+        }
+        printf("Unknown command: %s\n", argv[1]);
+        return 2;
+    }
+
     start_simulation();
 
     dt_date_t date;
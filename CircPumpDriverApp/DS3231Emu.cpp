@@ -0,0 +1,366 @@
+#include "DS3231Emu.h"
+#include "DateTime.h"
+
+#include <string.h>
+
+enum
+{
+    REG_SECONDS = 0x00,
+    REG_MINUTES,
+    REG_HOURS,
+    REG_DAY,
+    REG_DATE,
+    REG_MONTH,
+    REG_YEAR,
+    REG_ALARM1_SECONDS,
+    REG_ALARM1_MINUTES,
+    REG_ALARM1_HOURS,
+    REG_ALARM1_DAY,
+    REG_ALARM2_MINUTES,
+    REG_ALARM2_HOURS,
+    REG_ALARM2_DAY,
+    REG_CONTROL,
+    REG_STATUS,
+    REG_AGING,
+    REG_TEMP_MSB,
+    REG_TEMP_LSB,
+};
+
+static const uint8_t HOURS_12H      = 0x40;
+static const uint8_t HOURS_PM       = 0x20;
+static const uint8_t MONTH_CENTURY  = 0x80;
+static const uint8_t ALARM_MASK     = 0x80;
+static const uint8_t ALARM_DY       = 0x40;
+
+static const uint8_t CONTROL_CONV   = 0x20;
+static const uint8_t CONTROL_INTCN  = 0x04;
+static const uint8_t CONTROL_A2IE   = 0x02;
+static const uint8_t CONTROL_A1IE   = 0x01;
+
+static const uint8_t STATUS_OSF     = 0x80;
+static const uint8_t STATUS_EN32KHZ = 0x08;
+static const uint8_t STATUS_BSY     = 0x04;
+static const uint8_t STATUS_A2F     = 0x02;
+static const uint8_t STATUS_A1F     = 0x01;
+static const uint8_t STATUS_FLAGS   = STATUS_OSF | STATUS_A2F | STATUS_A1F;
+
+static const unsigned TEMPERATURE_CONVERSION_S = 64;
+static const int32_t  AGING_LSB_PPB = 100;
+static const int64_t  PS_PER_MS = 1000000000;
+
+static uint8_t bcd2dec(uint8_t bcd) { return ((bcd >> 4) * 10) + (bcd & 0x0F); }
+static uint8_t dec2bcd(uint8_t dec) { return ((dec / 10) << 4) | (dec % 10); }
+
+DS3231Emu::DS3231Emu() : bus_hz(STANDARD_MODE_HZ), drift_ppb(0), alarm_time()
+{
+    resetStats();
+    powerOn();
+}
+
+void DS3231Emu::powerOn()
+{
+    for (auto& r : regs) r = 0;
+    regs[REG_DAY] = 1;
+    regs[REG_DATE] = 1;
+    regs[REG_MONTH] = 1;
+    regs[REG_CONTROL] = 0x1C;                       // INTCN, RS2, RS1
+    regs[REG_STATUS] = STATUS_OSF | STATUS_EN32KHZ;
+    temperature_quarters = 25 * 4;
+    drift_ps = 0;
+    conversion_s = 0;
+    convertTemperature();
+
+    pointer = 0;
+    pointer_set = false;
+    running = true;
+    sub_second_ms = 0;
+    uptime_ms = 0;
+    latchTime();
+}
+
+void DS3231Emu::setDateTime(uint32_t epoch)
+{
+    dt_date_t d;
+    dt_time_t t;
+    DateTime::setDateTimeFromEpoch(epoch, &d, &t);
+
+    regs[REG_SECONDS] = dec2bcd(t.second);
+    regs[REG_MINUTES] = dec2bcd(t.minute);
+    regs[REG_HOURS]   = dec2bcd(t.hour);
+    regs[REG_DAY]     = DateTime::getWeekDayFromEpoch(epoch) + 1;
+    regs[REG_DATE]    = dec2bcd(d.day);
+    regs[REG_MONTH]   = dec2bcd(d.month);
+    regs[REG_YEAR]    = dec2bcd(d.year % 100);
+    sub_second_ms = 0;
+}
+
+uint32_t DS3231Emu::getDateTime() const
+{
+    uint8_t hour = regs[REG_HOURS];
+    if (hour & HOURS_12H) {
+        hour = bcd2dec(hour & 0x1F) % 12 + ((hour & HOURS_PM) ? 12 : 0);
+    } else {
+        hour = bcd2dec(hour & 0x3F);
+    }
+    return DateTime::getEpochFromDateTime(2000 + bcd2dec(regs[REG_YEAR]), bcd2dec(regs[REG_MONTH] & 0x1F),
+                                          bcd2dec(regs[REG_DATE]), hour, bcd2dec(regs[REG_MINUTES]),
+                                          bcd2dec(regs[REG_SECONDS]));
+}
+
+void DS3231Emu::advance(uint32_t ms)
+{
+    uptime_ms += ms;
+    if (!running) return;
+
+    // ms * ppb is in picoseconds
+    drift_ps += static_cast<int64_t>(ms) * (drift_ppb - aging * AGING_LSB_PPB);
+    int64_t rtc_ms = static_cast<int64_t>(ms) + sub_second_ms + drift_ps / PS_PER_MS;
+    drift_ps %= PS_PER_MS;
+    for (; rtc_ms >= 1000; rtc_ms -= 1000) tickSecond();
+    sub_second_ms = static_cast<uint16_t>(rtc_ms > 0 ? rtc_ms : 0);
+}
+
+void DS3231Emu::stopOscillator()
+{
+    running = false;
+    regs[REG_STATUS] |= STATUS_OSF;
+}
+
+void DS3231Emu::getState(ds3231_emu_state_t* state) const
+{
+    static_assert(sizeof(state->regs) == REG_COUNT, "Register file size");
+    memcpy(state->regs, regs, sizeof(state->regs));
+    memcpy(state->time_buffer, time_buffer, sizeof(state->time_buffer));
+    state->pointer = pointer;
+    state->pointer_set = pointer_set;
+    state->running = running;
+    state->aging = aging;
+    state->conversion_s = conversion_s;
+    state->sub_second_ms = sub_second_ms;
+    state->temperature_quarters = temperature_quarters;
+    state->drift_ppb = drift_ppb;
+    state->drift_ps = drift_ps;
+    state->uptime_ms = uptime_ms;
+}
+
+void DS3231Emu::setState(const ds3231_emu_state_t* state)
+{
+    memcpy(regs, state->regs, sizeof(regs));
+    memcpy(time_buffer, state->time_buffer, sizeof(time_buffer));
+    pointer = state->pointer;
+    pointer_set = state->pointer_set;
+    running = state->running;
+    aging = state->aging;
+    conversion_s = state->conversion_s;
+    sub_second_ms = state->sub_second_ms;
+    temperature_quarters = state->temperature_quarters;
+    drift_ppb = state->drift_ppb;
+    drift_ps = state->drift_ps;
+    uptime_ms = state->uptime_ms;
+}
+
+bool DS3231Emu::isInterrupt() const
+{
+    if (!(regs[REG_CONTROL] & CONTROL_INTCN)) return false;
+    return ( (regs[REG_STATUS] & STATUS_A1F) && (regs[REG_CONTROL] & CONTROL_A1IE) ) ||
+           ( (regs[REG_STATUS] & STATUS_A2F) && (regs[REG_CONTROL] & CONTROL_A2IE) );
+}
+
+uint8_t DS3231Emu::getAlarmFlags() const
+{
+    return regs[REG_STATUS] & (STATUS_A1F | STATUS_A2F);
+}
+
+// ========================================================================================================= Bus interface
+
+void DS3231Emu::start(bool read)
+{
+    transactions++;
+    bus_clocks += 1 + 9;        // START, address + ACK
+    if (!read) pointer_set = false;
+    latchTime();
+}
+
+bool DS3231Emu::write(uint8_t value)
+{
+    bytes_written++;
+    bus_clocks += 9;
+    if (!pointer_set) {
+        if (value >= REG_COUNT) return false;
+        pointer = value;
+        pointer_set = true;
+        return true;
+    }
+    writeReg(pointer, value);
+    incrementPointer();
+    return true;
+}
+
+uint8_t DS3231Emu::read()
+{
+    bytes_read++;
+    bus_clocks += 9;
+    uint8_t value = (pointer < sizeof(time_buffer)) ? time_buffer[pointer] : regs[pointer];
+    incrementPointer();
+    return value;
+}
+
+void DS3231Emu::stop()
+{
+    bus_clocks += 1;
+}
+
+void DS3231Emu::latchTime()
+{
+    for (uint8_t i = 0; i < sizeof(time_buffer); i++) time_buffer[i] = regs[i];
+}
+
+void DS3231Emu::incrementPointer()
+{
+    if (++pointer == REG_COUNT) {
+        pointer = 0;
+        latchTime();
+    }
+}
+
+void DS3231Emu::writeReg(uint8_t reg, uint8_t value)
+{
+    switch (reg) {
+    case REG_SECONDS:
+        regs[reg] = value & 0x7F;
+        sub_second_ms = 0;      // Countdown chain is reset by seconds write
+        break;
+    case REG_MINUTES: regs[reg] = value & 0x7F; break;
+    case REG_HOURS:   regs[reg] = value & 0x7F; break;
+    case REG_DAY:     regs[reg] = value & 0x07; break;
+    case REG_DATE:    regs[reg] = value & 0x3F; break;
+    case REG_MONTH:   regs[reg] = value & 0x9F; break;
+    case REG_CONTROL:
+        regs[reg] = value;
+        if (value & CONTROL_CONV) {
+            // Conversion takes ~125ms on device, here it is done immediately
+            convertTemperature();
+            regs[reg] &= ~CONTROL_CONV;
+        }
+        break;
+    case REG_STATUS:
+        // Flags can be only cleared, BSY is read only
+        regs[reg] = (regs[reg] & STATUS_FLAGS & value) | (value & STATUS_EN32KHZ) | (regs[reg] & STATUS_BSY);
+        break;
+    case REG_TEMP_MSB:
+    case REG_TEMP_LSB:
+        break;
+    default:
+        regs[reg] = value;
+        break;
+    }
+    if (reg <= REG_YEAR) latchTime();
+}
+
+// ========================================================================================================= Timekeeping
+
+void DS3231Emu::tickSecond()
+{
+    uint8_t seconds = bcd2dec(regs[REG_SECONDS]) + 1;
+    if (seconds < 60) {
+        regs[REG_SECONDS] = dec2bcd(seconds);
+    } else {
+        regs[REG_SECONDS] = 0;
+        uint8_t minutes = bcd2dec(regs[REG_MINUTES]) + 1;
+        if (minutes < 60) {
+            regs[REG_MINUTES] = dec2bcd(minutes);
+        } else {
+            regs[REG_MINUTES] = 0;
+            uint8_t hours = regs[REG_HOURS];
+            if (hours & HOURS_12H) {
+                uint8_t h = bcd2dec(hours & 0x1F);
+                uint8_t pm = hours & HOURS_PM;
+                if (h == 11) pm ^= HOURS_PM;
+                h = (h == 12) ? 1 : h + 1;
+                regs[REG_HOURS] = HOURS_12H | pm | dec2bcd(h);
+                if (h == 12 && !pm) incrementDate();
+            } else {
+                uint8_t h = bcd2dec(hours & 0x3F) + 1;
+                if (h < 24) {
+                    regs[REG_HOURS] = dec2bcd(h);
+                } else {
+                    regs[REG_HOURS] = 0;
+                    incrementDate();
+                }
+            }
+        }
+    }
+
+    if (++conversion_s == TEMPERATURE_CONVERSION_S) {
+        conversion_s = 0;
+        convertTemperature();
+    }
+    checkAlarms();
+}
+
+void DS3231Emu::incrementDate()
+{
+    static const uint8_t days_in_month[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+    regs[REG_DAY] = (regs[REG_DAY] % 7) + 1;
+
+    uint8_t year  = bcd2dec(regs[REG_YEAR]);
+    uint8_t month = bcd2dec(regs[REG_MONTH] & 0x1F);
+    uint8_t date  = bcd2dec(regs[REG_DATE]) + 1;
+    uint8_t century = regs[REG_MONTH] & MONTH_CENTURY;
+    // Leap years are compensated up to 2100
+    uint8_t last = days_in_month[(month - 1) % 12] + ((month == 2 && (year % 4) == 0) ? 1 : 0);
+
+    if (date > last) {
+        date = 1;
+        if (++month > 12) {
+            month = 1;
+            if (++year > 99) {
+                year = 0;
+                century ^= MONTH_CENTURY;
+            }
+        }
+    }
+    regs[REG_DATE]  = dec2bcd(date);
+    regs[REG_MONTH] = century | dec2bcd(month);
+    regs[REG_YEAR]  = dec2bcd(year);
+}
+
+static bool fieldMatch(uint8_t alarm, uint8_t time)
+{
+    return (alarm & ALARM_MASK) || ( (alarm & 0x7F) == (time & 0x7F) );
+}
+
+bool DS3231Emu::dayMatch(uint8_t alarm_day) const
+{
+    if (alarm_day & ALARM_MASK) return true;
+    if (alarm_day & ALARM_DY) return (alarm_day & 0x0F) == regs[REG_DAY];
+    return (alarm_day & 0x3F) == regs[REG_DATE];
+}
+
+void DS3231Emu::checkAlarms()
+{
+    if ( fieldMatch(regs[REG_ALARM1_SECONDS], regs[REG_SECONDS]) &&
+         fieldMatch(regs[REG_ALARM1_MINUTES], regs[REG_MINUTES]) &&
+         fieldMatch(regs[REG_ALARM1_HOURS],   regs[REG_HOURS]) &&
+         dayMatch(regs[REG_ALARM1_DAY]) ) {
+        if (!(regs[REG_STATUS] & STATUS_A1F)) alarm_time[0] = getDateTime();
+        regs[REG_STATUS] |= STATUS_A1F;
+    }
+    // Alarm 2 has no seconds register, it matches at 00 seconds
+    if ( regs[REG_SECONDS] == 0 &&
+         fieldMatch(regs[REG_ALARM2_MINUTES], regs[REG_MINUTES]) &&
+         fieldMatch(regs[REG_ALARM2_HOURS],   regs[REG_HOURS]) &&
+         dayMatch(regs[REG_ALARM2_DAY]) ) {
+        if (!(regs[REG_STATUS] & STATUS_A2F)) alarm_time[1] = getDateTime();
+        regs[REG_STATUS] |= STATUS_A2F;
+    }
+}
+
+void DS3231Emu::convertTemperature()
+{
+    aging = static_cast<int8_t>(regs[REG_AGING]);
+    uint16_t raw = static_cast<uint16_t>(temperature_quarters) << 6;
+    regs[REG_TEMP_MSB] = static_cast<uint8_t>(raw >> 8);
+    regs[REG_TEMP_LSB] = static_cast<uint8_t>(raw);
+}
@@ -0,0 +1,106 @@
+#pragma once
+/**
+ * DS3231 model attached to TwiFake bus.
+ * Register file, BCD timekeeping (12/24h, leap years, century bit), both alarms with all match modes,
+ * status flags write semantics, time transfer buffer latched on START and I2C bus timing cost.
+ * Time runs only when advance() is called, so simulation may drive it at any speed.
+ */
+#include <stdint.h>
+#include "TwiFake.h"
+
+// Device state without bus statistics, for simulation snapshots
+typedef struct
+{
+    uint8_t  regs[0x13];
+    uint8_t  time_buffer[7];
+    uint8_t  pointer;
+    bool     pointer_set;
+    bool     running;
+    int8_t   aging;
+    uint8_t  conversion_s;
+    uint16_t sub_second_ms;
+    int16_t  temperature_quarters;
+    int32_t  drift_ppb;
+    int64_t  drift_ps;
+    uint64_t uptime_ms;
+} ds3231_emu_state_t;
+
+class DS3231Emu : public TwiFakeDevice
+{
+public:
+    static const uint8_t  ADDRESS = 0x68;
+    static const uint8_t  REG_COUNT = 0x13;
+    static const unsigned STANDARD_MODE_HZ = 100000;
+
+    DS3231Emu();
+
+    // Registers as after first power up: 2000-01-01 00:00:00, oscillator stop flag set
+    void powerOn();
+    // Backdoor access, no bus timing, no write semantics
+    void setDateTime(uint32_t epoch);
+    uint32_t getDateTime() const;
+    uint8_t getReg(uint8_t reg) const { return regs[reg]; }
+    void setReg(uint8_t reg, uint8_t value) { regs[reg] = value; }
+    void getState(ds3231_emu_state_t* state) const;
+    void setState(const ds3231_emu_state_t* state);
+
+    // Fast-forward clock, "ms" is reference time, RTC runs faster or slower according to drift
+    void advance(uint32_t ms);
+    uint64_t getUptimeMs() const { return uptime_ms; }
+    // Milliseconds since the last RTC second
+    uint16_t getSubSecondMs() const { return sub_second_ms; }
+
+    // Oscillator stopped (e.g. battery removed while unpowered), sets OSF
+    void stopOscillator();
+    void startOscillator() { running = true; }
+    // In 1/4 of Celsius degree, visible in registers after next conversion
+    void setTemperature(int16_t temperature) { temperature_quarters = temperature; }
+    // Oscillator error with aging offset 0, positive when clock runs fast. Aging offset is applied
+    // on temperature conversion, 0.1ppm per LSB
+    void setDrift(int32_t ppb) { drift_ppb = ppb; }
+    // INT/SQW output asserted (active low on real device)
+    bool isInterrupt() const;
+    // A1F in bit 0, A2F in bit 1
+    uint8_t getAlarmFlags() const;
+    // RTC time when the flag of alarm 1 or 2 was last raised, time may be advanced past it in one call
+    uint32_t getAlarmDateTime(uint8_t alarm) const { return alarm_time[alarm == 1 ? 0 : 1]; }
+
+    // Bus cost model
+    unsigned bus_hz;
+    uint64_t bus_clocks;        ///< SCL periods spent on transfers to this device
+    unsigned transactions;      ///< START conditions, repeated START included
+    unsigned bytes_written;     ///< Register address included
+    unsigned bytes_read;
+    void resetStats() { bus_clocks = 0; transactions = bytes_written = bytes_read = 0; }
+    uint64_t getBusTimeUs() const { return bus_clocks * 1000000u / bus_hz; }
+
+    // TwiFakeDevice
+    void start(bool read) override;
+    bool write(uint8_t value) override;
+    uint8_t read() override;
+    void stop() override;
+
+private:
+    uint8_t  regs[REG_COUNT];
+    uint8_t  time_buffer[7];    ///< Time registers latched for bus reads
+    uint8_t  pointer;
+    bool     pointer_set;
+    bool     running;
+    uint16_t sub_second_ms;
+    uint64_t uptime_ms;
+    int16_t  temperature_quarters;
+    int32_t  drift_ppb;
+    int8_t   aging;             ///< Aging offset used by oscillator
+    int64_t  drift_ps;          ///< Accumulated drift not yet applied to time
+    uint8_t  conversion_s;      ///< Seconds since last periodic temperature conversion
+    uint32_t alarm_time[2];
+
+    void latchTime();
+    void incrementPointer();
+    void writeReg(uint8_t reg, uint8_t value);
+    void tickSecond();
+    void incrementDate();
+    void checkAlarms();
+    void convertTemperature();
+    bool dayMatch(uint8_t alarm_day) const;
+};
@@ -0,0 +1,108 @@
+#include "DateTime.h"
+#include "Dcf77Signal.h"
+
+//                                                jitter, missing, spikes, dropouts, seed
+const dcf77_noise_t Dcf77Signal::CLEAN = {             0,     0.0,    0.0,      0.0,    1 };
+const dcf77_noise_t Dcf77Signal::NOISY = {            15,    0.01,    0.2,      0.1,    1 };
+
+static const uint16_t MINUTE_MS = 60000;
+static const uint16_t GLITCH_MAX_MS = 30;
+
+static void setBcd(uint64_t* frame, uint8_t first, uint8_t value)
+{
+    *frame |= static_cast<uint64_t>( ((value / 10) << 4) | (value % 10) ) << first;
+}
+
+static void setParity(uint64_t* frame, uint8_t first, uint8_t count)
+{
+    uint64_t bits = (*frame >> first) & ((static_cast<uint64_t>(1) << count) - 1);
+    bool parity = false;
+    for (; bits; bits >>= 1) parity ^= bits & 1;
+    if (parity) *frame |= static_cast<uint64_t>(1) << (first + count);
+}
+
+uint64_t Dcf77Signal::encodeFrame(uint32_t time)
+{
+    const bool dst = DateTime::isUtcInDstTime(time);
+    const uint32_t local = DateTime::getLocalDateTimeFromUtc(time);
+    dt_date_t d;
+    dt_time_t t;
+    DateTime::setDateTimeFromEpoch(local, &d, &t);
+
+    uint64_t frame = static_cast<uint64_t>(1) << (dst ? 17 : 18);
+    frame |= static_cast<uint64_t>(1) << 20;
+    setBcd(&frame, 21, t.minute);
+    setParity(&frame, 21, 7);
+    setBcd(&frame, 29, t.hour);
+    setParity(&frame, 29, 6);
+    setBcd(&frame, 36, d.day);
+    frame |= static_cast<uint64_t>(DateTime::getWeekDayFromEpoch(local) + 1) << 42;
+    setBcd(&frame, 45, d.month);
+    setBcd(&frame, 50, d.year % 100);
+    setParity(&frame, 36, 22);
+    return frame;
+}
+
+void Dcf77Signal::begin(uint64_t ms, const dcf77_noise_t* noise)
+{
+    this->noise = *noise;
+    random = noise->seed ? noise->seed : 1;
+    render(ms - ms % MINUTE_MS);
+    while (next < edges.size() && edges[next] < ms) next++;
+    level = (next & 1) != 0;
+}
+
+uint64_t Dcf77Signal::getNextEdgeMs()
+{
+    while (next >= edges.size()) render(minute_ms + MINUTE_MS);
+    return edges[next];
+}
+
+bool Dcf77Signal::popEdge()
+{
+    getNextEdgeMs();
+    next++;
+    level = !level;
+    return level;
+}
+
+// xorshift32, [0, 1)
+double Dcf77Signal::nextRandom()
+{
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    return random / 4294967296.0;
+}
+
+void Dcf77Signal::render(uint64_t start_ms)
+{
+    std::vector<bool> pulse(MINUTE_MS, false);
+    const uint64_t frame = encodeFrame( static_cast<uint32_t>(start_ms / 1000) + 60 );
+    auto jitter = [&]() { return static_cast<int>(nextRandom() * (2 * noise.jitter_ms + 1)) - noise.jitter_ms; };
+
+    for (uint16_t second = 0; second < 59; second++) {
+        if (nextRandom() < noise.missing) continue;
+        int start = second * 1000 + noise.jitter_ms + jitter();
+        int end = start + (((frame >> second) & 1) ? 200 : 100) + jitter();
+        for (int i = start; i < end; i++) pulse[i] = true;
+    }
+    // Spike or dropout flips the level, only the ones falling where the level is as expected are kept
+    for (uint16_t second = 0; second < 60; second++) {
+        for (int kind = 0; kind < 2; kind++) {
+            if (nextRandom() >= (kind ? noise.dropouts : noise.spikes)) continue;
+            int start = second * 1000 + static_cast<int>(nextRandom() * 1000);
+            int end = start + 1 + static_cast<int>(nextRandom() * GLITCH_MAX_MS);
+            if (end >= MINUTE_MS || pulse[start] != (kind == 1)) continue;
+            for (int i = start; i < end; i++) pulse[i] = !pulse[i];
+        }
+    }
+
+    // Rendered minute starts and ends without pulse
+    edges.clear();
+    next = 0;
+    minute_ms = start_ms;
+    for (uint16_t i = 0; i < MINUTE_MS; i++) {
+        if (pulse[i] != (i ? pulse[i - 1] : false)) edges.push_back(start_ms + i);
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+/**
+ * Synthetic DCF77 receiver output for the simulator and tests.
+ * Every minute is rendered with 1ms resolution: pulses of the frame with jitter of their edges, missing pulses,
+ * short spikes in gaps and short dropouts in pulses. Noise is pseudo random, the same seed gives the same signal.
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+typedef struct
+{
+    uint16_t jitter_ms;         ///< Edges are moved by up to that
+    double   missing;           ///< Probability of missing pulse
+    double   spikes;            ///< Per second, short pulses in gaps
+    double   dropouts;          ///< Per second, short gaps in pulses
+    uint32_t seed;
+} dcf77_noise_t;
+
+class Dcf77Signal
+{
+public:
+    static const dcf77_noise_t CLEAN;
+    static const dcf77_noise_t NOISY;
+
+    // Signal from true time "ms", it starts without pulse
+    void begin(uint64_t ms, const dcf77_noise_t* noise);
+    // Time of the next level change
+    uint64_t getNextEdgeMs();
+    // Takes the next level change, returns the new level: true in pulse
+    bool popEdge();
+
+    // Frame sent in the minute before "time" (UTC, whole minute), bit 0 is the first one
+    static uint64_t encodeFrame(uint32_t time);
+
+private:
+    dcf77_noise_t         noise;
+    uint32_t              random;
+    uint64_t              minute_ms;    ///< Start of the rendered minute
+    std::vector<uint64_t> edges;        ///< Level changes of the rendered minute, the first one starts pulse
+    size_t                next;
+    bool                  level;
+
+    double nextRandom();
+    void render(uint64_t start_ms);
+};
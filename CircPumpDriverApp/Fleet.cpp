@@ -0,0 +1,313 @@
+#include "DateTime.h"
+#include "Fleet.h"
+#include "CircPumpConfig.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+uint8_t Fleet::addProfile(const fleet_profile_t* profile)
+{
+    window_cache_t window = { 0, 0 };
+    profiles.push_back(*profile);
+    windows.push_back(window);
+    return static_cast<uint8_t>(profiles.size() - 1);
+}
+
+size_t Fleet::add(uint8_t profile_index, int32_t rtc_offset_s, uint32_t boot_delay_s)
+{
+    // State is set by start()
+    next_time.push_back(0);
+    last_off_time.push_back(0);
+    rtc_offset.push_back(rtc_offset_s);
+    boot_delay.push_back(boot_delay_s);
+    profile.push_back(profile_index);
+    pump_on.push_back(0);
+    relay_events.push_back(0);
+    return next_time.size() - 1;
+}
+
+void Fleet::start(uint32_t start_time)
+{
+    time = start_time;
+    pumps_on = 0;
+    memset(&stats, 0, sizeof(stats));
+    for (auto& window : windows) window.from = window.until = 0;
+
+    for (size_t i = 0; i < size(); i++) {
+        pump_on[i] = 0;
+        relay_events[i] = 0;
+        last_off_time[i] = DateTime::EPOCH_ERROR;
+        next_time[i] = time + boot_delay[i];
+        if (!boot_delay[i]) boot(i, time + rtc_offset[i]);
+    }
+
+    chunk_min.resize( (size() + SCAN_CHUNK - 1) / SCAN_CHUNK );
+    for (size_t chunk = 0; chunk < chunk_min.size(); chunk++) {
+        size_t begin = chunk * SCAN_CHUNK;
+        chunk_min[chunk] = *std::min_element(next_time.begin() + begin,
+                                             next_time.begin() + std::min(begin + SCAN_CHUNK, size()));
+    }
+}
+
+// Same as setupFirstOn() of the firmware
+bool Fleet::boot(size_t i, uint32_t rtc_time)
+{
+    const fleet_profile_t* p = &profiles[profile[i]];
+    uint32_t local = DateTime::getLocalDateTimeFromUtc(rtc_time);
+    uint32_t on_time = CircShedule::getNextOnTime(p->table, local);
+    bool on = (on_time == local);
+
+    pump_on[i] = on;
+    pumps_on += on;
+    relay_events[i] += on;
+    last_off_time[i] = 0;
+    uint32_t next = on ? CircShedule::getNextPulseOffTime(&p->pulse, rtc_time, 0) : DateTime::getUtcDateTimeFromLocal(on_time);
+    next_time[i] = next - rtc_offset[i];
+    return on;
+}
+
+void Fleet::updateWindow(window_cache_t* window, const circ_shedule_table_t* table, uint32_t rtc_time)
+{
+    window->from = window->until = rtc_time;
+
+    uint32_t local = DateTime::getLocalDateTimeFromUtc(rtc_time);
+    if (CircShedule::getNextOnTime(table, local) != local) return;
+
+    // Entry found by getNextOnTime(), window is cut at its end or at midnight
+    dt_time_t t;
+    DateTime::setDateTimeFromEpoch(local, nullptr, &t);
+    uint16_t ct = CT(t.hour, t.minute, t.second);
+    const circ_shedule_entry_t* entry = &(*table)[DateTime::getDayTypeFromEpoch(local)][0];
+    for (int i = 0; i < CIRC_PERIODS_PER_DAY && entry->beg < entry->end; i++, entry++) {
+        if (ct >= entry->beg && ct <= entry->end) break;
+    }
+    uint32_t until_local = local - (local % DateTime::ONE_DAY) + CT_TO_S(entry->end);
+    if (until_local <= local) return;
+
+    // No DST switch inside, so RTC and local time go in step
+    uint32_t until = rtc_time + (until_local - local);
+    if ( DateTime::getUtcDateTimeFromLocal(local) != rtc_time ||
+         DateTime::getLocalDateTimeFromUtc(until - 1) != until_local - 1 ||
+         DateTime::getUtcDateTimeFromLocal(until_local - 1) != until - 1 ) return;
+    window->until = until;
+}
+
+uint32_t Fleet::getNextOnTime(uint8_t profile_index, uint32_t now, uint32_t last_off)
+{
+    const fleet_profile_t* p = &profiles[profile_index];
+    window_cache_t* window = &windows[profile_index];
+
+    // Same as CircShedule::getNextPulseOnTime() when the break ends inside open window
+    uint32_t on_time = now + (CircShedule::isFirstPulse(&p->pulse, now, last_off) ? p->pulse.off_time_first
+                                                                                   : p->pulse.off_time_next);
+    if (on_time >= window->until) updateWindow(window, p->table, on_time);
+    if (on_time >= window->from && on_time < window->until) return on_time;
+    return CircShedule::getNextPulseOnTime(p->table, &p->pulse, now, last_off);
+}
+
+bool Fleet::toggle(size_t i)
+{
+    uint32_t now = next_time[i] + rtc_offset[i];
+    uint32_t next;
+    if (last_off_time[i] == DateTime::EPOCH_ERROR) return boot(i, now);
+    if (pump_on[i]) {
+        next = getNextOnTime(profile[i], now, last_off_time[i]);
+        last_off_time[i] = now;
+        pumps_on--;
+    } else {
+        next = CircShedule::getNextPulseOffTime(&profiles[profile[i]].pulse, now, last_off_time[i]);
+        pumps_on++;
+    }
+    pump_on[i] ^= 1;
+    next_time[i] = next - rtc_offset[i];
+    relay_events[i]++;
+    return true;
+}
+
+// Toggles controllers due at "step" and updates the chunk minimum
+uint32_t Fleet::runChunk(size_t chunk, uint32_t step)
+{
+    const size_t begin = chunk * SCAN_CHUNK;
+    const size_t end = std::min(begin + SCAN_CHUNK, size());
+    uint32_t events = 0;
+    for (size_t i = begin; i < end; i++) {
+        if (next_time[i] <= step) events += toggle(i);
+    }
+    chunk_min[chunk] = *std::min_element(next_time.begin() + begin, next_time.begin() + end);
+    return events;
+}
+
+void Fleet::run(uint32_t until, fleet_observer_t observer, void* arg)
+{
+    const size_t chunks = chunk_min.size();
+    uint32_t step = chunks ? *std::min_element(chunk_min.begin(), chunk_min.end()) : until;
+    while (step < until) {
+        stats.pump_on_s += static_cast<uint64_t>(pumps_on) * (step - time);
+        time = step;
+
+        uint32_t events = 0;
+        uint32_t next_step = UINT32_MAX;
+        for (size_t chunk = 0; chunk < chunks; chunk++) {
+            if (chunk_min[chunk] <= step) events += runChunk(chunk, step);
+            next_step = std::min(next_step, chunk_min[chunk]);
+        }
+
+        stats.steps++;
+        stats.relay_events += events;
+        stats.max_events_per_second = std::max(stats.max_events_per_second, events);
+        stats.max_pumps_on = std::max(stats.max_pumps_on, pumps_on);
+        if (observer && events) observer(arg, time, events, pumps_on);
+        step = next_step;
+    }
+    stats.pump_on_s += static_cast<uint64_t>(pumps_on) * (until - time);
+    time = until;
+}
+
+// ========================================================================================================= Command
+
+typedef struct
+{
+    FILE*    out;
+    uint32_t minute;
+    uint32_t relay_events;
+    uint32_t max_events_per_second;
+    uint32_t max_pumps_on;
+} fleet_series_t;
+
+static void flushSeries(fleet_series_t* series)
+{
+    if (!series->relay_events) return;
+    uint32_t local = DateTime::getLocalDateTimeFromUtc(series->minute * 60);
+    dt_date_t d;
+    dt_time_t t;
+    DateTime::setDateTimeFromEpoch(local, &d, &t);
+    fprintf(series->out, "%04u-%02u-%02u %02u:%02u,%u,%u,%u\n", d.year, d.month, d.day, t.hour, t.minute,
+            series->relay_events, series->max_events_per_second, series->max_pumps_on);
+}
+
+// Aggregates seconds into minutes
+static void observeSeries(void* arg, uint32_t time, uint32_t relay_events, uint32_t pumps_on)
+{
+    fleet_series_t* series = static_cast<fleet_series_t*>(arg);
+    if (time / 60 != series->minute) {
+        flushSeries(series);
+        series->minute = time / 60;
+        series->relay_events = series->max_events_per_second = series->max_pumps_on = 0;
+    }
+    series->relay_events += relay_events;
+    series->max_events_per_second = std::max(series->max_events_per_second, relay_events);
+    series->max_pumps_on = std::max(series->max_pumps_on, pumps_on);
+}
+
+/**
+ * fleet [--controllers N] [--from YYYY-MM-DD] [--days N] [--vacations PERCENT] [--spread S] [--boot-spread S]
+ *       [--seed N] [--series FILE]
+ * Controllers run firmware tables and pulses, RTC offsets are uniform in +/-S seconds and power up times
+ * in the first boot-spread seconds (one hour by default). Pulses in on-windows lasting past midnight keep
+ * their phase from the power up, so without the spread the whole fleet switches at the same second.
+ * Series is CSV with local minute, relay events, max relay events in one second and max pumps on.
+ */
+int run_fleet(int argc, char* argv[])
+{
+    uint32_t controllers = 100000;
+    uint32_t from = DateTime::getUtcDateTimeFromLocal(DateTime::getEpochFromDateTime(2017, 10, 29, 0, 0, 0));
+    uint32_t days = 7;
+    uint32_t vacations_percent = 20;
+    uint32_t spread_s = 30;
+    uint32_t boot_spread_s = DateTime::ONE_HOUR;
+    uint64_t seed = 1;
+    const char* series_name = NULL;
+
+    for (int i = 0; i < argc; i++) {
+        const char* option = argv[i];
+        if (i + 1 == argc) {
+            printf("Missing value: %s\n", option);
+            return 2;
+        }
+        bool ok = true;
+        if (!strcmp(option, "--controllers")) {
+            controllers = static_cast<uint32_t>(atoi(argv[++i]));
+            ok = (controllers > 0);
+        } else if (!strcmp(option, "--from")) {
+            unsigned year, month, day;
+            uint32_t local = (sscanf(argv[++i], "%u-%u-%u", &year, &month, &day) == 3)
+                           ? DateTime::getEpochFromDateTime(year, month, day, 0, 0, 0) : DateTime::EPOCH_ERROR;
+            ok = (local != DateTime::EPOCH_ERROR);
+            if (ok) from = DateTime::getUtcDateTimeFromLocal(local);
+        } else if (!strcmp(option, "--days")) {
+            days = static_cast<uint32_t>(atoi(argv[++i]));
+            ok = (days > 0);
+        } else if (!strcmp(option, "--vacations")) {
+            vacations_percent = static_cast<uint32_t>(atoi(argv[++i]));
+            ok = (vacations_percent <= 100);
+        } else if (!strcmp(option, "--spread")) {
+            spread_s = static_cast<uint32_t>(atoi(argv[++i]));
+        } else if (!strcmp(option, "--boot-spread")) {
+            boot_spread_s = static_cast<uint32_t>(atoi(argv[++i]));
+        } else if (!strcmp(option, "--seed")) {
+            seed = strtoull(argv[++i], NULL, 0);
+        } else if (!strcmp(option, "--series")) {
+            series_name = argv[++i];
+        } else {
+            printf("Unknown option: %s\n", option);
+            return 2;
+        }
+        if (!ok) {
+            printf("Invalid option: %s %s\n", option, argv[i]);
+            return 2;
+        }
+    }
+
+    Fleet fleet;
+    const fleet_profile_t workweek = { &workweek_shedule_table, pulse_config };
+    const fleet_profile_t vacations = { &vacations_shedule_table, pulse_config };
+    uint8_t profiles[2] = { fleet.addProfile(&workweek), fleet.addProfile(&vacations) };
+
+    uint64_t state = seed ? seed : 1;
+    for (uint32_t i = 0; i < controllers; i++) {
+        // xorshift64*
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        uint64_t random = state * 0x2545F4914F6CDD1DULL;
+        bool on_vacations = (random >> 32) % 100 < vacations_percent;
+        int32_t offset = static_cast<int32_t>( (random & 0xFFFFFFFF) % (2 * spread_s + 1) ) - static_cast<int32_t>(spread_s);
+        uint32_t boot_delay = boot_spread_s ? static_cast<uint32_t>( (random >> 16) % boot_spread_s ) : 0;
+        fleet.add(profiles[on_vacations ? 1 : 0], offset, boot_delay);
+    }
+
+    fleet_series_t series = { NULL, 0, 0, 0, 0 };
+    if (series_name) {
+        series.out = fopen(series_name, "w");
+        if (!series.out) {
+            printf("Cannot open %s\n", series_name);
+            return 1;
+        }
+        fprintf(series.out, "minute,relay_events,max_events_per_second,max_pumps_on\n");
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    fleet.start(from);
+    fleet.run(from + days * DateTime::ONE_DAY, series.out ? observeSeries : NULL, &series);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (series.out) {
+        flushSeries(&series);
+        fclose(series.out);
+    }
+
+    const fleet_stats_t& stats = fleet.getStats();
+    const double seconds = days * static_cast<double>(DateTime::ONE_DAY);
+    printf("Controllers:       %u (%u%% on vacations table, RTC offsets +/-%us, power up in %us)\n", controllers,
+           vacations_percent, spread_s, boot_spread_s);
+    printf("Simulated:         %u days\n", days);
+    printf("Relay events:      %llu\n", static_cast<unsigned long long>(stats.relay_events));
+    printf("Relay events/s:    %.2f mean, %u max\n", stats.relay_events / seconds, stats.max_events_per_second);
+    printf("Pumps on:          %.1f mean, %u max\n", stats.pump_on_s / seconds, stats.max_pumps_on);
+    printf("Engine:            %u steps in %.2f s, %.3g controller-seconds/s\n", stats.steps, elapsed,
+           controllers * seconds / elapsed);
+    return 0;
+}
@@ -0,0 +1,93 @@
+#pragma once
+/**
+ * Lockstep simulation of large fleets of pump controllers.
+ * Controller state is kept in contiguous arrays (structure of arrays) split into chunks with cached minimum of the
+ * next event time. Every step scans the minimums for the chunks with events due in the current second and for the
+ * next step time, only the due chunks are scanned controller by controller. Pump edges are computed by the same
+ * CircShedule planner as in the firmware; pulses ending inside the on-window being currently open take a shortcut
+ * which gives the same result without local time conversions.
+ * Each controller may have its RTC off by some seconds, so fleet time is the true one.
+ * Schedule evaluation is not vectorised: few controllers have an edge in a given second and the planner branches on
+ * the table, DST and holidays, so skipping idle chunks gains more than running the planner in SIMD lanes.
+ * Controllers do not use circ_context_t of the sketch: it lives in the .ino, together with RTC snapshot, event queue
+ * and button state which fleet does not need, so only the fields the planner reads are kept in the arrays.
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "CircShedule.h"
+
+typedef struct
+{
+    const circ_shedule_table_t* table;
+    circ_pulse_config_t         pulse;
+} fleet_profile_t;
+
+typedef struct
+{
+    uint64_t relay_events;
+    uint64_t pump_on_s;                 ///< Sum over all controllers
+    uint32_t steps;                     ///< Seconds with at least one event
+    uint32_t max_events_per_second;
+    uint32_t max_pumps_on;
+} fleet_stats_t;
+
+// Called for every second with relay events
+typedef void (*fleet_observer_t)(void* arg, uint32_t time, uint32_t relay_events, uint32_t pumps_on);
+
+class Fleet
+{
+public:
+    uint8_t addProfile(const fleet_profile_t* profile);
+    // Controller is powered up boot_delay_s after start
+    size_t add(uint8_t profile, int32_t rtc_offset_s, uint32_t boot_delay_s = 0);
+    size_t size() const { return next_time.size(); }
+
+    // Controllers without boot delay are set as after setup() at true time "time"
+    void start(uint32_t time);
+    // Runs till "until" (exclusive), time stays at "until"
+    void run(uint32_t until, fleet_observer_t observer = NULL, void* arg = NULL);
+
+    uint32_t getTime() const { return time; }
+    bool isPumpOn(size_t i) const { return pump_on[i] != 0; }
+    uint32_t getRelayEvents(size_t i) const { return relay_events[i]; }
+    uint32_t getPumpsOn() const { return pumps_on; }
+    const fleet_stats_t& getStats() const { return stats; }
+
+private:
+    // Interval of RTC time inside open on-window with constant UTC offset
+    typedef struct
+    {
+        uint32_t from;
+        uint32_t until;
+    } window_cache_t;
+
+    std::vector<fleet_profile_t> profiles;
+    std::vector<window_cache_t>  windows;
+
+    // Controllers
+    std::vector<uint32_t> next_time;        ///< True time of the next pump edge
+    std::vector<uint32_t> last_off_time;    ///< RTC time, EPOCH_ERROR till the controller boots
+    std::vector<int32_t>  rtc_offset;
+    std::vector<uint32_t> boot_delay;
+    std::vector<uint8_t>  profile;
+    std::vector<uint8_t>  pump_on;
+    std::vector<uint32_t> relay_events;
+    std::vector<uint32_t> chunk_min;        ///< Minimum of next_time for every SCAN_CHUNK controllers
+
+    uint32_t      time;
+    uint32_t      pumps_on;
+    fleet_stats_t stats;
+
+    static const size_t SCAN_CHUNK = 16;
+
+    uint32_t runChunk(size_t chunk, uint32_t step);
+    uint32_t getNextOnTime(uint8_t profile_index, uint32_t now, uint32_t last_off);
+    void updateWindow(window_cache_t* window, const circ_shedule_table_t* table, uint32_t rtc_time);
+    // Return true if relay is switched
+    bool boot(size_t i, uint32_t rtc_time);
+    bool toggle(size_t i);
+};
+
+// "fleet" command of the host application
+int run_fleet(int argc, char* argv[]);
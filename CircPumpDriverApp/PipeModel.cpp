@@ -0,0 +1,47 @@
+#include "PipeModel.h"
+
+#include <math.h>
+
+// Upwind scheme is stable while water moves at most one segment per step
+static const uint32_t STEP_MS = 1000;
+
+static const double NTC_R25 = 10000.0;
+static const double NTC_B = 3950.0;
+static const double NTC_FIXED_R = 10000.0;
+static const double KELVIN = 273.15;
+
+void PipeModel::begin(const pipe_config_t* config)
+{
+    this->config = *config;
+    for (unsigned i = 0; i < SEGMENTS; i++) temps[i] = config->ambient_temp;
+}
+
+void PipeModel::advance(uint32_t ms, bool pump_on)
+{
+    while (ms) {
+        uint32_t step_ms = (ms < STEP_MS) ? ms : STEP_MS;
+        step(step_ms / 1000.0, pump_on);
+        ms -= step_ms;
+    }
+}
+
+void PipeModel::step(double dt, bool pump_on)
+{
+    if (pump_on) {
+        const double moved = fmin(SEGMENTS * dt / config.loop_time_s, 1.0);
+        for (unsigned i = SEGMENTS; i--; ) {
+            const double upstream = i ? temps[i - 1] : config.supply_temp;
+            temps[i] += moved * (upstream - temps[i]);
+        }
+    }
+    const double kept = exp(-dt / config.cooling_time_s);
+    for (unsigned i = 0; i < SEGMENTS; i++) {
+        temps[i] = config.ambient_temp + (temps[i] - config.ambient_temp) * kept;
+    }
+}
+
+uint16_t PipeModel::getNtcAdc(double temp)
+{
+    const double r = NTC_R25 * exp(NTC_B * (1.0 / (temp + KELVIN) - 1.0 / (25.0 + KELVIN)));
+    return static_cast<uint16_t>(1023.0 * r / (r + NTC_FIXED_R) + 0.5);
+}
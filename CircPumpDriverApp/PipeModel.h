@@ -0,0 +1,38 @@
+#pragma once
+/**
+ * Heat loss model of a hot water circulation loop for the simulator.
+ * Loop is a chain of segments from the heater outlet back to the return pipe NTC. With pump on, water moves by
+ * upwind scheme and heater feeds it at supply temperature, every segment cools down to ambient exponentially.
+ * Farthest tap is in the middle of the loop.
+ */
+#include <stdint.h>
+
+typedef struct
+{
+    double supply_temp;         ///< Celsius degrees, heater outlet
+    double ambient_temp;
+    double loop_time_s;         ///< Water goes around the loop with pump on
+    double cooling_time_s;      ///< Time constant of pipe cooling to ambient
+} pipe_config_t;
+
+class PipeModel
+{
+public:
+    static const unsigned SEGMENTS = 32;
+
+    // Loop at ambient temperature
+    void begin(const pipe_config_t* config);
+    void advance(uint32_t ms, bool pump_on);
+
+    double getReturnTemp() const { return temps[SEGMENTS - 1]; }
+    double getTapTemp() const { return temps[SEGMENTS / 2]; }
+    // 10-bit ADC reading of 10k B3950 NTC to ground with 10k to Vcc, as read by the firmware
+    uint16_t getReturnAdc() const { return getNtcAdc(getReturnTemp()); }
+    static uint16_t getNtcAdc(double temp);
+
+private:
+    pipe_config_t config;
+    double        temps[SEGMENTS];
+
+    void step(double dt, bool pump_on);
+};
@@ -0,0 +1,184 @@
+#include "DateTime.h"
+#include "Replay.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+Replay::Replay() : lines(0), last_time(DateTime::EPOCH_ERROR), host_time(DateTime::EPOCH_ERROR), pending_mode(SIZE_MAX),
+                   next(0), tolerance(0), from(0), matched(0), diverged(false), divergence()
+{
+}
+
+uint32_t Replay::parseDisplayDateTime(const char* str)
+{
+    unsigned year, day, hour, minute, second;
+    char month_name[4], day_name[4];
+    if (sscanf(str, "%u-%3s-%u, %3s, %u:%u:%u", &year, month_name, &day, day_name, &hour, &minute, &second) != 7) {
+        return DateTime::EPOCH_ERROR;
+    }
+    for (unsigned month = DateTime::JANUARY; month <= DateTime::DECEMBER; month++) {
+        if (!strcmp(month_name, DateTime::getMonthAbbrev(static_cast<DateTime::MONTHS>(month)))) {
+            return DateTime::getEpochFromDateTime(year, month, day, hour, minute, second);
+        }
+    }
+    return DateTime::EPOCH_ERROR;
+}
+
+uint32_t Replay::toUtc(uint32_t local) const
+{
+    if (local == DateTime::EPOCH_ERROR) return local;
+    uint32_t utc = DateTime::getUtcDateTimeFromLocal(local);
+    uint32_t earlier = utc - DateTime::ONE_HOUR;
+    uint32_t later = utc + DateTime::ONE_HOUR;
+    bool known = (last_time != DateTime::EPOCH_ERROR);
+
+    if (DateTime::getLocalDateTimeFromUtc(earlier) == local && (!known || earlier >= last_time)) return earlier;
+    if (DateTime::getLocalDateTimeFromUtc(later) == local && known && utc < last_time) return later;
+    return utc;
+}
+
+void Replay::addEvent(uint8_t type, bool on, uint32_t time)
+{
+    if (time == DateTime::EPOCH_ERROR) time = (host_time != DateTime::EPOCH_ERROR) ? host_time : last_time;
+    // Firmware prints pump state right after mode change
+    if (type == REPLAY_PUMP && pending_mode < events.size()) events[pending_mode].time = time;
+    pending_mode = (type == REPLAY_MODE && host_time == DateTime::EPOCH_ERROR) ? events.size() : SIZE_MAX;
+
+    replay_event_t event = { type, on, lines, time };
+    events.push_back(event);
+    if (time != DateTime::EPOCH_ERROR && type != REPLAY_BUILD_DATE) last_time = time;
+}
+
+void Replay::addLine(const char* line)
+{
+    lines++;
+    host_time = DateTime::EPOCH_ERROR;
+
+    // Host timestamp
+    const char* text = line + (line[0] == '[' ? 1 : 0);
+    unsigned year, month, day, hour, minute, second;
+    int length = 0;
+    if (sscanf(text, "%4u-%2u-%2u%*[ T]%2u:%2u:%2u%n", &year, &month, &day, &hour, &minute, &second, &length) == 6 && length) {
+        uint32_t local = DateTime::getEpochFromDateTime(year, month, day, hour, minute, second);
+        if (local != DateTime::EPOCH_ERROR) {
+            host_time = toUtc(local);
+            text += length;
+            text += strspn(text, ".,0123456789");
+            if (*text == ']') text++;
+            text += strspn(text, " \t");
+        } else {
+            text = line;
+        }
+    }
+
+    static const struct {
+        const char* prefix;
+        uint8_t     type;
+        bool        on;
+        bool        dated;
+    } patterns[] = {
+        { "Initializing Circulation Pump Driver", REPLAY_COLD_BOOT,  false, false },
+        { "Restarting Circulation Pump Driver",   REPLAY_WARM_BOOT,  false, false },
+        { "Build date:",                          REPLAY_BUILD_DATE, false, true  },
+        { "RTC date:",                            REPLAY_RTC_DATE,   false, true  },
+        { "DCF77 date:",                          REPLAY_RTC_SET,    false, true  },
+        { "Pump is ON:",                          REPLAY_PUMP,       true,  true  },
+        { "Pump is OFF:",                         REPLAY_PUMP,       false, true  },
+        { "Switching to vacations mode",          REPLAY_MODE,       true,  false },
+        { "Switching to work week mode",          REPLAY_MODE,       false, false },
+    };
+
+    for (const auto& pattern : patterns) {
+        size_t prefix_length = strlen(pattern.prefix);
+        if (strncmp(text, pattern.prefix, prefix_length)) continue;
+        if (!pattern.dated) {
+            addEvent(pattern.type, pattern.on, DateTime::EPOCH_ERROR);
+            return;
+        }
+        uint32_t local = parseDisplayDateTime(text + prefix_length + strspn(text + prefix_length, " "));
+        if (local == DateTime::EPOCH_ERROR) return;
+        // Build date is compared by firmware in local time
+        addEvent(pattern.type, pattern.on, (pattern.type == REPLAY_BUILD_DATE) ? local : toUtc(local));
+        return;
+    }
+}
+
+bool Replay::load(FILE* in)
+{
+    char line[256];
+    while (fgets(line, sizeof(line), in)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        addLine(line);
+    }
+    return !ferror(in);
+}
+
+uint32_t Replay::getFirstTime() const
+{
+    for (const auto& event : events) {
+        if (event.type != REPLAY_BUILD_DATE && event.time != DateTime::EPOCH_ERROR) return event.time;
+    }
+    return DateTime::EPOCH_ERROR;
+}
+
+uint32_t Replay::getLastTime() const
+{
+    return last_time;
+}
+
+// ========================================================================================================= Matching
+
+bool Replay::nextTransition()
+{
+    while (next < events.size() && events[next].type != REPLAY_PUMP) next++;
+    return next < events.size();
+}
+
+void Replay::startMatching(uint32_t tolerance_s, uint32_t from_time)
+{
+    next = 0;
+    tolerance = tolerance_s;
+    from = from_time;
+    matched = 0;
+    diverged = false;
+    nextTransition();
+}
+
+bool Replay::diverge(const replay_event_t* expected, uint32_t simulated_time, bool simulated_on)
+{
+    if (diverged) return false;
+    diverged = true;
+    divergence.line = expected ? expected->line : 0;
+    divergence.expected_time = expected ? expected->time : DateTime::EPOCH_ERROR;
+    divergence.expected_on = expected ? expected->on : false;
+    divergence.simulated_time = simulated_time;
+    divergence.simulated_on = simulated_on;
+    return false;
+}
+
+bool Replay::matchTransition(uint32_t time, bool on)
+{
+    if (diverged) return false;
+    // Before or after the capture
+    if (time < from || last_time == DateTime::EPOCH_ERROR || time > last_time + tolerance) return true;
+
+    if (next == events.size()) return diverge(NULL, time, on);
+
+    const replay_event_t& expected = events[next];
+    uint32_t difference = (time > expected.time) ? time - expected.time : expected.time - time;
+    if (expected.on != on || difference > tolerance) return diverge(&expected, time, on);
+
+    matched++;
+    next++;
+    nextTransition();
+    return true;
+}
+
+bool Replay::matchUntil(uint32_t time)
+{
+    if (diverged) return false;
+    if (next < events.size() && events[next].time + tolerance < time) {
+        return diverge(&events[next], DateTime::EPOCH_ERROR, false);
+    }
+    return true;
+}
@@ -0,0 +1,86 @@
+#pragma once
+/**
+ * Serial capture of a field unit for replay through the firmware.
+ * Lines printed by the firmware (boot messages, build and RTC dates, DCF77 corrections, pump transitions, mode
+ * changes) become events with UTC time. Device times are local, in the repeated hour at the end of DST the later
+ * time is taken when the earlier one would go back. Lines may start with host timestamp "[YYYY-MM-DD HH:MM:SS]"
+ * (local, with optional fraction), which gives time to lines without date. Without it mode change gets the time of
+ * the pump state printed after it, other lines the time of the previous event.
+ * Simulated pump transitions are matched against captured ones in order, the first mismatch is kept.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+typedef enum
+{
+    REPLAY_COLD_BOOT,       ///< "Initializing..."
+    REPLAY_WARM_BOOT,       ///< "Restarting..."
+    REPLAY_BUILD_DATE,
+    REPLAY_RTC_DATE,
+    REPLAY_RTC_SET,         ///< "DCF77 date:", time: RTC after correction
+    REPLAY_PUMP,            ///< on: pump state
+    REPLAY_MODE,            ///< on: vacations mode
+} replay_event_type_t;
+
+typedef struct
+{
+    uint8_t  type;
+    bool     on;
+    uint32_t line;          ///< In the capture, from 1
+    uint32_t time;          ///< UTC, build date is local
+} replay_event_t;
+
+typedef struct
+{
+    uint32_t line;          ///< Captured line of expected transition, 0 if simulation made an extra one
+    uint32_t expected_time;
+    bool     expected_on;
+    uint32_t simulated_time;    ///< EPOCH_ERROR if simulation missed the expected transition
+    bool     simulated_on;
+} replay_divergence_t;
+
+class Replay
+{
+public:
+    Replay();
+
+    bool load(FILE* in);
+    void addLine(const char* line);
+    const std::vector<replay_event_t>& getEvents() const { return events; }
+    uint32_t getLines() const { return lines; }
+    // Events with time, EPOCH_ERROR if none
+    uint32_t getFirstTime() const;
+    uint32_t getLastTime() const;
+
+    // Transitions off by more than tolerance are divergent, simulated ones before "from" are ignored
+    void startMatching(uint32_t tolerance_s, uint32_t from);
+    // Simulated transition, returns false on divergence
+    bool matchTransition(uint32_t time, bool on);
+    // Simulation ran till "time", returns false if captured transition was missed
+    bool matchUntil(uint32_t time);
+    uint32_t getMatched() const { return matched; }
+    const replay_divergence_t* getDivergence() const { return diverged ? &divergence : 0; }
+
+    // Parses date printed by DisplayDateTime(): "2017-Oct-29, Sun, 2:30:0", returns local epoch
+    static uint32_t parseDisplayDateTime(const char* str);
+
+private:
+    std::vector<replay_event_t> events;
+    uint32_t lines;
+    uint32_t last_time;     ///< UTC of the last event with time
+    uint32_t host_time;     ///< UTC of the current line host timestamp
+    size_t   pending_mode;  ///< Mode change waiting for time of the next pump transition
+
+    size_t              next;   ///< Next captured transition
+    uint32_t            tolerance;
+    uint32_t            from;
+    uint32_t            matched;
+    bool                diverged;
+    replay_divergence_t divergence;
+
+    uint32_t toUtc(uint32_t local) const;
+    void addEvent(uint8_t type, bool on, uint32_t time);
+    bool nextTransition();
+    bool diverge(const replay_event_t* expected, uint32_t simulated_time, bool simulated_on);
+};
@@ -0,0 +1,197 @@
+#include "RtcCalibration.h"
+#include "DS3231Drv.h"
+#include "DS3231Emu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+
+template <class Drv>
+bool RtcCalibration<Drv>::waitForSecond(const rtc_reference_t* reference, uint32_t* out_epoch, uint64_t* out_reference_us)
+{
+    dt_date_t d;
+    dt_time_t t;
+
+    if (!Drv::getDateTime(&d, &t)) return false;
+    uint32_t start = DateTime::getEpochFromDateTime(&d, &t);
+    uint64_t before = reference->now_us();
+
+    for (uint32_t polls = 0; polls < 2000 / POLL_MS; polls++) {
+        reference->sleep_ms(POLL_MS);
+        uint64_t now = reference->now_us();
+        if (!Drv::getDateTime(&d, &t)) return false;
+        uint32_t epoch = DateTime::getEpochFromDateTime(&d, &t);
+        if (epoch != start) {
+            // Edge happened between previous and this read
+            *out_epoch = epoch;
+            *out_reference_us = (before + now) / 2;
+            return true;
+        }
+        before = now;
+    }
+    return false;
+}
+
+template <class Drv>
+bool RtcCalibration<Drv>::measure(const rtc_reference_t* reference, uint32_t duration_s, rtc_calibration_t* result,
+                                  bool verbose)
+{
+    uint32_t start_epoch, end_epoch;
+    uint64_t start_us, end_us;
+    int16_t temperature;
+
+    if (!Drv::readAgingOffset(&result->aging_offset) || !Drv::readTemperature(&temperature)) return false;
+    result->temperature_min = result->temperature_max = temperature;
+
+    if (!waitForSecond(reference, &start_epoch, &start_us)) return false;
+
+    // Stop 2s before the end, so the final edge is searched by polling
+    for (uint32_t elapsed = 0; elapsed + 2 < duration_s; ) {
+        uint32_t step = duration_s - 2 - elapsed;
+        if (step > LOG_PERIOD_S) step = LOG_PERIOD_S;
+        reference->sleep_ms(step * 1000);
+        elapsed += step;
+
+        if (!Drv::readTemperature(&temperature)) return false;
+        if (temperature < result->temperature_min) result->temperature_min = temperature;
+        if (temperature > result->temperature_max) result->temperature_max = temperature;
+        if (verbose) printf("%6us  temperature %5.2fC\n", elapsed, temperature / 4.0);
+    }
+
+    if (!waitForSecond(reference, &end_epoch, &end_us)) return false;
+
+    result->rtc_us = static_cast<int64_t>(end_epoch - start_epoch) * 1000000;
+    result->reference_us = static_cast<int64_t>(end_us - start_us);
+    if (result->reference_us <= 0) return false;
+    result->drift_ppb = static_cast<int32_t>( (result->rtc_us - result->reference_us) * 1000000000 / result->reference_us );
+    result->new_aging_offset = Drv::computeAgingOffset(result->aging_offset, result->drift_ppb);
+    return true;
+}
+
+template <class Drv>
+bool RtcCalibration<Drv>::apply(const rtc_calibration_t* result)
+{
+    return Drv::writeAgingOffset(result->new_aging_offset);
+}
+
+template class RtcCalibration< DS3231DrvT<TwiAsyncBus> >;
+#if defined(__linux__)
+template class RtcCalibration< DS3231DrvT<LinuxI2cBus> >;
+#endif
+
+// ========================================================================================================= Command
+
+static uint64_t systemNowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::system_clock::now().time_since_epoch() ).count();
+}
+
+static void systemSleepMs(uint32_t ms)
+{
+    std::this_thread::sleep_for( std::chrono::milliseconds(ms) );
+}
+
+// Simulated RTC: reference is the model time, the RTC runs with configured drift
+static DS3231Emu sim_rtc;
+
+static uint64_t simNowUs()
+{
+    return sim_rtc.getUptimeMs() * 1000;
+}
+
+static void simSleepMs(uint32_t ms)
+{
+    sim_rtc.advance(ms);
+}
+
+template <class Drv>
+static int calibrate(const rtc_reference_t* reference, uint32_t duration_s, bool write)
+{
+    rtc_calibration_t result;
+
+    if (!Drv::begin()) {
+        printf("RTC not available\n");
+        return 1;
+    }
+    printf("Measuring RTC drift for %u s...\n", duration_s);
+    if (!RtcCalibration<Drv>::measure(reference, duration_s, &result, true)) {
+        printf("Measurement failed\n");
+        return 1;
+    }
+
+    printf("RTC elapsed:       %lld us\n", static_cast<long long>(result.rtc_us));
+    printf("Reference elapsed: %lld us\n", static_cast<long long>(result.reference_us));
+    printf("Drift:             %+.3f ppm (%+.1f s/year)\n", result.drift_ppb / 1000.0, result.drift_ppb * 31.536e-3);
+    printf("Temperature:       %.2f..%.2fC\n", result.temperature_min / 4.0, result.temperature_max / 4.0);
+    printf("Aging offset:      %d -> %d\n", result.aging_offset, result.new_aging_offset);
+
+    if (write) {
+        if (!RtcCalibration<Drv>::apply(&result)) {
+            printf("Aging offset write failed\n");
+            return 1;
+        }
+        printf("Aging offset written\n");
+    }
+    return 0;
+}
+
+/**
+ * calibrate [--hours N] [--write] [--device /dev/i2c-N]   RTC on Linux I2C adapter against system clock
+ * calibrate --sim-drift PPB [--hours N] [--write]         Simulated RTC
+ */
+int run_calibration(int argc, char* argv[])
+{
+    uint32_t duration_s = 6 * 3600;
+    bool write = false;
+    bool sim = false;
+    int32_t sim_drift_ppb = 0;
+    const char* device = NULL;
+
+    for (int i = 0; i < argc; i++) {
+        if (!strcmp(argv[i], "--hours") && i + 1 < argc) {
+            duration_s = static_cast<uint32_t>(atof(argv[++i]) * 3600);
+        } else if (!strcmp(argv[i], "--write")) {
+            write = true;
+        } else if (!strcmp(argv[i], "--device") && i + 1 < argc) {
+            device = argv[++i];
+        } else if (!strcmp(argv[i], "--sim-drift") && i + 1 < argc) {
+            sim = true;
+            sim_drift_ppb = atoi(argv[++i]);
+        } else {
+            printf("Unknown option: %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (duration_s < 60) duration_s = 60;
+
+    if (sim) {
+        static const rtc_reference_t reference = { simNowUs, simSleepMs };
+        sim_rtc.setDrift(sim_drift_ppb);
+        TwiFake::detachAll();
+        TwiFake::attach(DS3231Emu::ADDRESS, &sim_rtc);
+        int result = calibrate< DS3231DrvT<TwiAsyncBus> >(&reference, duration_s, write);
+        if (write && !result) {
+            // Check the new offset over the same period
+            result = calibrate< DS3231DrvT<TwiAsyncBus> >(&reference, duration_s, false);
+        }
+        return result;
+    }
+
+#if defined(__linux__)
+    static const rtc_reference_t reference = { systemNowUs, systemSleepMs };
+    if (device && !LinuxI2cBus::open(device)) {
+        printf("Cannot open %s\n", device);
+        return 1;
+    }
+    return calibrate< DS3231DrvT<LinuxI2cBus> >(&reference, duration_s, write);
+#else
+    (void)device;
+    (void)systemNowUs;
+    (void)systemSleepMs;
+    printf("Only --sim-drift is supported on this platform\n");
+    return 2;
+#endif
+}
@@ -0,0 +1,43 @@
+#pragma once
+/**
+ * DS3231 drift measurement against reference clock and aging offset trimming.
+ * RTC seconds edge is located by polling at the start and at the end of measurement, so the resolution is
+ * given by polling period rather than by 1s RTC resolution: 6 hours with 1ms polling is below 0.1ppm.
+ */
+#include <stdint.h>
+
+typedef struct
+{
+    uint64_t (*now_us)();               ///< Reference clock, e.g. NTP disciplined system clock
+    void     (*sleep_ms)(uint32_t ms);
+} rtc_reference_t;
+
+typedef struct
+{
+    int64_t  rtc_us;                    ///< RTC time elapsed between seconds edges
+    int64_t  reference_us;              ///< Reference time elapsed between the same edges
+    int32_t  drift_ppb;                 ///< Positive when RTC runs fast
+    int16_t  temperature_min;           ///< In 1/4 of Celsius degree
+    int16_t  temperature_max;
+    int8_t   aging_offset;              ///< Aging offset during measurement
+    int8_t   new_aging_offset;
+} rtc_calibration_t;
+
+template <class Drv>
+class RtcCalibration
+{
+public:
+    static const uint32_t POLL_MS = 1;
+    static const uint32_t LOG_PERIOD_S = 600;
+
+    // Blocks for duration_s, progress is logged every LOG_PERIOD_S if verbose
+    static bool measure(const rtc_reference_t* reference, uint32_t duration_s, rtc_calibration_t* result,
+                        bool verbose = false);
+    static bool apply(const rtc_calibration_t* result);
+
+private:
+    static bool waitForSecond(const rtc_reference_t* reference, uint32_t* out_epoch, uint64_t* out_reference_us);
+};
+
+// "calibrate" command of the host application
+int run_calibration(int argc, char* argv[]);
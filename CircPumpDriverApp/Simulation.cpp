@@ -1,10 +1,25 @@
-﻿#include "DateTime.h" /* Due to some *hacks* this file must be included first */
+#include "DateTime.h" /* Due to some *hacks* this file must be included first */
 #include "CircShedule.h"
+#include "FlashStore.h"
+#include "Trace.h"
+#include "Replay.h"
+#include "PipeModel.h"
+#include "Dcf77Signal.h"
 
 #include <stdint.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <iostream>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <thread>
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
 
 
 #define SIMULATION
@@ -19,108 +34,172 @@
 
 #define P2_3 2
 #define PUSH2 3
+#define P2_4 4
+#define P2_5 5
+#define P1_4 6
+#define P1_5 7
+#define P2_0 8
+#define FALLING 1
+#define RISING 2
+
+#define NOINIT
+
+// Optional binary trace of the run
+static TraceWriter trace;
+static uint64_t getSimTimeMs();
+// Firmware output is not printed
+static bool sim_quiet;
+// Called with every line printed by firmware
+static void (*sim_line_hook)(const std::string& line);
 
 static const char* pins_names[] = {
     "GREEN LED",
     "RED LED",
     "PUMP RELAY",
-    "MODE BUTTON"
+    "MODE BUTTON",
+    "PUMP RELAY 2",
+    "DEMAND INPUT",
+    "RETURN TEMP",
+    "RETURN TEMP 2",
+    "DCF77 INPUT"
 };
 
 #define pinMode(PUMP_PIN, OUTPUT)
 
 
+// CPU time is the true one, RTC may be off
+static uint64_t sim_true_ms;
+uint32_t millis() { return static_cast<uint32_t>(sim_true_ms); }
+
+// Level and rising edges of every pin
+static uint8_t  pins_levels[sizeof(pins_names) / sizeof(*pins_names)];
+static unsigned pins_rises[sizeof(pins_names) / sizeof(*pins_names)];
+
 void digitalWrite(uint8_t pin, uint8_t val)
 {
-    if (!pin) return;
+    if (trace.isOpen()) trace.pin(sim_true_ms, pin, val);
+    if (pin < sizeof(pins_levels) / sizeof(*pins_levels)) {
+        if (val && !pins_levels[pin]) pins_rises[pin]++;
+        pins_levels[pin] = val;
+    }
+    if (!pin || sim_quiet) return;
     const char* pin_name = (pin < sizeof(pins_names) / sizeof(*pins_names)) ? pins_names[pin] : "unknown";
-    std::cout << "Pin: " << pin_name << " set to " << (val ? "HIGH" : "LOW") << std::endl;
+    std::cout << "Pin: " << pin_name << " set to " << (val ? "HIGH" : "LOW") << '\n';
+}
+// Mode button is active low, in continuous mode it is held since power up
+static bool mode_button_pressed = true;
+// DCF77 receiver output, HIGH in pulse
+static bool sim_dcf77_level;
+int digitalRead(uint8_t pin)
+{
+    if (pin == P2_0) return sim_dcf77_level ? HIGH : LOW;
+    return mode_button_pressed ? LOW : HIGH;
+}
+// Return pipe NTC of every zone, fitted by the pipe model
+static bool sim_return_ntc;
+static uint16_t readPipeAdc(uint8_t pin);
+uint16_t analogRead(uint8_t pin) { return sim_return_ntc ? readPipeAdc(pin) : 1023; }
+struct circ_thermal_config_s;
+static const circ_thermal_config_s& getSimThermalConfig();
+#define THERMAL_CONFIG getSimThermalConfig()
+
+// Pin interrupts are called by the simulation at the edge time
+static void (*pin_isrs[sizeof(pins_names) / sizeof(*pins_names)])();
+void attachInterrupt(uint8_t pin, void (*isr)(), int)
+{
+    if (pin < sizeof(pin_isrs) / sizeof(*pin_isrs)) pin_isrs[pin] = isr;
+}
+static void raiseEdge(uint8_t pin)
+{
+    if (pin < sizeof(pin_isrs) / sizeof(*pin_isrs) && pin_isrs[pin]) pin_isrs[pin]();
 }
-int digitalRead(uint8_t) { return LOW; }
 
 
 class
 {
 public:
     void begin(int) {}
-    int print(int i) { return printf("%d",i); }
-    int print(const char* s) { return printf("%s",s); }
-    int println(int i) { return printf("%d\n", i); }
-    int println(const char* s) { return printf("%s\n", s); }
+    int print(int i) { char s[12]; snprintf(s, sizeof(s), "%d", i); return print(s); }
+    int print(const char* s) { traceText(s, false); return sim_quiet ? 0 : printf("%s",s); }
+    int println(int i) { char s[12]; snprintf(s, sizeof(s), "%d", i); return println(s); }
+    int println(const char* s) { traceText(s, true); return sim_quiet ? 0 : printf("%s\n", s); }
+    int available() { return 0; }
+    int read() { return -1; }
 
-} Serial;
+private:
+    std::string line;
 
-uint32_t rtc_time = 0;
+    // Whole lines are traced
+    void traceText(const char* s, bool end)
+    {
+        if (!trace.isOpen() && !sim_line_hook) return;
+        line += s;
+        if (!end) return;
+        if (trace.isOpen()) trace.log(sim_true_ms, line.data(), line.size());
+        if (sim_line_hook) sim_line_hook(line);
+        line.clear();
+    }
+} Serial;
 
-dt_date_t alarm_date;
-dt_time_t alarm_time;
+// ========================================================================================================= RTC
+#include "DS3231Emu.h"
+static DS3231Emu rtc;
 
-struct RTCDateTime
+// True time the alarm fired at in the last "ms"
+static uint64_t getTrueAlarmMs(uint8_t alarm, uint32_t ms)
 {
-    uint16_t year;
-    uint8_t month;
-    uint8_t day;
-    uint8_t hour;
-    uint8_t minute;
-    uint8_t second;
-    uint8_t dayOfWeek;
-    uint32_t unixtime;
-};
+    int64_t rtc_offset = static_cast<int64_t>(getSimTimeMs() - sim_true_ms);
+    uint64_t alarm_ms = static_cast<uint64_t>( static_cast<int64_t>(rtc.getAlarmDateTime(alarm)) * 1000 - rtc_offset );
+    return std::min(std::max(alarm_ms, sim_true_ms - ms), sim_true_ms);
+}
 
-static RTCDateTime dt;
-class DS3231
+// Simulated time passes only here
+static void advancePipes(uint32_t ms);
+static void advanceRtc(uint32_t ms)
 {
-public:
-    void begin() {}
-    void clearAlarm1() {}
-    void clearAlarm2() {}
-    void armAlarm1(bool) {}
-    void armAlarm2(bool) {}
-
-
-    void setDateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second)
-    {
-        rtc_time = DateTime::getEpochFromDateTime(year, month, day, hour, minute, second);
-    }
-    bool isAlarm1()
-    {
-        dt_date_t d;
-        dt_time_t t;
-
-        DateTime::setDateTimeFromEpoch(rtc_time, &d, &t);
-
-        return (alarm_date.day == d.day ) && 
-               ( alarm_time.hour == t.hour ) &&
-               ( alarm_time.minute == t.minute ) &&
-               ( alarm_time.second == t.second );
-    }
-    void setAlarm1(uint8_t dydw, uint8_t hour, uint8_t minute, uint8_t second, int mode, bool armed=true)
-    {
-        alarm_date.day = dydw;
-        alarm_time.hour = hour;
-        alarm_time.minute = minute;
-        alarm_time.second = second;
+    advancePipes(ms);
+    sim_true_ms += ms;
+    uint8_t flags = rtc.getAlarmFlags();
+    rtc.advance(ms);
+    uint8_t raised = rtc.getAlarmFlags() & ~flags;
+    if (raised && trace.isOpen()) {
+        if (raised & 1) trace.alarm(getTrueAlarmMs(1, ms), 1);
+        if (raised & 2) trace.alarm(getTrueAlarmMs(2, ms), 2);
     }
+}
 
-    struct RTCDateTime getDateTime()
-    {
-        dt_date_t d;
-        dt_time_t t;
+// Pending edge of the demand input, raised in the middle of delay() it falls in
+static uint64_t sim_edge_ms = UINT64_MAX;
+static void raiseDemandEdge();
+// DCF77 signal in true time, edges are raised by delay() as well
+static bool sim_dcf77;
+static const dcf77_noise_t* sim_dcf77_noise;
+static Dcf77Signal sim_dcf77_signal;
 
-        DateTime::setDateTimeFromEpoch(rtc_time, &d, &t);
-        dt.year = d.year;
-        dt.month = d.month;
-        dt.day = d.day;
-        dt.hour = t.hour;
-        dt.minute = t.minute;
-        dt.second = t.second;
+void delay(int ms)
+{
+    for (uint64_t left = ms; ; ) {
+        uint64_t demand_in = UINT64_MAX;
+        uint64_t dcf77_in = UINT64_MAX;
+        if (sim_edge_ms != UINT64_MAX) demand_in = (sim_edge_ms > getSimTimeMs()) ? sim_edge_ms - getSimTimeMs() : 0;
+        if (sim_dcf77) dcf77_in = std::max(sim_dcf77_signal.getNextEdgeMs(), sim_true_ms) - sim_true_ms;
 
-        return dt;
+        const uint64_t in = std::min(demand_in, dcf77_in);
+        if (in >= left) {
+            advanceRtc( static_cast<uint32_t>(left) );
+            return;
+        }
+        if (in) advanceRtc( static_cast<uint32_t>(in) );
+        left -= in;
+        if (in == demand_in) {
+            sim_edge_ms = UINT64_MAX;
+            raiseDemandEdge();
+        } else {
+            sim_dcf77_level = sim_dcf77_signal.popEdge();
+            raiseEdge(P2_0);
+        }
     }
-    
-};
-
-void delay(int) { }
+}
 
 /*
 #define PRINT(_s_)                    do { std::cout << _s_; } while(0)
@@ -154,58 +233,851 @@ int TwoWire::available()
 extern "C" {
 #include <twi.h>
 }
-/*
-* Function twi_writeTo
-* Desc     attempts to become twi bus master and write a
-*          series of bytes to a device on the bus
-* Input    address: 7bit i2c device address
-*          data: pointer to byte array
-*          length: number of bytes in array
-*          wait: boolean indicating to wait for write or not
-* Output   0 .. success
-*          1 .. length to long for buffer
-*          2 .. address send, NACK received
-*          3 .. data send, NACK received
-*          4 .. other twi error (lost bus arbitration, bus error, ..)
-*/
-uint8_t twi_writeTo(uint8_t address, uint8_t* data, uint8_t length, uint8_t wait, uint8_t sendStop)
+wdtctl_reg_t WDTCTL;
+// Firmware sets RTC to its build date if RTC is behind, discrete-event mode starts at other dates
+static char sim_build_date[16] = __DATE__;
+static char sim_build_time[16] = __TIME__;
+#define BUILD_DATE sim_build_date
+#define BUILD_TIME sim_build_time
+// ========================================================================================================= Base program
+#include <CircPumpDriver.ino>
+
+
+
+// I2C fault injected every N loop() calls, 0 - none
+#define SIM_FAULT_PERIOD    0
+
+void start_simulation()
 {
-    return 0;
+    //rtc.setDateTime( DateTime::getEpochFromDateTime(2017, 3, 26, 0, 50, 0) );
+    rtc.setDateTime( DateTime::getEpochFromDateTime(2017, 10, 29, 0, 50, 0) );
+    TwiFake::attach(DS3231Emu::ADDRESS, &rtc);
+
+    setup();
+    for (unsigned i = 1; ; i++)
+    {
+#if SIM_FAULT_PERIOD
+        if (!(i % SIM_FAULT_PERIOD)) {
+            // Alternate address glitch and slave holding SDA low
+            if ((i / SIM_FAULT_PERIOD) & 1) TwiFake::failNext(1);
+            else                            TwiFake::stickBus();
+        }
+#endif
+        // Every loop() ends with delay(TICK_TIME)
+        loop();
+    }
+
 }
 
-/*
-* Function twi_readFrom
-* Desc     attempts to become twi bus master and read a
-*          series of bytes from a device on the bus
-* Input    address: 7bit i2c device address
-*          data: pointer to byte array
-*          length: number of bytes to read into array
-* Output   number of bytes read
-*/
-uint8_t twi_readFrom(uint8_t address, uint8_t* data, uint8_t length, uint8_t sendStop)
+// ========================================================================================================= Pipes
+/**
+ * Heat loss of the loop of every zone, driven by its relay. Reported per zone: relay on time and cycles, and share
+ * of on-window time with the farthest tap hot, which shows whether skipped pulses leave the loop cold.
+ */
+static const pipe_config_t SIM_PIPE_CONFIG = {
+    55.0,           // Supply
+    20.0,           // Ambient
+    90.0,           // Loop time
+    45 * 60.0       // Cooling time
+};
+static const double SIM_TAP_HOT_TEMP = 40.0;
+
+static bool sim_pipes;
+static PipeModel sim_pipe_models[CIRC_ZONES];
+// Sensors as configured in firmware unless pipes are simulated
+static circ_thermal_config_t sim_thermal_config = thermal_config;
+static const circ_thermal_config_t& getSimThermalConfig() { return sim_thermal_config; }
+
+static struct
+{
+    uint64_t relay_on_ms;
+    unsigned relay_rises;           ///< Of the relay pin before the run
+    uint64_t window_ms;             ///< In on-window of the schedule
+    uint64_t window_hot_ms;         ///< In on-window with tap hot
+} sim_pipe_stats[CIRC_ZONES];
+
+static void startPipes()
 {
-    return length;
+    memset(sim_pipe_stats, 0, sizeof(sim_pipe_stats));
+    for (uint8_t zone = 0; zone < CIRC_ZONES; zone++) {
+        pins_levels[PUMP_PINS[zone]] = isPumpRelayOn(zone) ? HIGH : LOW;
+        sim_pipe_stats[zone].relay_rises = pins_rises[PUMP_PINS[zone]];
+    }
+}
+
+static uint16_t readPipeAdc(uint8_t pin)
+{
+    for (uint8_t zone = 0; zone < CIRC_ZONES; zone++) {
+        if (RETURN_TEMP_PINS[zone] == pin) return sim_pipe_models[zone].getReturnAdc();
+    }
+    return 1023;
+}
+
+// One second steps, schedule window is taken at the start of each
+static void advancePipes(uint32_t ms)
+{
+    if (!sim_pipes) return;
+    for (uint64_t time_ms = getSimTimeMs(); ms; ) {
+        const uint32_t step = std::min<uint32_t>(ms, 1000);
+        const uint32_t local = DateTime::getLocalDateTimeFromUtc( static_cast<uint32_t>(time_ms / 1000) );
+        for (uint8_t zone = 0; zone < CIRC_ZONES; zone++) {
+            const bool relay_on = pins_levels[PUMP_PINS[zone]] != LOW;
+            sim_pipe_models[zone].advance(step, relay_on);
+            if (relay_on) sim_pipe_stats[zone].relay_on_ms += step;
+            if (CircShedule::getNextOnTime(getZoneScheduleTable(zone), local) == local) {
+                sim_pipe_stats[zone].window_ms += step;
+                if (sim_pipe_models[zone].getTapTemp() >= SIM_TAP_HOT_TEMP) sim_pipe_stats[zone].window_hot_ms += step;
+            }
+        }
+        time_ms += step;
+        ms -= step;
+    }
 }
-void twi_init() {}
-int WDTCTL;
-// ========================================================================================================= Base program
-#include <CircPumpDriver.ino>
 
+static bool isAnyPumpRelayOn()
+{
+    for (uint8_t zone = 0; zone < CIRC_ZONES; zone++) {
+        if (pins_levels[PUMP_PINS[zone]] != LOW) return true;
+    }
+    return false;
+}
+
+static void reportPipes()
+{
+    for (uint8_t zone = 0; zone < CIRC_ZONES; zone++) {
+        const auto* stats = &sim_pipe_stats[zone];
+        printf("Zone %u: relay on %.2f h, %u cycles, tap hot %.1f%% of on-windows, return %.1f C\n", zone + 1,
+               stats->relay_on_ms / 3600000.0, pins_rises[PUMP_PINS[zone]] - stats->relay_rises,
+               stats->window_ms ? 100.0 * stats->window_hot_ms / stats->window_ms : 0.0,
+               sim_pipe_models[zone].getReturnTemp());
+    }
+}
 
+// ========================================================================================================= Discrete-event mode
+/**
+ * Virtual time jumps straight to the next pending pump event, button press or the end, only ticks around them
+ * are run by loop(). Skipped ticks are still counted, so periodic tasks keep their phase.
+ */
+static const uint32_t SIM_JUMP_MARGIN_MS = 2 * TICK_TIME;
+static const uint32_t SIM_EVENT_WINDOW_MS = RTC_READ_TICKS * TICK_TIME;
 
-void start_simulation()
+static unsigned sim_loops;
+
+static uint64_t getSimTimeMs()
+{
+    return static_cast<uint64_t>(rtc.getDateTime()) * 1000 + rtc.getSubSecondMs();
+}
+
+static void skipTo(uint64_t time_ms)
+{
+    uint64_t now = getSimTimeMs();
+    if (time_ms <= now) return;
+
+    uint32_t skipped = static_cast<uint32_t>( (time_ms - now) / TICK_TIME );
+    advanceRtc(skipped * TICK_TIME);
+    ctx.ticks += skipped;
+}
+
+static void runUntil(uint64_t time_ms)
+{
+    while (getSimTimeMs() < time_ms) {
+        loop();
+        sim_loops++;
+    }
+}
+
+static void pressModeButton()
+{
+    mode_button_pressed = true;
+    raiseEdge(MODE_BTN_PIN);
+    runUntil( getSimTimeMs() + (MODE_CHANGE_TICKS + 1) * TICK_TIME );
+    mode_button_pressed = false;
+    runUntil( getSimTimeMs() + TICK_TIME );
+}
+
+// Demand edges of the run in ms of RTC time, see injectDemand()
+static std::vector<uint64_t> sim_demands;
+// Times of the single I2C address NACK, it hits the next RTC access (usually snapshot read)
+static std::vector<uint32_t> sim_faults;
+
+static struct
+{
+    unsigned edges;
+    unsigned bursts;                ///< Edges which started a burst, the others came in burst or cooldown
+    uint64_t sum_burst_ms;          ///< Edge to burst taken over by loop()
+    uint64_t max_burst_ms;
+} sim_demand_stats;
+
+static uint64_t sim_demand_edge_ms;
+
+static void raiseDemandEdge()
+{
+    sim_demand_edge_ms = getSimTimeMs();
+    sim_demand_stats.edges++;
+    raiseEdge(DEMAND_PIN);
+    if (!demand_started) printf("Demand ignored, burst or cooldown\n");
+}
+
+/**
+ * Demand edge at any millisecond, it comes while loop() waits in delay() as on the device.
+ * Relays are switched by the ISR run right at the edge, so only latency till loop() takes the burst over is reported.
+ */
+static void injectDemand(uint64_t edge_ms)
+{
+    sim_edge_ms = std::max(edge_ms, getSimTimeMs());
+    while (sim_edge_ms != UINT64_MAX) {
+        loop();
+        sim_loops++;
+    }
+    if (!demand_started) return;
+
+    const uint64_t edge = sim_demand_edge_ms;
+    while (demand_started) {
+        loop();
+        sim_loops++;
+    }
+    // Burst is taken over at the start of loop(), before its delay()
+    uint64_t burst_ms = getSimTimeMs() - TICK_TIME - edge;
+
+    sim_demand_stats.bursts++;
+    sim_demand_stats.sum_burst_ms += burst_ms;
+    sim_demand_stats.max_burst_ms = std::max(sim_demand_stats.max_burst_ms, burst_ms);
+    printf("Demand latency: burst %llu ms\n", static_cast<unsigned long long>(burst_ms));
+}
+
+// "YYYY-MM-DD" or "YYYY-MM-DD HH:MM[:SS]" in local time, returns RTC (UTC) time
+static uint32_t parseLocalDateTime(const char* str)
 {
-    //rtc_time = DateTime::getEpochFromDateTime(2017, 3, 26, 0, 50, 0);
-    rtc_time = DateTime::getEpochFromDateTime(2017, 10, 29, 0, 50, 0);
+    unsigned year, month, day, hour = 0, minute = 0, second = 0;
+    if ( sscanf(str, "%u-%u-%u%*[ T]%u:%u:%u", &year, &month, &day, &hour, &minute, &second) < 3 ) {
+        return DateTime::EPOCH_ERROR;
+    }
+    uint32_t local = DateTime::getEpochFromDateTime(year, month, day, hour, minute, second);
+    return (local == DateTime::EPOCH_ERROR) ? local : DateTime::getUtcDateTimeFromLocal(local);
+}
 
+static uint32_t sim_from;
+// Set to end runDiscrete() early
+static bool sim_stop;
+
+static void setBuildDate(uint32_t local)
+{
+    dt_date_t d;
+    dt_time_t t;
+    DateTime::setDateTimeFromEpoch(local, &d, &t);
+    snprintf(sim_build_date, sizeof(sim_build_date), "%s %u %u", DateTime::getMonthAbbrev(static_cast<DateTime::MONTHS>(d.month)),
+             d.day, d.year);
+    snprintf(sim_build_time, sizeof(sim_build_time), "%02u:%02u:%02u", t.hour, t.minute, t.second);
+}
+
+// RTC starts "rtc_offset" seconds off the true time
+static void startDiscrete(uint32_t from, int32_t rtc_offset = 0)
+{
+    setBuildDate( DateTime::getLocalDateTimeFromUtc(from) );
+    mode_button_pressed = false;
+    rtc.setDateTime(from + rtc_offset);
+    sim_true_ms = static_cast<uint64_t>(from) * 1000;
+    if (sim_dcf77) sim_dcf77_signal.begin(sim_true_ms, sim_dcf77_noise);
+    TwiFake::attach(DS3231Emu::ADDRESS, &rtc);
+    for (uint8_t zone = 0; zone < CIRC_ZONES; zone++) sim_pipe_models[zone].begin(&SIM_PIPE_CONFIG);
     setup();
-    while (true)
-    {
-        // 10 ticks per 1s
-        for (int i = 10; i; i--) {
-            loop();
+    startPipes();
+    sim_from = from;
+    sim_loops = 0;
+}
+
+// Runs from the current time, presses before it are skipped. Button is pressed "press_offset_ms" from press time.
+static void runDiscrete(uint32_t until, const std::vector<uint32_t>& presses, int32_t press_offset_ms = 0)
+{
+    size_t next_press = 0;
+    size_t next_demand = 0;
+    size_t next_fault = 0;
+    const uint64_t end_ms = static_cast<uint64_t>(until) * 1000;
+    auto pressTimeMs = [&](size_t i) { return static_cast<uint64_t>(presses[i]) * 1000 + press_offset_ms; };
+    while (next_press < presses.size() && pressTimeMs(next_press) < getSimTimeMs()) {
+        next_press++;
+    }
+    while (next_demand < sim_demands.size() && sim_demands[next_demand] < getSimTimeMs()) {
+        next_demand++;
+    }
+    while (next_fault < sim_faults.size() && static_cast<uint64_t>(sim_faults[next_fault]) * 1000 < getSimTimeMs()) {
+        next_fault++;
+    }
+
+    for (uint64_t now = getSimTimeMs(); now < end_ms && !sim_stop; now = getSimTimeMs()) {
+        uint64_t deadline = end_ms;
+        bool press = false;
+        bool demand = false;
+        bool fault = false;
+
+        const circ_event_t* event = getPendingEvent();
+        if (event && static_cast<uint64_t>(event->time) * 1000 < deadline) {
+            deadline = static_cast<uint64_t>(event->time) * 1000;
+        }
+        if (ctx.demand_until != DateTime::EPOCH_ERROR && static_cast<uint64_t>(ctx.demand_until) * 1000 < deadline) {
+            deadline = static_cast<uint64_t>(ctx.demand_until) * 1000;
         }
-        rtc_time++;
+        // Pulse may be stopped by return temperature at any pump check, DCF77 edges come every second
+        if ((sim_return_ntc && isAnyPumpRelayOn()) || sim_dcf77) deadline = now;
+        if (next_press < presses.size() && pressTimeMs(next_press) <= deadline) {
+            deadline = pressTimeMs(next_press);
+            press = true;
+        }
+        if (next_demand < sim_demands.size() && sim_demands[next_demand] <= deadline) {
+            deadline = sim_demands[next_demand];
+            press = false;
+            demand = true;
+        }
+        if (next_fault < sim_faults.size() && static_cast<uint64_t>(sim_faults[next_fault]) * 1000 <= deadline) {
+            deadline = static_cast<uint64_t>(sim_faults[next_fault]) * 1000;
+            press = demand = false;
+            fault = true;
+        }
+
+        // Demand input is enabled again by loop() after RTC read
+        const uint64_t margin = demand ? SIM_JUMP_MARGIN_MS + SIM_EVENT_WINDOW_MS : SIM_JUMP_MARGIN_MS;
+        if (deadline > now + margin) skipTo(deadline - margin);
+        if (press) {
+            runUntil(deadline);
+            pressModeButton();
+            next_press++;
+        } else if (demand) {
+            injectDemand(deadline);
+            next_demand++;
+        } else if (fault) {
+            runUntil(deadline);
+            TwiFake::failNext(1);
+            runUntil( getSimTimeMs() + SIM_EVENT_WINDOW_MS );
+            next_fault++;
+        } else if (deadline < end_ms) {
+            // Alarm is seen with the next RTC read
+            runUntil( (deadline > now ? deadline : now) + SIM_EVENT_WINDOW_MS );
+        } else {
+            skipTo(end_ms);
+            runUntil(end_ms);
+        }
+    }
+}
+
+static void reportDiscrete()
+{
+    printf("Simulated %.2f days with %u loop() calls\n", (rtc.getDateTime() - sim_from) / 86400.0, sim_loops);
+    if (sim_demand_stats.edges) {
+        printf("Demands: %u, bursts: %u, burst latency avg %llu ms, max %llu ms\n", sim_demand_stats.edges,
+               sim_demand_stats.bursts,
+               static_cast<unsigned long long>(sim_demand_stats.bursts ? sim_demand_stats.sum_burst_ms / sim_demand_stats.bursts : 0),
+               static_cast<unsigned long long>(sim_demand_stats.max_burst_ms));
+    }
+    if (sim_pipes) reportPipes();
+    if (!sim_faults.empty() || WDTCTL.resets) {
+        printf("I2C faults: %u, RTC errors: %u, resets: %u\n", static_cast<unsigned>(sim_faults.size()), ctx.rtc_errors,
+               WDTCTL.resets);
+    }
+    if (sim_dcf77) {
+        printf("DCF77 frames: %u, errors: %u, confirmed: %u, glitches: %u, RTC error %+.3f s\n", Dcf77::stats.frames,
+               Dcf77::stats.errors, Dcf77::stats.confirmed, Dcf77::stats.glitches,
+               (static_cast<int64_t>(getSimTimeMs()) - static_cast<int64_t>(sim_true_ms)) / 1000.0);
+    }
+    fflush(stdout);
+}
+
+// ========================================================================================================= Snapshots
+/**
+ * Device state between loop() calls: firmware context, warm restart RAM, DS3231 registers and oscillator,
+ * I2C statistics, flash data segments and pipe temperatures. RTC time is taken as the true one, DCF77 decoding
+ * starts again. Driver register shadow is not stored, it is rebuilt as after warm restart,
+ * learned table compaction in progress starts again and demands of the current bin not written to flash are lost.
+ * Structures are stored as they are in memory, so snapshot can be restored only by the same build.
+ */
+static const uint32_t SIM_SNAPSHOT_MAGIC = 0x53445043;     // "CPDS"
+static const uint16_t SIM_SNAPSHOT_VERSION = 4;
+
+typedef struct
+{
+    uint32_t            magic;
+    uint16_t            version;
+    uint16_t            size;
+    circ_context_t      ctx;
+    warm_state_s        warm;
+    ds3231_emu_state_t  rtc;
+    twi_async_stats_t   twi_stats;
+    uint8_t             flash[FlashStore::SEGMENTS][FlashStore::SEGMENT_SIZE];
+    PipeModel           pipes[CIRC_ZONES];
+} sim_snapshot_t;
+
+static bool takeSnapshot(sim_snapshot_t* snapshot)
+{
+    if (!TwiAsync::isIdle()) return false;
+
+    memset(snapshot, 0, sizeof(*snapshot));
+    snapshot->magic = SIM_SNAPSHOT_MAGIC;
+    snapshot->version = SIM_SNAPSHOT_VERSION;
+    snapshot->size = sizeof(*snapshot);
+    snapshot->ctx = ctx;
+    snapshot->warm = warm_state;
+    rtc.getState(&snapshot->rtc);
+    snapshot->twi_stats = TwiAsync::stats;
+    memcpy(snapshot->flash, FlashStore::storage, sizeof(snapshot->flash));
+    std::copy(sim_pipe_models, sim_pipe_models + CIRC_ZONES, snapshot->pipes);
+    return true;
+}
+
+static void restoreSnapshot(const sim_snapshot_t* snapshot)
+{
+    rtc.setState(&snapshot->rtc);
+    TwiFake::detachAll();
+    TwiFake::attach(DS3231Emu::ADDRESS, &rtc);
+    DS3231Drv::begin();
+    TwiAsync::stats = snapshot->twi_stats;
+
+    ctx = snapshot->ctx;
+    memcpy(FlashStore::storage, snapshot->flash, sizeof(snapshot->flash));
+    for (uint8_t zone = CIRC_ZONES; zone--; ) {
+        if (zone_tables[zone].learned) CircAdaptive::begin(zone_tables[zone].workweek, &adaptive_config);
+    }
+    warm_state = snapshot->warm;
+    sim_true_ms = getSimTimeMs();
+    Dcf77::begin();
+    if (sim_dcf77) sim_dcf77_signal.begin(sim_true_ms, sim_dcf77_noise);
+    std::copy(snapshot->pipes, snapshot->pipes + CIRC_ZONES, sim_pipe_models);
+    startPipes();
+    mode_button_pressed = false;
+    sim_from = rtc.getDateTime();
+    sim_loops = 0;
+}
+
+static bool saveSnapshot(const char* name, const sim_snapshot_t* snapshot)
+{
+    FILE* file = fopen(name, "wb");
+    if (!file) return false;
+    bool ok = fwrite(snapshot, sizeof(*snapshot), 1, file) == 1;
+    return (fclose(file) == 0) && ok;
+}
+
+static bool loadSnapshot(const char* name, sim_snapshot_t* snapshot)
+{
+    FILE* file = fopen(name, "rb");
+    if (!file) return false;
+    bool ok = fread(snapshot, sizeof(*snapshot), 1, file) == 1;
+    fclose(file);
+    return ok && snapshot->magic == SIM_SNAPSHOT_MAGIC && snapshot->version == SIM_SNAPSHOT_VERSION &&
+           snapshot->size == sizeof(*snapshot);
+}
+
+// Every branch starts from the snapshot, output goes to "<prefix>.<branch>.log"
+static int runBranches(const sim_snapshot_t* snapshot, uint32_t until, const std::vector< std::vector<uint32_t> >& branches,
+                       unsigned jobs, const char* prefix)
+{
+    char name[256];
+    int failed = 0;
+
+#if defined(__linux__)
+    // Firmware state is global, so branches run as processes
+    std::vector<pid_t> running;
+    for (size_t branch = 0; branch < branches.size() || !running.empty(); ) {
+        if (branch < branches.size() && running.size() < jobs) {
+            snprintf(name, sizeof(name), "%s.%u.log", prefix, static_cast<unsigned>(branch));
+            fflush(stdout);
+            pid_t pid = fork();
+            if (pid == 0) {
+                if (!freopen(name, "w", stdout)) _exit(1);
+                restoreSnapshot(snapshot);
+                runDiscrete(until, branches[branch]);
+                reportDiscrete();
+                _exit(0);
+            }
+            if (pid < 0) {
+                printf("Branch %u: fork failed\n", static_cast<unsigned>(branch));
+                failed++;
+            } else {
+                printf("Branch %u: %s\n", static_cast<unsigned>(branch), name);
+                running.push_back(pid);
+            }
+            branch++;
+            continue;
+        }
+        int status;
+        pid_t pid = wait(&status);
+        if (pid < 0) break;
+        running.erase(std::remove(running.begin(), running.end(), pid), running.end());
+        if (!WIFEXITED(status) || WEXITSTATUS(status)) failed++;
+    }
+#else
+    (void)jobs;
+    (void)prefix;
+    (void)name;
+    for (size_t branch = 0; branch < branches.size(); branch++) {
+        printf("======== Branch %u\n", static_cast<unsigned>(branch));
+        restoreSnapshot(snapshot);
+        runDiscrete(until, branches[branch]);
+        reportDiscrete();
+    }
+#endif
+    fflush(stdout);
+    return failed ? 1 : 0;
+}
+
+// ========================================================================================================= Trace
+
+// Write starting at the seconds register sets the RTC
+static void traceTransfer(const twi_fake_transfer_t* transfer)
+{
+    trace.i2c(sim_true_ms, static_cast<uint8_t>( (transfer->address << 1) | (transfer->read ? 1 : 0) ), transfer->ack,
+              transfer->data, transfer->length);
+    if (transfer->address == DS3231Emu::ADDRESS && !transfer->read && transfer->ack && transfer->length > 1 &&
+        transfer->data[0] == 0) {
+        trace.rtcSet(sim_true_ms, getSimTimeMs());
+    }
+}
+
+static bool startTrace(const char* name)
+{
+    if (!trace.open(name)) return false;
+    for (uint8_t pin = 0; pin < sizeof(pins_names) / sizeof(*pins_names); pin++) trace.setPinName(pin, pins_names[pin]);
+    TwiFake::setMonitor(traceTransfer);
+    return true;
+}
+
+static bool stopTrace()
+{
+    TwiFake::setMonitor(NULL);
+    return trace.close();
+}
+
+// "DATE[.MS]", milliseconds as fraction of the second
+static bool parseDemand(const char* str)
+{
+    std::string date = str;
+    uint64_t ms = 0;
+    size_t dot = date.find('.');
+    if (dot != std::string::npos) {
+        std::string fraction = date.substr(dot + 1) + "00";
+        if (fraction.find_first_not_of("0123456789") != std::string::npos) return false;
+        ms = static_cast<uint64_t>(atoi(fraction.substr(0, 3).c_str()));
+        date.erase(dot);
+    }
+    uint32_t time = parseLocalDateTime(date.c_str());
+    if (time == DateTime::EPOCH_ERROR) return false;
+    sim_demands.push_back(static_cast<uint64_t>(time) * 1000 + ms);
+    return true;
+}
+
+// Comma separated dates
+static bool parseDateList(const char* str, std::vector<uint32_t>* dates)
+{
+    std::string list = str;
+    for (size_t pos = 0; pos < list.size(); ) {
+        size_t comma = list.find(',', pos);
+        if (comma == std::string::npos) comma = list.size();
+        uint32_t date = parseLocalDateTime(list.substr(pos, comma - pos).c_str());
+        if (date == DateTime::EPOCH_ERROR) return false;
+        dates->push_back(date);
+        pos = comma + 1;
+    }
+    std::sort(dates->begin(), dates->end());
+    return true;
+}
+
+/**
+ * simulate [--from DATE | --restore FILE] [--until DATE] [--press DATE]... [--demand DATE[.MS]]... [--save FILE]
+ *          [--i2c-fault DATE,...] [--pipes ntc|none] [--dcf77 clean|noisy] [--rtc-offset S] [--trace FILE] [--fork-at DATE --branch DATE,...]... [--jobs N] [--output PREFIX]]
+ * Dates are local, "YYYY-MM-DD" or "YYYY-MM-DD HH:MM[:SS]". Default is one day from 2017-10-29 0:50.
+ * Demand is an edge of the demand input, latency of its handling is reported.
+ * I2C fault NACKs the address of the next RTC access, the run fails if firmware resets the device.
+ * Pipes runs heat loss model of the loops with return NTC fitted or not, so runtime saved by it can be compared.
+ * DCF77 feeds synthetic receiver output, all ticks are run then. RTC starts --rtc-offset seconds off the true time,
+ * its error at the end is reported.
+ * Run stops at --fork-at if given, --save stores the snapshot taken there or at the end. Every --branch
+ * (may be empty) continues from --fork-at till --until with its own presses, in parallel up to --jobs.
+ * Trace records the run till --fork-at, see "trace" command for the conversion to VCD.
+ */
+int run_simulation(int argc, char* argv[])
+{
+    uint32_t from = parseLocalDateTime("2017-10-29 0:50");
+    uint32_t until = DateTime::EPOCH_ERROR;
+    uint32_t fork_at = DateTime::EPOCH_ERROR;
+    const char* restore_name = NULL;
+    const char* save_name = NULL;
+    const char* trace_name = NULL;
+    const char* output_prefix = "branch";
+    unsigned jobs = std::thread::hardware_concurrency();
+    int32_t rtc_offset = 0;
+    std::vector<uint32_t> presses;
+    std::vector< std::vector<uint32_t> > branches;
+
+    for (int i = 0; i < argc; i++) {
+        const char* option = argv[i];
+        const char* value = (i + 1 < argc) ? argv[++i] : NULL;
+        uint32_t* target = NULL;
+        uint32_t press;
+        bool ok = (value != NULL);
+
+        if (!ok) {
+        } else if (!strcmp(option, "--from"))    target = &from;
+        else if (!strcmp(option, "--until"))     target = &until;
+        else if (!strcmp(option, "--press"))     target = &press;
+        else if (!strcmp(option, "--demand"))    ok = parseDemand(value);
+        else if (!strcmp(option, "--i2c-fault")) ok = parseDateList(value, &sim_faults);
+        else if (!strcmp(option, "--rtc-offset")) rtc_offset = atoi(value);
+        else if (!strcmp(option, "--dcf77")) {
+            sim_dcf77 = true;
+            sim_dcf77_noise = !strcmp(value, "noisy") ? &Dcf77Signal::NOISY : &Dcf77Signal::CLEAN;
+            ok = !strcmp(value, "noisy") || !strcmp(value, "clean");
+        } else if (!strcmp(option, "--pipes")) {
+            sim_pipes = true;
+            sim_return_ntc = !strcmp(value, "ntc");
+            sim_thermal_config.sensor_zones = sim_return_ntc ? static_cast<uint8_t>((1 << CIRC_ZONES) - 1) : 0;
+            ok = sim_return_ntc || !strcmp(value, "none");
+        }
+        else if (!strcmp(option, "--fork-at"))   target = &fork_at;
+        else if (!strcmp(option, "--restore"))   restore_name = value;
+        else if (!strcmp(option, "--save"))      save_name = value;
+        else if (!strcmp(option, "--trace"))     trace_name = value;
+        else if (!strcmp(option, "--output"))    output_prefix = value;
+        else if (!strcmp(option, "--jobs"))      ok = (jobs = static_cast<unsigned>(atoi(value))) > 0;
+        else if (!strcmp(option, "--branch")) {
+            branches.push_back( std::vector<uint32_t>() );
+            ok = parseDateList(value, &branches.back());
+        } else {
+            ok = false;
+        }
+
+        if (ok && target) ok = (*target = parseLocalDateTime(value)) != DateTime::EPOCH_ERROR;
+        if (!ok) {
+            printf("Wrong option: %s\n", option);
+            return 2;
+        }
+        if (target == &press) presses.push_back(press);
+    }
+
+    sim_snapshot_t snapshot;
+    if (restore_name) {
+        if (!loadSnapshot(restore_name, &snapshot)) {
+            printf("Cannot restore %s\n", restore_name);
+            return 1;
+        }
+        from = snapshot.ctx.current_rtc_time;
+    }
+    if (until == DateTime::EPOCH_ERROR) until = from + DateTime::ONE_DAY;
+    if (until <= from || (fork_at != DateTime::EPOCH_ERROR && (fork_at < from || fork_at > until))) {
+        printf("Nothing to simulate\n");
+        return 2;
+    }
+    if (!branches.empty() && fork_at == DateTime::EPOCH_ERROR) fork_at = from;
+
+    static char output_buffer[1 << 16];
+    setvbuf(stdout, output_buffer, _IOFBF, sizeof(output_buffer));
+    std::sort(presses.begin(), presses.end());
+    std::sort(sim_demands.begin(), sim_demands.end());
+
+    if (trace_name && !startTrace(trace_name)) {
+        printf("Cannot open %s\n", trace_name);
+        return 1;
+    }
+    if (restore_name) restoreSnapshot(&snapshot); else startDiscrete(from, rtc_offset);
+
+    const uint32_t end = (fork_at != DateTime::EPOCH_ERROR) ? fork_at : until;
+    runDiscrete(end, presses);
+    reportDiscrete();
+    if (trace_name && !stopTrace()) {
+        printf("Cannot write %s\n", trace_name);
+        return 1;
+    }
+    if (WDTCTL.resets) {
+        printf("Device reset\n");
+        return 1;
+    }
+
+    if (save_name || !branches.empty()) {
+        if (!takeSnapshot(&snapshot)) {
+            printf("I2C transfer in progress, cannot take snapshot\n");
+            return 1;
+        }
+        if (save_name && !saveSnapshot(save_name, &snapshot)) {
+            printf("Cannot save %s\n", save_name);
+            return 1;
+        }
+    }
+    return branches.empty() ? 0 : runBranches(&snapshot, until, branches, jobs, output_prefix);
+}
+
+// ========================================================================================================= Replay
+static Replay replay;
+static circ_context_t power_on_ctx;
+
+static void replayLine(const std::string& line)
+{
+    if (line.compare(0, 8, "Pump is ")) return;
+    if (!replay.matchTransition(ctx.current_rtc_time, !line.compare(0, 11, "Pump is ON:"))) sim_stop = true;
+}
+
+// RAM is initialised as after reset, warm restart state is lost on power down
+static void bootReplay(bool cold, uint32_t rtc_time, uint32_t build_local)
+{
+    ctx = power_on_ctx;
+    if (cold) {
+        memset(&warm_state, 0, sizeof(warm_state));
+        setBuildDate(build_local);
+        rtc.setDateTime(rtc_time);
+    }
+    mode_button_pressed = false;
+    setup();
+}
+
+static void runReplayPresses(uint32_t until, std::vector<uint32_t>* presses)
+{
+    // Mode is switched after the button is held for MODE_CHANGE_TICKS, just before the end of the logged second.
+    // RTC is read every RTC_READ_TICKS, so the switch sees the logged time.
+    static const int32_t PRESS_OFFSET_MS = 1000 - static_cast<int32_t>( (MODE_CHANGE_TICKS + 2) * TICK_TIME );
+    std::sort(presses->begin(), presses->end());
+    runDiscrete(until, *presses, PRESS_OFFSET_MS);
+    presses->clear();
+}
+
+// Runs till the end of a powered period, transitions up to it must be matched
+static bool runReplay(uint32_t until, std::vector<uint32_t>* presses)
+{
+    runReplayPresses(until, presses);
+    return replay.matchUntil(until) && !sim_stop;
+}
+
+// DCF77 correction is applied right after the previous line, nothing was captured till the correction.
+// Transitions printed after it may be earlier than "after", they are matched later.
+static bool setReplayRtc(uint32_t after, uint32_t rtc_time, std::vector<uint32_t>* presses)
+{
+    runReplayPresses(after + 1, presses);
+    if (sim_stop) return false;
+    setRtcDateTime(rtc_time);
+    readDateTimeFromRtc();
+    setupFirstOn();
+    return !sim_stop;
+}
+
+static const char* formatLocal(uint32_t utc, char* buffer, size_t size)
+{
+    dt_date_t d;
+    dt_time_t t;
+    DateTime::setDateTimeFromEpoch(DateTime::getLocalDateTimeFromUtc(utc), &d, &t);
+    snprintf(buffer, size, "%04u-%02u-%02u %02u:%02u:%02u", d.year, d.month, d.day, t.hour, t.minute, t.second);
+    return buffer;
+}
+
+/**
+ * replay FILE [--tolerance S] [--vacations] [--verbose]
+ * Drives the firmware with boots and mode changes from a serial capture and compares pump transitions.
+ * Power is assumed off between the last line before a boot and the RTC date it prints, mode button is pressed
+ * so that the mode changes at the logged time. DCF77 corrections set the RTC right after the line before them.
+ * Capture starting without boot is joined by firmware started a day earlier, in vacations mode if requested.
+ * Exit code is 1 if transitions diverge.
+ */
+int run_replay(int argc, char* argv[])
+{
+    if (argc < 1) {
+        printf("Missing capture file\n");
+        return 2;
+    }
+    uint32_t tolerance = 0;
+    bool vacations = false;
+    bool verbose = false;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--tolerance") && i + 1 < argc) {
+            tolerance = static_cast<uint32_t>(atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--vacations")) {
+            vacations = true;
+        } else if (!strcmp(argv[i], "--verbose")) {
+            verbose = true;
+        } else {
+            printf("Unknown option: %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    FILE* in = fopen(argv[0], "r");
+    if (!in) {
+        printf("Cannot open %s\n", argv[0]);
+        return 1;
+    }
+    bool loaded = replay.load(in);
+    fclose(in);
+    const uint32_t first = replay.getFirstTime();
+    if (!loaded || first == DateTime::EPOCH_ERROR) {
+        printf("No dated lines in %s\n", argv[0]);
+        return 1;
     }
 
-}
\ No newline at end of file
+    static char output_buffer[1 << 16];
+    setvbuf(stdout, output_buffer, _IOFBF, sizeof(output_buffer));
+    power_on_ctx = ctx;
+    sim_quiet = !verbose;
+    sim_line_hook = replayLine;
+    TwiFake::attach(DS3231Emu::ADDRESS, &rtc);
+
+    const std::vector<replay_event_t>& events = replay.getEvents();
+    std::vector<uint32_t> presses;
+    unsigned boots = 0, mode_changes = 0, rtc_sets = 0;
+    bool ok = true;
+
+    if (events[0].type != REPLAY_COLD_BOOT && events[0].type != REPLAY_WARM_BOOT) {
+        replay.startMatching(tolerance, first);
+        startDiscrete(first - DateTime::ONE_DAY);
+        if (vacations) ChangePumpScheduleMode();
+    } else {
+        replay.startMatching(tolerance, 0);
+    }
+
+    for (size_t i = 0; i < events.size() && ok; i++) {
+        const replay_event_t& event = events[i];
+        if (event.type == REPLAY_MODE) {
+            presses.push_back(event.time);
+            mode_changes++;
+            continue;
+        }
+        if (event.type == REPLAY_RTC_SET) {
+            const replay_event_t* previous = i ? &events[i - 1] : NULL;
+            bool dated = previous && previous->type != REPLAY_BUILD_DATE && previous->time != DateTime::EPOCH_ERROR;
+            ok = setReplayRtc(dated ? previous->time : event.time, event.time, &presses);
+            rtc_sets++;
+            continue;
+        }
+        if (event.type != REPLAY_COLD_BOOT && event.type != REPLAY_WARM_BOOT) continue;
+
+        uint32_t rtc_time = event.time;
+        uint32_t build_local = DateTime::EPOCH_ERROR;
+        for (size_t j = i + 1; j < events.size() && j < i + 3; j++) {
+            if (events[j].type == REPLAY_BUILD_DATE) build_local = events[j].time;
+            if (events[j].type == REPLAY_RTC_DATE)   rtc_time = events[j].time;
+        }
+        if (i > 0) ok = runReplay(event.time + 1, &presses);
+        if (!ok || rtc_time == DateTime::EPOCH_ERROR) break;
+        if (build_local == DateTime::EPOCH_ERROR) build_local = DateTime::getLocalDateTimeFromUtc(rtc_time);
+        bootReplay(event.type == REPLAY_COLD_BOOT || i == 0, rtc_time, build_local);
+        boots++;
+    }
+    if (ok) runReplay(replay.getLastTime() + tolerance + 1, &presses);
+    sim_line_hook = NULL;
+    sim_quiet = false;
+
+    printf("Replayed %u lines: %u transitions matched, %u boots, %u mode changes, %u RTC corrections\n",
+           replay.getLines(), replay.getMatched(), boots, mode_changes, rtc_sets);
+    const replay_divergence_t* divergence = replay.getDivergence();
+    if (!divergence) {
+        printf("No divergence\n");
+        fflush(stdout);
+        return 0;
+    }
+
+    char expected[32], simulated[32];
+    if (!divergence->line) {
+        printf("Divergence after the last captured transition: simulated Pump is %s at %s\n",
+               divergence->simulated_on ? "ON" : "OFF", formatLocal(divergence->simulated_time, simulated, sizeof(simulated)));
+    } else if (divergence->simulated_time == DateTime::EPOCH_ERROR) {
+        printf("Divergence at line %u: captured Pump is %s at %s, not simulated\n", divergence->line,
+               divergence->expected_on ? "ON" : "OFF", formatLocal(divergence->expected_time, expected, sizeof(expected)));
+    } else {
+        printf("Divergence at line %u: captured Pump is %s at %s, simulated Pump is %s at %s\n", divergence->line,
+               divergence->expected_on ? "ON" : "OFF", formatLocal(divergence->expected_time, expected, sizeof(expected)),
+               divergence->simulated_on ? "ON" : "OFF", formatLocal(divergence->simulated_time, simulated, sizeof(simulated)));
+    }
+    fflush(stdout);
+    return 1;
+}
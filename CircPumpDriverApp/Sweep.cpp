@@ -0,0 +1,315 @@
+#include "DateTime.h"
+#include "Sweep.h"
+#include "CircPumpConfig.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const circ_shedule_table_t* getSheduleTable(const char* name)
+{
+    if (!strcmp(name, "workweek"))  return &workweek_shedule_table;
+    if (!strcmp(name, "vacations")) return &vacations_shedule_table;
+    return NULL;
+}
+
+// ========================================================================================================= Demand model
+
+// Hot water draws per hour, local time
+static const float WORKDAY_DRAWS_PER_HOUR[24] = {
+    0.05f, 0.05f, 0.05f, 0.05f, 0.05f, 0.3f, 3.0f, 4.0f, 1.5f, 0.3f, 0.3f, 0.3f,
+    0.5f,  0.3f,  0.3f,  0.5f,  1.0f,  2.0f, 2.5f, 3.0f, 2.5f, 1.5f, 0.5f, 0.1f,
+};
+static const float FREE_DAY_DRAWS_PER_HOUR[24] = {
+    0.1f,  0.05f, 0.05f, 0.05f, 0.05f, 0.05f, 0.1f, 0.5f, 2.5f, 3.0f, 2.0f, 1.5f,
+    2.0f,  1.5f,  1.0f,  1.0f,  1.0f,  1.5f, 2.0f, 2.5f, 2.5f, 1.5f, 0.5f, 0.2f,
+};
+
+static const float TAU_HEAT_S = 90.0f;         ///< Loop gets hot with the pump on
+static const float TAU_COOL_S = 1800.0f;       ///< Loop cools down with the pump off
+static const float MAX_WAIT_S = 45.0f;         ///< Waiting for hot water with cold loop
+
+static uint64_t nextRandom(uint64_t* state)
+{
+    // xorshift64*
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+// Poisson process with rate constant within every local hour, times are RTC (UTC) ones
+static void generateDraws(const sweep_setup_t* setup, std::vector<uint32_t>* draws)
+{
+    uint64_t state = setup->seed ? setup->seed : 1;
+    const uint32_t end = setup->from + setup->days * DateTime::ONE_DAY;
+
+    for (uint32_t hour = setup->from; hour < end; hour += DateTime::ONE_HOUR) {
+        uint32_t local = DateTime::getLocalDateTimeFromUtc(hour);
+        DateTime::WEEK_DAYS day = DateTime::getDayTypeFromEpoch(local);
+        const float* profile = (day >= DateTime::SATURDAY) ? FREE_DAY_DRAWS_PER_HOUR : WORKDAY_DRAWS_PER_HOUR;
+        float rate = profile[(local / DateTime::ONE_HOUR) % 24];
+
+        for (double t = 0;;) {
+            double u = ((nextRandom(&state) >> 11) + 1) * (1.0 / 9007199254740993.0);
+            t += -log(u) * DateTime::ONE_HOUR / rate;
+            if (t >= DateTime::ONE_HOUR) break;
+            draws->push_back(hour + static_cast<uint32_t>(t));
+        }
+    }
+}
+
+// ========================================================================================================= Scenario
+
+static float updateHot(float hot, uint32_t dt, bool on)
+{
+    return on ? 1.0f - (1.0f - hot) * expf(-(dt / TAU_HEAT_S)) : hot * expf(-(dt / TAU_COOL_S));
+}
+
+void Sweep::runScenario(const sweep_setup_t* setup, const sweep_scenario_t* scenario, sweep_result_t* result)
+{
+    std::vector<uint32_t> draws;
+    std::vector<float> waits;
+    generateDraws(setup, &draws);
+    waits.reserve(draws.size());
+
+    const circ_shedule_table_t* table = scenario->table;
+    const circ_pulse_config_t* pulse = &scenario->pulse;
+    const uint32_t end = setup->from + setup->days * DateTime::ONE_DAY;
+
+    // Same decisions as setupFirstOn() and planNextEvent() of the firmware
+    uint32_t now = setup->from;
+    uint32_t local = DateTime::getLocalDateTimeFromUtc(now);
+    uint32_t on_time = CircShedule::getNextOnTime(table, local);
+    bool on = (on_time == local);
+    uint32_t last_off_time = 0;
+    uint32_t next = on ? CircShedule::getNextPulseOffTime(pulse, now, last_off_time)
+                       : DateTime::getUtcDateTimeFromLocal(on_time);
+
+    memset(result, 0, sizeof(*result));
+    result->relay_cycles = on ? 1 : 0;
+    float hot = 0;
+    double wait_sum = 0;
+    size_t draw = 0;
+
+    for (;;) {
+        uint32_t until = (next < end) ? next : end;
+        if (on) result->pump_on_s += until - now;
+
+        for (; draw < draws.size() && draws[draw] < until; draw++) {
+            hot = updateHot(hot, draws[draw] - now, on);
+            now = draws[draw];
+            float wait = MAX_WAIT_S * (1.0f - hot);
+            waits.push_back(wait);
+            wait_sum += wait;
+        }
+        hot = updateHot(hot, until - now, on);
+        now = until;
+        if (now >= end) break;
+
+        if (on) {
+            next = CircShedule::getNextPulseOnTime(table, pulse, now, last_off_time);
+            last_off_time = now;
+        } else {
+            next = CircShedule::getNextPulseOffTime(pulse, now, last_off_time);
+            result->relay_cycles++;
+        }
+        on = !on;
+    }
+
+    result->draws = static_cast<uint32_t>(waits.size());
+    if (!waits.empty()) {
+        result->mean_wait_s = static_cast<float>(wait_sum / waits.size());
+        result->max_wait_s = *std::max_element(waits.begin(), waits.end());
+        std::vector<float>::iterator p95 = waits.begin() + (waits.size() * 95) / 100;
+        std::nth_element(waits.begin(), p95, waits.end());
+        result->p95_wait_s = *p95;
+    }
+}
+
+// ========================================================================================================= Thread pool
+
+namespace {
+struct worker_queue_t
+{
+    std::mutex          lock;
+    std::deque<size_t>  tasks;
+};
+}
+
+// Owner takes tasks from the front, thieves from the back
+static bool popTask(worker_queue_t* queue, bool steal, size_t* task)
+{
+    std::lock_guard<std::mutex> guard(queue->lock);
+    if (queue->tasks.empty()) return false;
+    if (steal) {
+        *task = queue->tasks.back();
+        queue->tasks.pop_back();
+    } else {
+        *task = queue->tasks.front();
+        queue->tasks.pop_front();
+    }
+    return true;
+}
+
+void Sweep::runAll(const sweep_setup_t* setup, const sweep_scenario_t* scenarios, sweep_result_t* results,
+                   size_t count, unsigned threads)
+{
+    if (!threads) threads = 1;
+    if (threads > count) threads = static_cast<unsigned>(count ? count : 1);
+
+    // Contiguous blocks, so neighbouring (similar cost) scenarios start on the same worker
+    std::vector<worker_queue_t> queues(threads);
+    for (size_t i = 0; i < count; i++) {
+        queues[i * threads / count].tasks.push_back(i);
+    }
+
+    std::vector<std::thread> workers;
+    for (unsigned id = 0; id < threads; id++) {
+        workers.emplace_back([&, id]() {
+            size_t task;
+            for (;;) {
+                bool found = popTask(&queues[id], false, &task);
+                for (unsigned victim = 1; !found && victim < threads; victim++) {
+                    found = popTask(&queues[(id + victim) % threads], true, &task);
+                }
+                // Nothing is added while running, so all queues are empty for good
+                if (!found) return;
+                runScenario(setup, &scenarios[task], &results[task]);
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+}
+
+// ========================================================================================================= Command
+
+static bool parseList(const char* str, std::vector<uint16_t>* values)
+{
+    values->clear();
+    for (const char* p = str; *p; ) {
+        char* end;
+        unsigned long value = strtoul(p, &end, 10);
+        if (end == p || !value || value > UINT16_MAX) return false;
+        values->push_back(static_cast<uint16_t>(value));
+        p = (*end == ',') ? end + 1 : end;
+        if (*end && *end != ',') return false;
+    }
+    return !values->empty();
+}
+
+/**
+ * sweep [--from YYYY-MM-DD] [--days N] [--seed N] [--threads N] [--out FILE] [--tables NAME,...]
+ *       [--on-first S,...] [--off-first S,...] [--on-next S,...] [--off-next S,...]
+ * CSV with one row per combination of tables and pulse times (in seconds) goes to stdout or FILE.
+ */
+int run_sweep(int argc, char* argv[])
+{
+    sweep_setup_t setup = { DateTime::getUtcDateTimeFromLocal(DateTime::getEpochFromDateTime(2017, 10, 29, 0, 0, 0)),
+                            365, 1 };
+    unsigned threads = std::thread::hardware_concurrency();
+    const char* out_name = NULL;
+    std::vector<std::string> tables = { "workweek", "vacations" };
+    std::vector<uint16_t> on_first  = { 2 * 60, 4 * 60, 6 * 60 };
+    std::vector<uint16_t> off_first = { 3 * 60, 6 * 60, 10 * 60 };
+    std::vector<uint16_t> on_next   = { 30, 1 * 60, 2 * 60 };
+    std::vector<uint16_t> off_next  = { 5 * 60, 9 * 60, 15 * 60 };
+
+    for (int i = 0; i < argc; i++) {
+        const char* option = argv[i];
+        if (i + 1 == argc) {
+            printf("Missing value: %s\n", option);
+            return 2;
+        }
+        bool ok = true;
+        if (!strcmp(argv[i], "--from")) {
+            unsigned year, month, day;
+            uint32_t local = (sscanf(argv[++i], "%u-%u-%u", &year, &month, &day) == 3)
+                           ? DateTime::getEpochFromDateTime(year, month, day, 0, 0, 0) : DateTime::EPOCH_ERROR;
+            ok = (local != DateTime::EPOCH_ERROR);
+            if (ok) setup.from = DateTime::getUtcDateTimeFromLocal(local);
+        } else if (!strcmp(argv[i], "--days")) {
+            setup.days = static_cast<uint32_t>(atoi(argv[++i]));
+            ok = (setup.days > 0);
+        } else if (!strcmp(argv[i], "--seed")) {
+            setup.seed = strtoull(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "--threads")) {
+            threads = static_cast<unsigned>(atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--out")) {
+            out_name = argv[++i];
+        } else if (!strcmp(argv[i], "--tables")) {
+            tables.clear();
+            std::string list = argv[++i];
+            for (size_t pos = 0; pos <= list.size(); ) {
+                size_t comma = list.find(',', pos);
+                if (comma == std::string::npos) comma = list.size();
+                tables.push_back(list.substr(pos, comma - pos));
+                pos = comma + 1;
+            }
+        } else if (!strcmp(argv[i], "--on-first")) {
+            ok = parseList(argv[++i], &on_first);
+        } else if (!strcmp(argv[i], "--off-first")) {
+            ok = parseList(argv[++i], &off_first);
+        } else if (!strcmp(argv[i], "--on-next")) {
+            ok = parseList(argv[++i], &on_next);
+        } else if (!strcmp(argv[i], "--off-next")) {
+            ok = parseList(argv[++i], &off_next);
+        } else {
+            printf("Unknown option: %s\n", option);
+            return 2;
+        }
+        if (!ok) {
+            printf("Invalid option: %s %s\n", option, argv[i]);
+            return 2;
+        }
+    }
+
+    std::vector<sweep_scenario_t> scenarios;
+    for (const auto& name : tables) {
+        const circ_shedule_table_t* table = getSheduleTable(name.c_str());
+        if (!table) {
+            printf("Unknown table: %s\n", name.c_str());
+            return 2;
+        }
+        for (uint16_t a : on_first) for (uint16_t b : off_first) for (uint16_t c : on_next) for (uint16_t d : off_next) {
+            sweep_scenario_t scenario = { name.c_str(), table, { a, b, c, d } };
+            scenarios.push_back(scenario);
+        }
+    }
+
+    FILE* out = out_name ? fopen(out_name, "w") : stdout;
+    if (!out) {
+        printf("Cannot open %s\n", out_name);
+        return 1;
+    }
+
+    std::vector<sweep_result_t> results(scenarios.size());
+    auto start = std::chrono::steady_clock::now();
+    Sweep::runAll(&setup, scenarios.data(), results.data(), scenarios.size(), threads);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    fprintf(out, "table,on_first,off_first,on_next,off_next,days,pump_on_hours,relay_cycles,draws,"
+                 "mean_wait_s,p95_wait_s,max_wait_s\n");
+    for (size_t i = 0; i < scenarios.size(); i++) {
+        const sweep_scenario_t& s = scenarios[i];
+        const sweep_result_t& r = results[i];
+        fprintf(out, "%s,%u,%u,%u,%u,%u,%.1f,%u,%u,%.2f,%.2f,%.2f\n", s.table_name, s.pulse.on_time_first,
+                s.pulse.off_time_first, s.pulse.on_time_next, s.pulse.off_time_next, setup.days,
+                r.pump_on_s / 3600.0, r.relay_cycles, r.draws, r.mean_wait_s, r.p95_wait_s, r.max_wait_s);
+    }
+    if (out != stdout) fclose(out);
+
+    fprintf(stderr, "%u scenarios, %u days each, %u threads, %.2f s\n", static_cast<unsigned>(scenarios.size()),
+            setup.days, threads ? threads : 1, elapsed);
+    return 0;
+}
@@ -0,0 +1,46 @@
+#pragma once
+/**
+ * Pump pulse constants sweep.
+ * Every scenario (schedule table + pulse constants) runs the firmware pulse planner over the same synthetic
+ * hot-water demand. Loop temperature is modelled as a hot fraction of the pipe, which rises while the pump runs
+ * and decays while it is off; waiting for hot water at a draw is proportional to the cold part.
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include "CircShedule.h"
+
+typedef struct
+{
+    uint32_t from;                      ///< RTC (UTC) time
+    uint32_t days;
+    uint64_t seed;                      ///< Demand is the same for all scenarios with the same seed
+} sweep_setup_t;
+
+typedef struct
+{
+    const char*                 table_name;
+    const circ_shedule_table_t* table;
+    circ_pulse_config_t         pulse;
+} sweep_scenario_t;
+
+typedef struct
+{
+    uint32_t pump_on_s;
+    uint32_t relay_cycles;              ///< Pump switched on
+    uint32_t draws;
+    float    mean_wait_s;
+    float    p95_wait_s;
+    float    max_wait_s;
+} sweep_result_t;
+
+class Sweep
+{
+public:
+    static void runScenario(const sweep_setup_t* setup, const sweep_scenario_t* scenario, sweep_result_t* result);
+    // Scenarios are spread over threads with work stealing, results are in scenarios order
+    static void runAll(const sweep_setup_t* setup, const sweep_scenario_t* scenarios, sweep_result_t* results,
+                       size_t count, unsigned threads);
+};
+
+// "sweep" command of the host application
+int run_sweep(int argc, char* argv[]);
@@ -0,0 +1,555 @@
+#include "DateTime.h"
+#include "Trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <algorithm>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define TRACE_MMAP
+#endif
+
+static const uint32_t TRACE_MAGIC = 0x52544350;     // "PCTR"
+static const uint16_t TRACE_VERSION = 2;
+static const uint32_t INDEX_STRIDE = 1024;
+// File grows by this many records, space is allocated only when written
+static const uint64_t GROW_RECORDS = 1 << 20;
+
+static_assert(sizeof(trace_record_t) == 24, "Trace record layout");
+static_assert(sizeof(trace_header_t) == 256, "Trace header layout");
+
+// ========================================================================================================= File mapping
+/**
+ * Whole file mapped to memory. Without mmap the file is kept in a buffer, written on finish() and read
+ * whole on open, so traces stay portable but large ones need as much memory.
+ */
+class TraceMapping
+{
+public:
+    uint8_t* data;
+    uint64_t size;
+
+#if defined(TRACE_MMAP)
+    TraceMapping() : data(NULL), size(0), fd(-1), writable(false) {}
+    ~TraceMapping()
+    {
+        if (data) munmap(data, size);
+        if (fd >= 0) ::close(fd);
+    }
+
+    bool create(const char* name, uint64_t new_size)
+    {
+        fd = ::open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        writable = true;
+        return fd >= 0 && resize(new_size);
+    }
+
+    bool resize(uint64_t new_size)
+    {
+        if (data) munmap(data, size);
+        data = NULL;
+        if (ftruncate(fd, static_cast<off_t>(new_size))) return false;
+        return map(new_size);
+    }
+
+    bool openRead(const char* name)
+    {
+        struct stat st;
+        fd = ::open(name, O_RDONLY);
+        return fd >= 0 && !fstat(fd, &st) && map(static_cast<uint64_t>(st.st_size));
+    }
+
+    bool finish(uint64_t used)
+    {
+        munmap(data, size);
+        data = NULL;
+        bool ok = !ftruncate(fd, static_cast<off_t>(used));
+        ok = !::close(fd) && ok;
+        fd = -1;
+        return ok;
+    }
+
+private:
+    int  fd;
+    bool writable;
+
+    bool map(uint64_t new_size)
+    {
+        if (!new_size) return false;
+        void* p = mmap(NULL, new_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) return false;
+        data = static_cast<uint8_t*>(p);
+        size = new_size;
+        if (!writable) madvise(p, new_size, MADV_SEQUENTIAL);
+        return true;
+    }
+#else
+    TraceMapping() : data(NULL), size(0) {}
+
+    bool create(const char* name, uint64_t new_size)
+    {
+        file_name = name;
+        FILE* file = fopen(name, "wb");
+        if (!file) return false;
+        fclose(file);
+        return resize(new_size);
+    }
+
+    bool resize(uint64_t new_size)
+    {
+        buffer.resize(static_cast<size_t>(new_size));
+        data = buffer.data();
+        size = new_size;
+        return true;
+    }
+
+    bool openRead(const char* name)
+    {
+        FILE* file = fopen(name, "rb");
+        if (!file) return false;
+        fseek(file, 0, SEEK_END);
+        long length = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        bool ok = length > 0 && resize(static_cast<uint64_t>(length)) &&
+                  fread(data, 1, buffer.size(), file) == buffer.size();
+        fclose(file);
+        return ok;
+    }
+
+    bool finish(uint64_t used)
+    {
+        FILE* file = fopen(file_name.c_str(), "wb");
+        if (!file) return false;
+        bool ok = fwrite(data, 1, static_cast<size_t>(used), file) == used;
+        return (fclose(file) == 0) && ok;
+    }
+
+private:
+    std::string          file_name;
+    std::vector<uint8_t> buffer;
+#endif
+};
+
+// ========================================================================================================= Writer
+
+TraceWriter::TraceWriter() : mapping(NULL), capacity(0)
+{
+}
+
+TraceWriter::~TraceWriter()
+{
+    close();
+}
+
+bool TraceWriter::open(const char* name)
+{
+    close();
+    mapping = new TraceMapping;
+    capacity = GROW_RECORDS;
+    if (!mapping->create(name, sizeof(trace_header_t) + capacity * sizeof(trace_record_t))) {
+        delete mapping;
+        mapping = NULL;
+        return false;
+    }
+
+    trace_header_t* header = reinterpret_cast<trace_header_t*>(mapping->data);
+    memset(header, 0, sizeof(*header));
+    header->magic = TRACE_MAGIC;
+    header->version = TRACE_VERSION;
+    header->record_size = sizeof(trace_record_t);
+    header->index_stride = INDEX_STRIDE;
+    index.clear();
+    return true;
+}
+
+bool TraceWriter::close()
+{
+    if (!mapping) return true;
+
+    trace_header_t* header = reinterpret_cast<trace_header_t*>(mapping->data);
+    uint64_t offset = sizeof(trace_header_t) + header->records * sizeof(trace_record_t);
+    uint64_t used = offset + index.size() * sizeof(uint64_t);
+    bool ok = (used <= mapping->size) || mapping->resize(used);
+    if (ok) {
+        header = reinterpret_cast<trace_header_t*>(mapping->data);
+        if (!index.empty()) memcpy(mapping->data + offset, index.data(), index.size() * sizeof(uint64_t));
+        header->index_offset = offset;
+        header->index_count = static_cast<uint32_t>(index.size());
+    }
+    ok = mapping->finish(ok ? used : offset) && ok;
+    delete mapping;
+    mapping = NULL;
+    return ok;
+}
+
+void TraceWriter::setPinName(uint8_t pin, const char* name)
+{
+    if (!mapping || pin >= 8) return;
+    trace_header_t* header = reinterpret_cast<trace_header_t*>(mapping->data);
+    strncpy(header->pin_names[pin], name, sizeof(header->pin_names[pin]) - 1);
+}
+
+trace_record_t* TraceWriter::append(uint64_t time_ms, uint8_t type)
+{
+    trace_header_t* header = reinterpret_cast<trace_header_t*>(mapping->data);
+    uint64_t i = header->records;
+    if (i == capacity) {
+        capacity += GROW_RECORDS;
+        if (!mapping->resize(sizeof(trace_header_t) + capacity * sizeof(trace_record_t))) {
+            // Out of disk space, trace ends here
+            capacity -= GROW_RECORDS;
+            return NULL;
+        }
+        header = reinterpret_cast<trace_header_t*>(mapping->data);
+    }
+    if (!(i % INDEX_STRIDE)) index.push_back(time_ms);
+    header->records = i + 1;
+
+    trace_record_t* record = reinterpret_cast<trace_record_t*>(mapping->data + sizeof(trace_header_t)) + i;
+    memset(record, 0, sizeof(*record));
+    record->time_ms = time_ms;
+    record->type = type;
+    return record;
+}
+
+void TraceWriter::pin(uint64_t time_ms, uint8_t pin, uint8_t level)
+{
+    if (!mapping) return;
+    trace_record_t* record = append(time_ms, TRACE_PIN);
+    if (!record) return;
+    record->arg = pin;
+    record->value = level;
+}
+
+void TraceWriter::i2c(uint64_t time_ms, uint8_t address_byte, bool ack, const uint8_t* data, uint16_t length)
+{
+    if (!mapping) return;
+    trace_record_t* record = append(time_ms, TRACE_I2C);
+    if (!record) return;
+    record->arg = address_byte;
+    record->value = (length & ~TRACE_I2C_NACK) | (ack ? 0 : TRACE_I2C_NACK);
+    memcpy(record->data, data, std::min<size_t>(length, sizeof(record->data)));
+}
+
+void TraceWriter::alarm(uint64_t time_ms, uint8_t alarm)
+{
+    if (!mapping) return;
+    trace_record_t* record = append(time_ms, TRACE_ALARM);
+    if (record) record->arg = alarm;
+}
+
+void TraceWriter::log(uint64_t time_ms, const char* text, size_t length)
+{
+    if (!mapping) return;
+    do {
+        trace_record_t* record = append(time_ms, TRACE_LOG);
+        if (!record) return;
+        size_t part = std::min(length, sizeof(record->data));
+        memcpy(record->data, text, part);
+        record->arg = static_cast<uint8_t>(part);
+        text += part;
+        length -= part;
+        record->value = length ? TRACE_LOG_CONTINUED : 0;
+    } while (length);
+}
+
+void TraceWriter::rtcSet(uint64_t time_ms, uint64_t rtc_ms)
+{
+    if (!mapping) return;
+    trace_record_t* record = append(time_ms, TRACE_RTC_SET);
+    if (record) memcpy(record->data, &rtc_ms, sizeof(rtc_ms));
+}
+
+// ========================================================================================================= Reader
+
+TraceReader::TraceReader() : mapping(NULL), header(NULL), records(NULL), count(0)
+{
+}
+
+TraceReader::~TraceReader()
+{
+    close();
+}
+
+void TraceReader::close()
+{
+    delete mapping;
+    mapping = NULL;
+    header = NULL;
+    records = NULL;
+    count = 0;
+    index.clear();
+}
+
+bool TraceReader::open(const char* name)
+{
+    close();
+    mapping = new TraceMapping;
+    if (!mapping->openRead(name) || mapping->size < sizeof(trace_header_t)) {
+        close();
+        return false;
+    }
+
+    header = reinterpret_cast<const trace_header_t*>(mapping->data);
+    uint64_t available = (mapping->size - sizeof(trace_header_t)) / sizeof(trace_record_t);
+    if (header->magic != TRACE_MAGIC || header->version != TRACE_VERSION ||
+        header->record_size != sizeof(trace_record_t) || !header->index_stride || header->records > available) {
+        close();
+        return false;
+    }
+    records = reinterpret_cast<const trace_record_t*>(mapping->data + sizeof(trace_header_t));
+    count = header->records;
+
+    uint64_t index_end = header->index_offset + header->index_count * sizeof(uint64_t);
+    if (header->index_count && index_end <= mapping->size) {
+        const uint64_t* stored = reinterpret_cast<const uint64_t*>(mapping->data + header->index_offset);
+        index.assign(stored, stored + header->index_count);
+    } else {
+        for (uint64_t i = 0; i < count; i += header->index_stride) index.push_back(records[i].time_ms);
+    }
+    return true;
+}
+
+const char* TraceReader::getPinName(uint8_t pin) const
+{
+    return (header && pin < 8) ? header->pin_names[pin] : "";
+}
+
+uint64_t TraceReader::find(uint64_t time_ms) const
+{
+    if (index.empty()) return count;
+    // Last stride starting before time_ms, records equal to time_ms may end the previous one
+    size_t stride = std::lower_bound(index.begin(), index.end(), time_ms) - index.begin();
+    uint64_t i = stride ? (stride - 1) * header->index_stride : 0;
+    while (i < count && records[i].time_ms < time_ms) i++;
+    return i;
+}
+
+uint64_t TraceReader::getLog(uint64_t i, char* text, size_t size) const
+{
+    size_t length = 0;
+    for (; i < count && records[i].type == TRACE_LOG; ) {
+        const trace_record_t& record = records[i++];
+        size_t part = std::min<size_t>(record.arg, size - 1 - length);
+        memcpy(text + length, record.data, part);
+        length += part;
+        if (!(record.value & TRACE_LOG_CONTINUED)) break;
+    }
+    text[length] = '\0';
+    return i;
+}
+
+uint64_t TraceReader::getRtcTime(const trace_record_t& record)
+{
+    uint64_t rtc_ms;
+    memcpy(&rtc_ms, record.data, sizeof(rtc_ms));
+    return rtc_ms;
+}
+
+// ========================================================================================================= VCD
+
+// Identifiers are printable characters from '!'
+static char vcdId(unsigned signal)
+{
+    return static_cast<char>('!' + signal);
+}
+
+// VCD strings cannot contain white space
+static void printVcdString(FILE* out, const char* text, char id)
+{
+    fputc('s', out);
+    for (; *text; text++) fputc( (*text <= ' ' || *text > '~') ? '_' : *text, out );
+    fprintf(out, " %c\n", id);
+}
+
+// Local time of RTC with milliseconds
+static void formatRtcTime(uint64_t rtc_ms, char* text, size_t size)
+{
+    dt_date_t d;
+    dt_time_t t;
+    DateTime::setDateTimeFromEpoch( DateTime::getLocalDateTimeFromUtc(static_cast<uint32_t>(rtc_ms / 1000)), &d, &t );
+    snprintf(text, size, "%04u-%02u-%02u %02u:%02u:%02u.%03u", d.year, d.month, d.day, t.hour, t.minute, t.second,
+             static_cast<unsigned>(rtc_ms % 1000));
+}
+
+bool traceToVcd(const TraceReader& trace, uint64_t first, uint64_t last, uint64_t origin_ms, FILE* out)
+{
+    enum { SIGNAL_I2C = 8, SIGNAL_ALARM1, SIGNAL_ALARM2, SIGNAL_LOG, SIGNAL_RTC };
+    dt_date_t d;
+    dt_time_t t;
+    DateTime::setDateTimeFromEpoch( DateTime::getLocalDateTimeFromUtc(static_cast<uint32_t>(origin_ms / 1000)), &d, &t );
+
+    fprintf(out, "$date %04u-%02u-%02u %02u:%02u:%02u local $end\n", d.year, d.month, d.day, t.hour, t.minute, t.second);
+    fprintf(out, "$version CircPumpDriverApp trace $end\n$timescale 1 ms $end\n$scope module circpump $end\n");
+    for (uint8_t pin = 0; pin < 8; pin++) {
+        std::string name = trace.getPinName(pin);
+        if (name.empty()) continue;
+        std::replace(name.begin(), name.end(), ' ', '_');
+        fprintf(out, "$var wire 1 %c %s $end\n", vcdId(pin), name.c_str());
+    }
+    fprintf(out, "$var string 1 %c i2c $end\n", vcdId(SIGNAL_I2C));
+    fprintf(out, "$var event 1 %c alarm1 $end\n", vcdId(SIGNAL_ALARM1));
+    fprintf(out, "$var event 1 %c alarm2 $end\n", vcdId(SIGNAL_ALARM2));
+    fprintf(out, "$var string 1 %c log $end\n", vcdId(SIGNAL_LOG));
+    fprintf(out, "$var string 1 %c rtc_set $end\n", vcdId(SIGNAL_RTC));
+    fprintf(out, "$upscope $end\n$enddefinitions $end\n");
+
+    uint64_t time = UINT64_MAX;
+    char text[256];
+    for (uint64_t i = first; i < last; ) {
+        const trace_record_t& record = trace[i];
+        uint64_t record_time = (record.time_ms > origin_ms) ? record.time_ms - origin_ms : 0;
+        if (record_time != time) {
+            time = record_time;
+            fprintf(out, "#%llu\n", static_cast<unsigned long long>(time));
+        }
+
+        switch (record.type) {
+        case TRACE_PIN:
+            if (record.arg < 8) fprintf(out, "%u%c\n", record.value ? 1 : 0, vcdId(record.arg));
+            break;
+        case TRACE_I2C: {
+            unsigned length = record.value & ~TRACE_I2C_NACK;
+            int n = snprintf(text, sizeof(text), "%02X_%c%s", record.arg >> 1, (record.arg & 1) ? 'R' : 'W',
+                             (record.value & TRACE_I2C_NACK) ? "_NACK" : "");
+            for (unsigned b = 0; b < length && b < sizeof(record.data); b++) {
+                n += snprintf(text + n, sizeof(text) - n, "_%02X", record.data[b]);
+            }
+            if (length > sizeof(record.data)) snprintf(text + n, sizeof(text) - n, "_+%u", length - (unsigned)sizeof(record.data));
+            printVcdString(out, text, vcdId(SIGNAL_I2C));
+            break;
+        }
+        case TRACE_ALARM:
+            fprintf(out, "1%c\n", vcdId(record.arg == 1 ? SIGNAL_ALARM1 : SIGNAL_ALARM2));
+            break;
+        case TRACE_LOG:
+            i = trace.getLog(i, text, sizeof(text));
+            printVcdString(out, text, vcdId(SIGNAL_LOG));
+            continue;
+        case TRACE_RTC_SET:
+            formatRtcTime(TraceReader::getRtcTime(record), text, sizeof(text));
+            printVcdString(out, text, vcdId(SIGNAL_RTC));
+            break;
+        }
+        i++;
+    }
+    return !ferror(out);
+}
+
+// ========================================================================================================= Command
+
+static uint64_t parseLocalTimeMs(const char* str)
+{
+    unsigned year, month, day, hour = 0, minute = 0, second = 0;
+    if ( sscanf(str, "%u-%u-%u%*[ T]%u:%u:%u", &year, &month, &day, &hour, &minute, &second) < 3 ) return UINT64_MAX;
+    uint32_t local = DateTime::getEpochFromDateTime(year, month, day, hour, minute, second);
+    if (local == DateTime::EPOCH_ERROR) return UINT64_MAX;
+    return static_cast<uint64_t>(DateTime::getUtcDateTimeFromLocal(local)) * 1000;
+}
+
+static void printRecords(const TraceReader& trace, uint64_t first, uint64_t last)
+{
+    char text[256];
+    for (uint64_t i = first; i < last; ) {
+        const trace_record_t& record = trace[i];
+        dt_date_t d;
+        dt_time_t t;
+        DateTime::setDateTimeFromEpoch( DateTime::getLocalDateTimeFromUtc(static_cast<uint32_t>(record.time_ms / 1000)), &d, &t );
+        printf("%04u-%02u-%02u %02u:%02u:%02u.%03u  ", d.year, d.month, d.day, t.hour, t.minute, t.second,
+               static_cast<unsigned>(record.time_ms % 1000));
+
+        switch (record.type) {
+        case TRACE_PIN:
+            printf("PIN    %s = %u\n", trace.getPinName(record.arg), record.value);
+            break;
+        case TRACE_I2C: {
+            unsigned length = record.value & ~TRACE_I2C_NACK;
+            printf("I2C    %02X %c%s", record.arg >> 1, (record.arg & 1) ? 'R' : 'W',
+                   (record.value & TRACE_I2C_NACK) ? " NACK" : "");
+            for (unsigned b = 0; b < length && b < sizeof(record.data); b++) printf(" %02X", record.data[b]);
+            if (length > sizeof(record.data)) printf(" (+%u)", length - (unsigned)sizeof(record.data));
+            printf("\n");
+            break;
+        }
+        case TRACE_ALARM:
+            printf("ALARM  %u\n", record.arg);
+            break;
+        case TRACE_LOG:
+            i = trace.getLog(i, text, sizeof(text));
+            printf("LOG    %s\n", text);
+            continue;
+        case TRACE_RTC_SET:
+            formatRtcTime(TraceReader::getRtcTime(record), text, sizeof(text));
+            printf("RTC    set to %s\n", text);
+            break;
+        default:
+            printf("?      type %u\n", record.type);
+            break;
+        }
+        i++;
+    }
+}
+
+/**
+ * trace FILE [--from DATE] [--until DATE] [--vcd OUT]
+ * Prints records in the range (local dates, "YYYY-MM-DD" or "YYYY-MM-DD HH:MM[:SS]"), or converts it to VCD.
+ */
+int run_trace(int argc, char* argv[])
+{
+    if (argc < 1) {
+        printf("Missing trace file\n");
+        return 2;
+    }
+    const char* name = argv[0];
+    const char* vcd_name = NULL;
+    uint64_t from = 0;
+    uint64_t until = UINT64_MAX;
+
+    for (int i = 1; i < argc; i++) {
+        const char* option = argv[i];
+        if (i + 1 == argc) {
+            printf("Missing value: %s\n", option);
+            return 2;
+        }
+        const char* value = argv[++i];
+        bool ok = true;
+        if (!strcmp(option, "--from"))       ok = (from = parseLocalTimeMs(value)) != UINT64_MAX;
+        else if (!strcmp(option, "--until")) ok = (until = parseLocalTimeMs(value)) != UINT64_MAX;
+        else if (!strcmp(option, "--vcd"))   vcd_name = value;
+        else {
+            printf("Unknown option: %s\n", option);
+            return 2;
+        }
+        if (!ok) {
+            printf("Invalid option: %s %s\n", option, value);
+            return 2;
+        }
+    }
+
+    TraceReader trace;
+    if (!trace.open(name)) {
+        printf("Cannot read trace %s\n", name);
+        return 1;
+    }
+    uint64_t first = trace.find(from);
+    uint64_t last = trace.find(until);
+
+    if (!vcd_name) {
+        printRecords(trace, first, last);
+        return 0;
+    }
+    FILE* out = fopen(vcd_name, "w");
+    if (!out) {
+        printf("Cannot open %s\n", vcd_name);
+        return 1;
+    }
+    uint64_t origin = from ? from : (first < last ? trace[first].time_ms : 0);
+    bool ok = traceToVcd(trace, first, last, origin, out);
+    ok = (fclose(out) == 0) && ok;
+    printf("%llu records written to %s\n", static_cast<unsigned long long>(last - first), vcd_name);
+    return ok ? 0 : 1;
+}
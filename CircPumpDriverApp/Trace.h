@@ -0,0 +1,105 @@
+#pragma once
+/**
+ * Binary trace of simulator runs.
+ * Fixed size records (pin changes, I2C transfers, RTC alarms and corrections, log text) are appended in time order
+ * to a memory mapped file. Time is the true one, RTC may be off and is set back and forth by DCF77 corrections. Time
+ * of every INDEX_STRIDE-th record forms a sparse index stored after the records on close, so any time range is found
+ * by binary search over the index and a scan of at most one stride.
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <vector>
+
+typedef enum
+{
+    TRACE_PIN = 1,          ///< arg: pin, value: level
+    TRACE_I2C,              ///< arg: address byte (R/W in bit 0), value: length | TRACE_I2C_NACK, data: first bytes
+    TRACE_ALARM,            ///< arg: alarm number
+    TRACE_LOG,              ///< arg: text length, value: TRACE_LOG_CONTINUED if text goes on in the next record
+    TRACE_RTC_SET,          ///< data: RTC (UTC) time in ms after it was set, see TraceReader::getRtcTime()
+} trace_type_t;
+
+static const uint16_t TRACE_I2C_NACK = 0x8000;
+static const uint16_t TRACE_LOG_CONTINUED = 1;
+
+typedef struct
+{
+    uint64_t time_ms;       ///< True (UTC) time
+    uint8_t  type;
+    uint8_t  arg;
+    uint16_t value;
+    uint8_t  data[12];
+} trace_record_t;
+
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint64_t records;       ///< Updated with every record, so a trace of crashed run is readable
+    uint32_t index_stride;
+    uint32_t index_count;   ///< 0 if trace was not closed
+    uint64_t index_offset;
+    char     pin_names[8][16];
+    uint8_t  reserved[96];
+} trace_header_t;
+
+class TraceMapping;
+
+class TraceWriter
+{
+public:
+    TraceWriter();
+    ~TraceWriter();
+
+    bool open(const char* name);
+    // Writes the index, trace is truncated to its size
+    bool close();
+    bool isOpen() const { return mapping != NULL; }
+    void setPinName(uint8_t pin, const char* name);
+
+    void pin(uint64_t time_ms, uint8_t pin, uint8_t level);
+    void i2c(uint64_t time_ms, uint8_t address_byte, bool ack, const uint8_t* data, uint16_t length);
+    void alarm(uint64_t time_ms, uint8_t alarm);
+    void log(uint64_t time_ms, const char* text, size_t length);
+    void rtcSet(uint64_t time_ms, uint64_t rtc_ms);
+
+private:
+    TraceMapping*         mapping;
+    uint64_t              capacity;
+    std::vector<uint64_t> index;
+
+    trace_record_t* append(uint64_t time_ms, uint8_t type);
+};
+
+class TraceReader
+{
+public:
+    TraceReader();
+    ~TraceReader();
+
+    bool open(const char* name);
+    void close();
+    uint64_t size() const { return count; }
+    const trace_record_t& operator[](uint64_t i) const { return records[i]; }
+    const char* getPinName(uint8_t pin) const;
+    // First record at or after time_ms
+    uint64_t find(uint64_t time_ms) const;
+    // Joins continued log records, returns the index after the last one
+    uint64_t getLog(uint64_t i, char* text, size_t size) const;
+    static uint64_t getRtcTime(const trace_record_t& record);
+
+private:
+    TraceMapping*         mapping;
+    const trace_header_t* header;
+    const trace_record_t* records;
+    uint64_t              count;
+    std::vector<uint64_t> index;    ///< Rebuilt if trace was not closed
+};
+
+// Writes records [first, last) as VCD with 1ms time scale, time 0 is "origin_ms"
+bool traceToVcd(const TraceReader& trace, uint64_t first, uint64_t last, uint64_t origin_ms, FILE* out);
+
+// "trace" command of the host application
+int run_trace(int argc, char* argv[]);
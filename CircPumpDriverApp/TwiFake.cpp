@@ -0,0 +1,190 @@
+#include "TwiFake.h"
+
+#include <stddef.h>
+
+static struct
+{
+    uint8_t             address;
+    TwiFakeDevice*      device;
+} devices[TwiFake::MAX_DEVICES];
+
+static struct
+{
+    TwiFakeDevice*      device;     ///< Addressed slave, NULL if address was not acknowledged
+    twi_port_event_t    pending;    ///< Event reported when latency expires
+    bool                read;
+    bool                stop;       ///< STOP requested, no more events
+    unsigned            latency;
+    unsigned            countdown;
+    unsigned            fail_count;
+    bool                stuck;
+} port;
+
+static twi_fake_monitor_t  monitor;
+static twi_fake_transfer_t transfer;
+static bool                transfer_open;
+
+unsigned TwiFake::transactions = 0;
+unsigned TwiFake::bytes = 0;
+unsigned TwiFake::recoveries = 0;
+
+void TwiFake::attach(uint8_t address, TwiFakeDevice* device)
+{
+    for (auto& d : devices) {
+        if (!d.device || d.address == address) {
+            d.address = address;
+            d.device = device;
+            return;
+        }
+    }
+}
+
+void TwiFake::detachAll()
+{
+    for (auto& d : devices) d.device = NULL;
+}
+
+void TwiFake::setLatency(unsigned polls)
+{
+    port.latency = polls;
+}
+
+void TwiFake::failNext(unsigned count)
+{
+    port.fail_count = count;
+}
+
+void TwiFake::stickBus()
+{
+    port.stuck = true;
+}
+
+bool TwiFake::isStuck()
+{
+    return port.stuck;
+}
+
+void TwiFake::setMonitor(twi_fake_monitor_t new_monitor)
+{
+    monitor = new_monitor;
+    transfer_open = false;
+}
+
+static void endTransfer()
+{
+    if (transfer_open) monitor(&transfer);
+    transfer_open = false;
+}
+
+static void addTransferByte(uint8_t value)
+{
+    if (!transfer_open) return;
+    if (transfer.length < sizeof(transfer.data)) transfer.data[transfer.length] = value;
+    transfer.length++;
+}
+
+static void setPending(twi_port_event_t event)
+{
+    port.pending = event;
+    port.countdown = port.latency;
+}
+
+// ========================================================================================================= TwiAsync backend
+
+void twi_port_init()
+{
+    port.device = NULL;
+    port.pending = TWI_PORT_NONE;
+    port.stop = false;
+    transfer_open = false;
+}
+
+void twi_port_start(uint8_t address, bool read, bool stop_after_first)
+{
+    TwiFake::transactions++;
+    if (monitor) {
+        endTransfer();
+        transfer.address = address;
+        transfer.read = read;
+        transfer.ack = true;
+        transfer.length = 0;
+        transfer_open = true;
+    }
+    port.device = NULL;
+    for (auto& d : devices) {
+        if (d.device && d.address == address) port.device = d.device;
+    }
+    port.read = read;
+    port.stop = false;
+    if (port.fail_count) {
+        port.fail_count--;
+        port.device = NULL;
+    }
+    if (!port.device) {
+        transfer.ack = false;
+        endTransfer();
+        setPending(TWI_PORT_NACK);
+        return;
+    }
+    port.device->start(read);
+    setPending(read ? TWI_PORT_RX : TWI_PORT_TX);
+    if (read && stop_after_first) port.stop = true;
+}
+
+twi_port_event_t twi_port_poll()
+{
+    if (port.stuck || port.pending == TWI_PORT_NONE) return TWI_PORT_NONE;
+    if (port.countdown) {
+        port.countdown--;
+        return TWI_PORT_NONE;
+    }
+    return port.pending;
+}
+
+void twi_port_tx(uint8_t value)
+{
+    TwiFake::bytes++;
+    addTransferByte(value);
+    bool ack = port.device->write(value);
+    if (!ack) transfer.ack = false;
+    setPending(ack ? TWI_PORT_TX : TWI_PORT_NACK);
+}
+
+uint8_t twi_port_rx(bool stop_next)
+{
+    TwiFake::bytes++;
+    uint8_t value = port.device->read();
+    addTransferByte(value);
+    if (port.stop) {
+        endTransfer();
+        port.device->stop();
+        port.device = NULL;
+        port.pending = TWI_PORT_NONE;
+    } else {
+        port.stop = stop_next;
+        setPending(TWI_PORT_RX);
+    }
+    return value;
+}
+
+void twi_port_stop()
+{
+    endTransfer();
+    if (port.device) port.device->stop();
+    port.device = NULL;
+    port.pending = TWI_PORT_NONE;
+    port.stop = true;
+}
+
+bool twi_port_busy()
+{
+    return false;
+}
+
+void twi_port_recover()
+{
+    TwiFake::recoveries++;
+    endTransfer();
+    port.stuck = false;
+    twi_port_init();
+}
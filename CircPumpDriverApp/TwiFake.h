@@ -0,0 +1,79 @@
+#pragma once
+/**
+ * Host side I2C backend for TwiAsync.
+ * Slaves are simulated at byte level, every bus event can be delayed by a number of twi_port_poll() calls,
+ * so completion order and non-blocking behavior can be observed.
+ */
+#include <stdint.h>
+#include <TwiAsync.h>
+
+class TwiFakeDevice
+{
+public:
+    virtual ~TwiFakeDevice() {}
+    // START or repeated START addressed to this device
+    virtual void start(bool read) = 0;
+    // Returns false to NACK the byte
+    virtual bool write(uint8_t value) = 0;
+    virtual uint8_t read() = 0;
+    virtual void stop() {}
+};
+
+// Generic register file with auto incremented register pointer (e.g. EEPROM, most sensors)
+class TwiFakeRegisters : public TwiFakeDevice
+{
+public:
+    uint8_t regs[256];
+
+    TwiFakeRegisters() : regs(), pointer(0), pointer_set(false) {}
+    void start(bool) override { pointer_set = false; }
+    bool write(uint8_t value) override
+    {
+        if (!pointer_set) { pointer = value; pointer_set = true; }
+        else              { regs[pointer++] = value; }
+        return true;
+    }
+    uint8_t read() override { return regs[pointer++]; }
+
+private:
+    uint8_t pointer;
+    bool    pointer_set;
+};
+
+// One addressed transfer, reported on STOP, repeated START or address NACK
+typedef struct
+{
+    uint8_t  address;
+    bool     read;
+    bool     ack;               ///< Address and all written bytes acknowledged
+    uint16_t length;
+    uint8_t  data[12];          ///< First bytes
+} twi_fake_transfer_t;
+
+typedef void (*twi_fake_monitor_t)(const twi_fake_transfer_t* transfer);
+
+class TwiFake
+{
+public:
+    static const unsigned MAX_DEVICES = 4;
+
+    static void attach(uint8_t address, TwiFakeDevice* device);
+    static void detachAll();
+    // Number of twi_port_poll() calls returning TWI_PORT_NONE before each bus event
+    static void setLatency(unsigned polls);
+
+    // Fault injection
+    // Next "count" START conditions are not acknowledged (e.g. glitch on address byte)
+    static void failNext(unsigned count);
+    // Slave holds SDA low: no bus event happens until twi_port_recover()
+    static void stickBus();
+    static bool isStuck();
+
+    static void setMonitor(twi_fake_monitor_t monitor);
+
+    // Statistics
+    static unsigned transactions;   ///< START conditions (repeated START included)
+    static unsigned bytes;          ///< Bytes transferred in both directions, address bytes not included
+    static unsigned recoveries;     ///< twi_port_recover() calls
+    static void resetStats() { transactions = bytes = recoveries = 0; }
+};
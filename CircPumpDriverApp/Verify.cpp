@@ -0,0 +1,292 @@
+#include "DateTime.h"
+#include "Verify.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+// Returns number of days since civil 1970-01-01.  Negative values indicate
+//    days prior to 1970-01-01.
+// Preconditions:  y-m-d represents a date in the civil (Gregorian) calendar
+//                 m is in [1, 12]
+//                 d is in [1, last_day_of_month(y, m)]
+//                 y is "approximately" in
+//                   [numeric_limits<Int>::min()/366, numeric_limits<Int>::max()/366]
+//                 Exact range of validity is:
+//                 [civil_from_days(numeric_limits<Int>::min()),
+//                  civil_from_days(numeric_limits<Int>::max()-719468)]
+template <class Int>
+constexpr
+Int
+days_from_civil(Int y, unsigned m, unsigned d) noexcept
+{
+    static_assert(std::numeric_limits<unsigned>::digits >= 18,
+        "This algorithm has not been ported to a 16 bit unsigned integer");
+    static_assert(std::numeric_limits<Int>::digits >= 20,
+        "This algorithm has not been ported to a 16 bit signed integer");
+    y -= m <= 2;
+    const Int era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);      // [0, 399]
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;  // [0, 365]
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;         // [0, 146096]
+    return era * 146097 + static_cast<Int>(doe) - 719468;
+}
+
+// Returns year/month/day triple in civil calendar
+// Preconditions:  z is number of days since 1970-01-01 and is in the range:
+//                   [numeric_limits<Int>::min(), numeric_limits<Int>::max()-719468].
+template <class Int>
+constexpr
+std::tuple<Int, unsigned, unsigned>
+civil_from_days(Int z) noexcept
+{
+    static_assert(std::numeric_limits<unsigned>::digits >= 18,
+        "This algorithm has not been ported to a 16 bit unsigned integer");
+    static_assert(std::numeric_limits<Int>::digits >= 20,
+        "This algorithm has not been ported to a 16 bit signed integer");
+    z += 719468;
+    const Int era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(z - era * 146097);          // [0, 146096]
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;  // [0, 399]
+    const Int y = static_cast<Int>(yoe) + era * 400;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);                // [0, 365]
+    const unsigned mp = (5 * doy + 2) / 153;                                   // [0, 11]
+    const unsigned d = doy - (153 * mp + 2) / 5 + 1;                             // [1, 31]
+    const unsigned m = mp + (mp < 10 ? 3 : -9);                            // [1, 12]
+    return std::tuple<Int, unsigned, unsigned>(y + (m <= 2), m, d);
+}
+
+// Returns day of week in civil calendar [0, 6] -> [Sun, Sat]
+// Preconditions:  z is number of days since 1970-01-01 and is in the range:
+//                   [numeric_limits<Int>::min(), numeric_limits<Int>::max()-4].
+template <class Int>
+constexpr
+unsigned
+weekday_from_days(Int z) noexcept
+{
+    return static_cast<unsigned>(z >= -4 ? (z+4) % 7 : (z+5) % 7 + 6);
+}
+
+static_assert(DateTime::DST_START_NTHSUN == -1 && DateTime::DST_END_NTHSUN == -1, "Reference handles last Sunday only");
+
+// Last Sunday of the month at given UTC hour
+static int64_t lastSunday(int64_t year, unsigned month, unsigned hour)
+{
+    int64_t last = (month == 12) ? days_from_civil<int64_t>(year + 1, 1, 1) - 1 : days_from_civil<int64_t>(year, month + 1, 1) - 1;
+    last -= weekday_from_days(last);
+    return last * DateTime::ONE_DAY + hour * DateTime::ONE_HOUR;
+}
+
+static void fail(verify_result_t* result, verify_check_t check, uint32_t epoch)
+{
+    if (!result->failures[check]++) result->first_failure[check] = epoch;
+}
+
+static void merge(verify_result_t* total, const verify_result_t* part)
+{
+    total->seconds += part->seconds;
+    for (int check = 0; check < VERIFY_CHECKS; check++) {
+        if (!part->failures[check]) continue;
+        if (!total->failures[check] || part->first_failure[check] < total->first_failure[check]) {
+            total->first_failure[check] = part->first_failure[check];
+        }
+        total->failures[check] += part->failures[check];
+    }
+}
+
+const char* Verify::getCheckName(verify_check_t check)
+{
+    static const char* const NAMES[VERIFY_CHECKS] = { "date", "epoch", "weekday", "dst", "local", "round trip" };
+    return (check < VERIFY_CHECKS) ? NAMES[check] : "?";
+}
+
+void Verify::checkRange(uint32_t from, uint32_t until, verify_result_t* result)
+{
+    *result = verify_result_t();
+    if (from > until) return;
+
+    int64_t dst_year = -1, dst_start = 0, dst_end = 0;
+    for (int64_t day = from / DateTime::ONE_DAY; day <= until / DateTime::ONE_DAY; day++) {
+        int64_t year;
+        unsigned month, mday;
+        std::tie(year, month, mday) = civil_from_days(day);
+        // Reference week starts with Sunday, DateTime one with Monday
+        unsigned weekday = (weekday_from_days(day) + 6) % 7;
+        if (year != dst_year) {
+            dst_year = year;
+            dst_start = lastSunday(year, DateTime::DST_START_MONTH, DateTime::DST_START_HOUR);
+            dst_end = lastSunday(year, DateTime::DST_END_MONTH, DateTime::DST_END_HOUR);
+        }
+
+        int64_t day_start = day * DateTime::ONE_DAY;
+        uint32_t first = static_cast<uint32_t>(std::max<int64_t>(from, day_start) - day_start);
+        uint32_t last = static_cast<uint32_t>(std::min<int64_t>(until, day_start + DateTime::ONE_DAY - 1) - day_start);
+        for (uint32_t second = first; second <= last; second++) {
+            uint32_t epoch = static_cast<uint32_t>(day_start + second);
+            uint8_t hour = second / DateTime::ONE_HOUR;
+            uint8_t minute = (second / 60) % 60;
+            uint8_t sec = second % 60;
+
+            dt_date_t date;
+            dt_time_t time;
+            DateTime::setDateTimeFromEpoch(epoch, &date, &time);
+            if (date.year != year || date.month != month || date.day != mday
+                || time.hour != hour || time.minute != minute || time.second != sec) {
+                fail(result, VERIFY_DATE, epoch);
+            }
+
+            // DateTime dates end with 2105
+            uint32_t expected = epoch;
+            if (year > 2105) expected = DateTime::EPOCH_ERROR;
+            if (DateTime::getEpochFromDateTime(year, month, mday, hour, minute, sec) != expected) {
+                fail(result, VERIFY_EPOCH, epoch);
+            }
+
+            if (DateTime::getWeekDayFromEpoch(epoch) != weekday) fail(result, VERIFY_WEEKDAY, epoch);
+
+            bool dst = (epoch >= dst_start && epoch < dst_end);
+            if (DateTime::isUtcInDstTime(epoch) != dst) fail(result, VERIFY_DST, epoch);
+
+            // Local time has to fit too
+            if (epoch > UINT32_MAX - 2 * DateTime::ONE_HOUR) continue;
+            uint32_t offset_hours = DateTime::UTC_OFFSET_HOUR_NORM;
+            if (dst) offset_hours = DateTime::UTC_OFFSET_HOUR_DST;
+            uint32_t local = epoch + offset_hours * DateTime::ONE_HOUR;
+            if (DateTime::getLocalDateTimeFromUtc(epoch) != local) fail(result, VERIFY_LOCAL, epoch);
+
+            bool repeated = (epoch >= dst_end && epoch < dst_end + DateTime::ONE_HOUR);
+            if (DateTime::getUtcDateTimeFromLocal(local) != (repeated ? epoch - DateTime::ONE_HOUR : epoch)) {
+                fail(result, VERIFY_ROUND_TRIP, epoch);
+            }
+        }
+        result->seconds += last - first + 1;
+    }
+}
+
+void Verify::checkRangeParallel(uint32_t from, uint32_t until, unsigned threads, verify_result_t* result)
+{
+    static const uint32_t BLOCK_DAYS = 64;
+    *result = verify_result_t();
+    if (from > until) return;
+    if (!threads) threads = 1;
+
+    uint32_t first_day = from / DateTime::ONE_DAY;
+    uint32_t blocks = (until / DateTime::ONE_DAY - first_day) / BLOCK_DAYS + 1;
+    std::atomic<uint32_t> next(0);
+    std::vector<verify_result_t> results(threads);
+    std::vector<std::thread> workers;
+    for (unsigned id = 0; id < threads; id++) {
+        workers.emplace_back([&, id]() {
+            verify_result_t* total = &results[id];
+            *total = verify_result_t();
+            for (uint32_t block; (block = next++) < blocks; ) {
+                uint64_t block_from = static_cast<uint64_t>(first_day + block * BLOCK_DAYS) * DateTime::ONE_DAY;
+                uint64_t block_until = block_from + BLOCK_DAYS * DateTime::ONE_DAY - 1;
+                verify_result_t part;
+                checkRange(static_cast<uint32_t>(std::max<uint64_t>(block_from, from)),
+                           static_cast<uint32_t>(std::min<uint64_t>(block_until, until)), &part);
+                merge(total, &part);
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+
+    for (const auto& part : results) merge(result, &part);
+}
+
+// =========================================================================================================== Command
+
+// UTC "YYYY-MM-DD HH:MM:SS" by the reference
+static void formatUtc(uint32_t epoch, char* str, size_t size)
+{
+    int64_t year;
+    unsigned month, day;
+    std::tie(year, month, day) = civil_from_days<int64_t>(epoch / DateTime::ONE_DAY);
+    uint32_t second = epoch % DateTime::ONE_DAY;
+    snprintf(str, size, "%04d-%02u-%02u %02u:%02u:%02u", static_cast<int>(year), month, day,
+             second / 3600, (second / 60) % 60, second % 60);
+}
+
+// Days since 1970-01-01 of "YYYY-MM-DD" by the reference, -1 if invalid
+static int64_t parseDay(const char* str)
+{
+    unsigned year, month, day;
+    if (sscanf(str, "%u-%u-%u", &year, &month, &day) != 3 || month < 1 || month > 12 || day < 1 || day > 31) return -1;
+    int64_t days = days_from_civil<int64_t>(year, month, day);
+    return (days >= 0 && days * DateTime::ONE_DAY <= UINT32_MAX) ? days : -1;
+}
+
+/*
+ * verify [--from YYYY-MM-DD] [--until YYYY-MM-DD] [--threads N]
+ * Dates are UTC, both inclusive, by default the whole uint32_t range. Exit code is 1 on any mismatch.
+ */
+int run_verify(int argc, char* argv[])
+{
+    uint32_t from = 0;
+    uint32_t until = UINT32_MAX;
+    unsigned threads = std::thread::hardware_concurrency();
+
+    for (int i = 0; i < argc; i++) {
+        const char* option = argv[i];
+        if (i + 1 == argc) {
+            printf("Missing value: %s\n", option);
+            return 2;
+        }
+        bool ok = true;
+        if (!strcmp(argv[i], "--from")) {
+            int64_t day = parseDay(argv[++i]);
+            ok = (day >= 0);
+            if (ok) from = static_cast<uint32_t>(day * DateTime::ONE_DAY);
+        } else if (!strcmp(argv[i], "--until")) {
+            int64_t day = parseDay(argv[++i]);
+            ok = (day >= 0);
+            if (ok) until = static_cast<uint32_t>(std::min<int64_t>((day + 1) * DateTime::ONE_DAY - 1, UINT32_MAX));
+        } else if (!strcmp(argv[i], "--threads")) {
+            threads = static_cast<unsigned>(atoi(argv[++i]));
+        } else {
+            printf("Unknown option: %s\n", option);
+            return 2;
+        }
+        if (!ok) {
+            printf("Invalid option: %s %s\n", option, argv[i]);
+            return 2;
+        }
+    }
+    if (from > until) {
+        printf("Empty range\n");
+        return 2;
+    }
+
+    verify_result_t result;
+    auto start = std::chrono::steady_clock::now();
+    Verify::checkRangeParallel(from, until, threads, &result);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    char from_str[32], until_str[32];
+    formatUtc(from, from_str, sizeof(from_str));
+    formatUtc(until, until_str, sizeof(until_str));
+    printf("%llu seconds from %s to %s UTC\n", static_cast<unsigned long long>(result.seconds), from_str, until_str);
+
+    bool passed = true;
+    for (int check = 0; check < VERIFY_CHECKS; check++) {
+        const char* name = Verify::getCheckName(static_cast<verify_check_t>(check));
+        if (!result.failures[check]) {
+            printf("%-12s OK\n", name);
+            continue;
+        }
+        char first_str[32];
+        formatUtc(result.first_failure[check], first_str, sizeof(first_str));
+        printf("%-12s %llu mismatches, first at %u (%s UTC)\n", name,
+               static_cast<unsigned long long>(result.failures[check]), result.first_failure[check], first_str);
+        passed = false;
+    }
+    fprintf(stderr, "%u threads, %.2f s\n", threads ? threads : 1, elapsed);
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,40 @@
+#pragma once
+/**
+ * Exhaustive check of DateTime against civil calendar reference algorithms (Howard Hinnant's days_from_civil,
+ * civil_from_days and weekday_from_days) and reference EU DST rule, second by second.
+ * Checked for every UTC second: date and time fields, epoch built back from the reference fields (EPOCH_ERROR
+ * after 2105), week day, DST, local time and its conversion back to UTC. Local time in the hour repeated at the end
+ * of DST is converted to the earlier UTC time, so the later one comes back one hour earlier.
+ */
+#include <stdint.h>
+
+typedef enum
+{
+    VERIFY_DATE,            ///< setDateTimeFromEpoch()
+    VERIFY_EPOCH,           ///< getEpochFromDateTime()
+    VERIFY_WEEKDAY,         ///< getWeekDayFromEpoch()
+    VERIFY_DST,             ///< isUtcInDstTime()
+    VERIFY_LOCAL,           ///< getLocalDateTimeFromUtc()
+    VERIFY_ROUND_TRIP,      ///< getUtcDateTimeFromLocal() of the local time
+    VERIFY_CHECKS
+} verify_check_t;
+
+typedef struct
+{
+    uint64_t seconds;
+    uint64_t failures[VERIFY_CHECKS];
+    uint32_t first_failure[VERIFY_CHECKS];  ///< Valid when there are failures
+} verify_result_t;
+
+class Verify
+{
+public:
+    static const char* getCheckName(verify_check_t check);
+    // Seconds from "from" to "until" inclusive
+    static void checkRange(uint32_t from, uint32_t until, verify_result_t* result);
+    // Range is split into blocks of days taken by threads one by one
+    static void checkRangeParallel(uint32_t from, uint32_t until, unsigned threads, verify_result_t* result);
+};
+
+// "verify" command of the host application
+int run_verify(int argc, char* argv[]);
@@ -1,6 +1,9 @@
 #pragma once
 #include <cstdint>
-uint8_t twi_readFrom(uint8_t, uint8_t*, uint8_t, uint8_t);
-uint8_t twi_writeTo(uint8_t, uint8_t*, uint8_t, uint8_t, uint8_t);
-void twi_init();
-extern int WDTCTL;
\ No newline at end of file
+// Watchdog control register, write without password ( 05Ah in the upper byte) resets the device
+struct wdtctl_reg_t
+{
+    unsigned resets;
+    wdtctl_reg_t& operator=(int value) { if ((value & 0xFF00) != 0x5A00) resets++; return *this; }
+};
+extern wdtctl_reg_t WDTCTL;
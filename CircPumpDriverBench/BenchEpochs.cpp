@@ -0,0 +1,59 @@
+/*
+ * BenchEpochs.cpp
+ *
+ *  Benchmark inputs generated on first use
+ */
+
+#include "BenchEpochs.h"
+#include "DateTime.h"
+
+#include <vector>
+
+static uint64_t random_state = 0x9E3779B97F4A7C15ULL;
+
+// xorshift64*
+static uint32_t nextRandom()
+{
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return static_cast<uint32_t>( (random_state * 0x2545F4914F6CDD1DULL) >> 32 );
+}
+
+// Epochs spread +/-spread around random centers
+static void fill(uint32_t* epochs, const std::vector<uint32_t>& centers, uint32_t spread)
+{
+    for (size_t i = 0; i < BenchEpochs::COUNT; i++) {
+        uint32_t center = centers[nextRandom() % centers.size()];
+        epochs[i] = center - spread + nextRandom() % (2 * spread + 1);
+    }
+}
+
+const uint32_t* BenchEpochs::get(bench_distribution_t distribution)
+{
+    static uint32_t epochs[3][COUNT];
+    static bool ready = false;
+    if (ready) return epochs[distribution];
+
+    const uint32_t first = DateTime::getEpochFromDateTime(2017, 1, 2, 0, 0, 0);
+    const uint32_t last = DateTime::getEpochFromDateTime(2030, 12, 30, 0, 0, 0);
+
+    for (size_t i = 0; i < COUNT; i++) epochs[BENCH_UNIFORM][i] = first + nextRandom() % (last - first);
+
+    std::vector<uint32_t> dst_changes;
+    for (uint32_t t = first; t < last; t += DateTime::ONE_HOUR) {
+        if (DateTime::isUtcInDstTime(t) != DateTime::isUtcInDstTime(t + DateTime::ONE_HOUR)) {
+            dst_changes.push_back(t + DateTime::ONE_HOUR);
+        }
+    }
+    fill(epochs[BENCH_DST], dst_changes, 36 * DateTime::ONE_HOUR);
+
+    std::vector<uint32_t> holidays;
+    for (uint32_t t = first; t < last; t += DateTime::ONE_DAY) {
+        if (DateTime::isHoliday(t)) holidays.push_back(t + DateTime::ONE_DAY / 2);
+    }
+    fill(epochs[BENCH_HOLIDAY], holidays, 36 * DateTime::ONE_HOUR);
+
+    ready = true;
+    return epochs[distribution];
+}
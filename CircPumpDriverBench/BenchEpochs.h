@@ -0,0 +1,35 @@
+/*
+ * BenchEpochs.h
+ *
+ *  Benchmark inputs: UTC epochs from 2017-2030 (range of holidays table), the same in every run.
+ *  Uniform ones cover the whole range, the others are clustered where DateTime takes its slow paths:
+ *  within 36 hours of DST changes and within a day of holidays.
+ */
+
+#ifndef BENCHEPOCHS_H_
+#define BENCHEPOCHS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef enum
+{
+    BENCH_UNIFORM,
+    BENCH_DST,
+    BENCH_HOLIDAY,
+} bench_distribution_t;
+
+class BenchEpochs
+{
+public:
+    static const size_t COUNT = 4096;       ///< Power of 2, so benchmarks cycle with a mask
+
+    static const uint32_t* get(bench_distribution_t distribution);
+};
+
+// Registers benchmark "_fn_(benchmark::State&, bench_distribution_t)" for every distribution
+#define BENCHMARK_EPOCHS(_fn_)  BENCHMARK_CAPTURE(_fn_, uniform, BENCH_UNIFORM); \
+                                BENCHMARK_CAPTURE(_fn_, dst,     BENCH_DST); \
+                                BENCHMARK_CAPTURE(_fn_, holiday, BENCH_HOLIDAY)
+
+#endif /* BENCHEPOCHS_H_ */
@@ -0,0 +1,29 @@
+/*
+ * CircShedule_bench.cpp
+ *
+ *  Lookup of the next on-window in the firmware tables
+ */
+
+#include <benchmark/benchmark.h>
+#include "CircPumpConfig.h"
+#include "BenchEpochs.h"
+
+#include <vector>
+
+// Firmware passes local time
+static void getNextOnTime(benchmark::State& state, const circ_shedule_table_t* shedule_table, bench_distribution_t distribution)
+{
+    const uint32_t* epochs = BenchEpochs::get(distribution);
+    std::vector<uint32_t> local(BenchEpochs::COUNT);
+    for (size_t i = 0; i < BenchEpochs::COUNT; i++) local[i] = DateTime::getLocalDateTimeFromUtc(epochs[i]);
+
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(CircShedule::getNextOnTime(shedule_table, local[i++ & (BenchEpochs::COUNT - 1)]));
+    }
+}
+BENCHMARK_CAPTURE(getNextOnTime, workweek_uniform,  &workweek_shedule_table,  BENCH_UNIFORM);
+BENCHMARK_CAPTURE(getNextOnTime, workweek_dst,      &workweek_shedule_table,  BENCH_DST);
+BENCHMARK_CAPTURE(getNextOnTime, workweek_holiday,  &workweek_shedule_table,  BENCH_HOLIDAY);
+BENCHMARK_CAPTURE(getNextOnTime, vacations_uniform, &vacations_shedule_table, BENCH_UNIFORM);
+BENCHMARK_CAPTURE(getNextOnTime, vacations_holiday, &vacations_shedule_table, BENCH_HOLIDAY);
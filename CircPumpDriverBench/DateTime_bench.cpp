@@ -0,0 +1,126 @@
+/*
+ * DateTime_bench.cpp
+ *
+ *  Epoch conversions, holiday and DST lookups, date parsing
+ */
+
+#include <benchmark/benchmark.h>
+#include "DateTime.h"
+#include "BenchEpochs.h"
+
+#include <stdio.h>
+#include <vector>
+#include <string>
+
+static void setDateTimeFromEpoch(benchmark::State& state, bench_distribution_t distribution)
+{
+    const uint32_t* epochs = BenchEpochs::get(distribution);
+    dt_date_t date;
+    dt_time_t time;
+    size_t i = 0;
+    for (auto _ : state) {
+        DateTime::setDateTimeFromEpoch(epochs[i++ & (BenchEpochs::COUNT - 1)], &date, &time);
+        benchmark::DoNotOptimize(date);
+        benchmark::DoNotOptimize(time);
+    }
+}
+BENCHMARK_EPOCHS(setDateTimeFromEpoch);
+
+static void getEpochFromDateTime(benchmark::State& state, bench_distribution_t distribution)
+{
+    const uint32_t* epochs = BenchEpochs::get(distribution);
+    std::vector<dt_date_t> dates(BenchEpochs::COUNT);
+    std::vector<dt_time_t> times(BenchEpochs::COUNT);
+    for (size_t i = 0; i < BenchEpochs::COUNT; i++) DateTime::setDateTimeFromEpoch(epochs[i], &dates[i], &times[i]);
+
+    size_t i = 0;
+    for (auto _ : state) {
+        size_t n = i++ & (BenchEpochs::COUNT - 1);
+        benchmark::DoNotOptimize(DateTime::getEpochFromDateTime(&dates[n], &times[n]));
+    }
+}
+BENCHMARK_EPOCHS(getEpochFromDateTime);
+
+static void isHoliday(benchmark::State& state, bench_distribution_t distribution)
+{
+    const uint32_t* epochs = BenchEpochs::get(distribution);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(DateTime::isHoliday(epochs[i++ & (BenchEpochs::COUNT - 1)]));
+    }
+}
+BENCHMARK_EPOCHS(isHoliday);
+
+static void getDayTypeFromEpoch(benchmark::State& state, bench_distribution_t distribution)
+{
+    const uint32_t* epochs = BenchEpochs::get(distribution);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(DateTime::getDayTypeFromEpoch(epochs[i++ & (BenchEpochs::COUNT - 1)]));
+    }
+}
+BENCHMARK_EPOCHS(getDayTypeFromEpoch);
+
+static void isUtcInDstTime(benchmark::State& state, bench_distribution_t distribution)
+{
+    const uint32_t* epochs = BenchEpochs::get(distribution);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(DateTime::isUtcInDstTime(epochs[i++ & (BenchEpochs::COUNT - 1)]));
+    }
+}
+BENCHMARK_EPOCHS(isUtcInDstTime);
+
+static void getLocalDateTimeFromUtc(benchmark::State& state, bench_distribution_t distribution)
+{
+    const uint32_t* epochs = BenchEpochs::get(distribution);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(DateTime::getLocalDateTimeFromUtc(epochs[i++ & (BenchEpochs::COUNT - 1)]));
+    }
+}
+BENCHMARK_EPOCHS(getLocalDateTimeFromUtc);
+
+static void getUtcDateTimeFromLocal(benchmark::State& state, bench_distribution_t distribution)
+{
+    const uint32_t* epochs = BenchEpochs::get(distribution);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(DateTime::getUtcDateTimeFromLocal(epochs[i++ & (BenchEpochs::COUNT - 1)]));
+    }
+}
+BENCHMARK_EPOCHS(getUtcDateTimeFromLocal);
+
+// Dates in every format accepted by getDateFromStr(), e.g. the one of __DATE__
+static void getDateFromStr(benchmark::State& state, bench_distribution_t distribution)
+{
+    const uint32_t* epochs = BenchEpochs::get(distribution);
+    std::vector<std::string> strings(BenchEpochs::COUNT);
+    for (size_t i = 0; i < BenchEpochs::COUNT; i++) {
+        dt_date_t date;
+        dt_time_t time;
+        DateTime::setDateTimeFromEpoch(epochs[i], &date, &time);
+        const char* month = DateTime::getMonthAbbrev(static_cast<DateTime::MONTHS>(date.month));
+        char str[32];
+        switch (i % 4) {
+        case 0:  snprintf(str, sizeof(str), "%u-%s-%u", date.year, month, date.day); break;
+        case 1:  snprintf(str, sizeof(str), "%u.%s.%u", date.day, month, date.year); break;
+        case 2:  snprintf(str, sizeof(str), "%s %2u %u", month, date.day, date.year); break;
+        default: snprintf(str, sizeof(str), "%u/%s/%u", date.day, month, date.year); break;
+        }
+        dt_date_t parsed;
+        if (!DateTime::getDateFromStr(str, &parsed) || !DateTime::areDatesEqual(&date, &parsed)) {
+            state.SkipWithError(str);
+            return;
+        }
+        strings[i] = str;
+    }
+
+    dt_date_t date;
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(DateTime::getDateFromStr(strings[i++ & (BenchEpochs::COUNT - 1)].c_str(), &date));
+        benchmark::DoNotOptimize(date);
+    }
+}
+BENCHMARK_EPOCHS(getDateFromStr);
@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+"""
+Compares Google Benchmark JSON results with the stored baseline.
+
+    CircPumpDriverBench --benchmark_repetitions=10 --benchmark_enable_random_interleaving=true \\
+                        --benchmark_report_aggregates_only=true --benchmark_out=current.json --benchmark_out_format=json
+    compare_baseline.py baseline.json current.json [--threshold 15]
+
+CPU time is compared, median of repetitions when present. Exits with 1 when any benchmark is slower than the
+baseline by more than threshold percent or is missing from the current results.
+Baseline is rewritten by running the benchmark as above with --benchmark_out=baseline.json on the reference machine.
+On the single CPU reference VM back-to-back medians of 5 plain repetitions differ by up to 33%, with 10 interleaved
+repetitions by less than 10%, so fewer repetitions or a lower threshold report noise as slowdowns.
+"""
+import argparse
+import json
+import sys
+
+# msp430/msp430_bench.py reports CPU cycles
+TIME_UNITS = {'ns': 1.0, 'us': 1e3, 'ms': 1e6, 's': 1e9, 'cycles': 1.0}
+
+
+def load(path):
+    with open(path) as f:
+        benchmarks = json.load(f)['benchmarks']
+    times = {}
+    for b in benchmarks:
+        if b.get('error_occurred'):
+            continue
+        aggregate = b.get('aggregate_name')
+        if aggregate not in (None, 'median'):
+            continue
+        name = b.get('run_name', b['name'])
+        # Median wins over single runs
+        if name in times and aggregate is None:
+            continue
+        times[name] = b['cpu_time'] * TIME_UNITS[b.get('time_unit', 'ns')]
+    return times
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compare benchmark results with baseline')
+    parser.add_argument('baseline')
+    parser.add_argument('current')
+    parser.add_argument('--threshold', type=float, default=15.0, help='allowed slowdown in percent')
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    current = load(args.current)
+
+    failed = False
+    print('%-40s %12s %12s %8s' % ('Benchmark', 'Baseline', 'Current', 'Change'))
+    for name, base in baseline.items():
+        if name not in current:
+            print('%-40s %12.1f %12s %8s  MISSING' % (name, base, '-', '-'))
+            failed = True
+            continue
+        change = (current[name] - base) * 100.0 / base
+        slower = change > args.threshold
+        failed |= slower
+        print('%-40s %12.1f %12.1f %+7.1f%%%s' % (name, base, current[name], change, '  SLOWER' if slower else ''))
+    for name in current:
+        if name not in baseline:
+            print('%-40s %12s %12.1f %8s  NEW' % (name, '-', current[name], '-'))
+
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
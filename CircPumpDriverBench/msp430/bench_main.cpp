@@ -0,0 +1,185 @@
+/*
+ * bench_main.cpp
+ *
+ *  On-target benchmark of the core modules, run by msp430_bench.py in mspdebug simulator.
+ *  Cycles are counted by Timer0_A from SMCLK, which the simulator clocks with CPU cycles.
+ *  Every "bench_result_<name>" variable holds results of one benchmark, the runner finds them in the symbol table
+ *  and reads them after bench_done() is reached. Cost of the empty call is already subtracted.
+ */
+
+#include <msp430.h>
+#include "DateTime.h"
+#include "CircPumpConfig.h"
+#include "DS3231Drv.h"
+
+static const uint16_t BENCH_CALLS = 64;
+
+typedef struct
+{
+    uint16_t calls;
+    uint32_t min;   ///< Cycles
+    uint32_t max;
+    uint32_t sum;
+} bench_result_t;
+
+#define BENCH_RESULT(_name_) bench_result_t bench_result_##_name_
+
+typedef DS3231DrvT<MemoryI2cBus> Drv;
+
+static uint32_t          random_state = 2463534242UL;
+static uint32_t          overhead;
+static uint16_t          input_index;
+static uint32_t          input_epoch;
+static uint32_t          input_local;
+static dt_date_t         input_date;
+static dt_time_t         input_time;
+static DS3231_snapshot_t snapshot;
+static volatile uint32_t sink;      ///< Keeps results of calls
+
+static const char* const DATE_STRINGS[] = { "Oct 29 2017", "2016-Apr-16", "16.Apr.2016", "16/apr/2016" };
+
+// Breakpoint of the runner
+extern "C" void __attribute__((noinline)) bench_done()
+{
+    __asm__ __volatile__("");
+}
+
+// ============================================================================================================ Inputs
+
+// xorshift32
+static uint32_t nextRandom()
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+static uint32_t uniformEpoch()
+{
+    static const uint32_t FIRST = 1483315200UL;    // 2017-01-02
+    static const uint32_t LAST  = 1924819200UL;    // 2030-12-30
+    return FIRST + nextRandom() % (LAST - FIRST);
+}
+
+static uint32_t aroundEpoch(uint32_t center)
+{
+    static const uint32_t SPREAD = 36 * DateTime::ONE_HOUR;
+    return center - SPREAD + nextRandom() % (2 * SPREAD);
+}
+
+static uint32_t dstEpoch()
+{
+    uint16_t year = 2017 + nextRandom() % 14;
+    return aroundEpoch( (nextRandom() & 1)
+        ? DateTime::getDstEpoch(year, DateTime::DST_START_MONTH, DateTime::DST_START_NTHSUN, DateTime::DST_START_HOUR)
+        : DateTime::getDstEpoch(year, DateTime::DST_END_MONTH, DateTime::DST_END_NTHSUN, DateTime::DST_END_HOUR) );
+}
+
+// Christmas and New Year
+static uint32_t holidayEpoch()
+{
+    uint16_t year = 2017 + nextRandom() % 13;
+    return aroundEpoch( (nextRandom() & 1)
+        ? DateTime::getEpochFromDateTime(year, DateTime::DECEMBER, 25, 12, 0, 0)
+        : DateTime::getEpochFromDateTime(year + 1, DateTime::JANUARY, 1, 12, 0, 0) );
+}
+
+// ============================================================================================================= Cases
+
+// Not inlined, so each case pays the same call overhead
+static void __attribute__((noinline)) emptyCall() {}
+
+static void setDateTimeFromEpoch()    { DateTime::setDateTimeFromEpoch(input_epoch, &input_date, &input_time); }
+static void getEpochFromDateTime()    { sink = DateTime::getEpochFromDateTime(&input_date, &input_time); }
+static void isHoliday()               { sink = DateTime::isHoliday(input_epoch); }
+static void getDayTypeFromEpoch()     { sink = DateTime::getDayTypeFromEpoch(input_epoch); }
+static void isUtcInDstTime()          { sink = DateTime::isUtcInDstTime(input_epoch); }
+static void getLocalDateTimeFromUtc() { sink = DateTime::getLocalDateTimeFromUtc(input_epoch); }
+static void getUtcDateTimeFromLocal() { sink = DateTime::getUtcDateTimeFromLocal(input_local); }
+static void getDateFromStr()          { sink = DateTime::getDateFromStr(DATE_STRINGS[input_index & 3], &input_date); }
+static void getNextOnTime()           { sink = CircShedule::getNextOnTime(&workweek_shedule_table, input_local); }
+static void setDateTime()             { sink = Drv::setDateTime(input_epoch); }
+static void readSnapshot()            { sink = Drv::readSnapshot(&snapshot, true); }
+static void setAlarm1()               { sink = Drv::setAlarm1(0, input_time.hour, input_time.minute, input_time.second, DS3231_MATCH_H_M_S); }
+
+// ============================================================================================================ Runner
+
+static uint32_t __attribute__((noinline)) measure(void (*call)())
+{
+    TA0CTL = TASSEL_2 | ID_0 | MC_2 | TACLR;    // SMCLK, continuous mode, TAIFG cleared
+    call();
+    uint16_t ticks = TA0R;
+    if (!(TA0CTL & TAIFG)) return ticks;
+
+    // Longer than 65535 cycles, again with SMCLK/8
+    TA0CTL = TASSEL_2 | ID_3 | MC_2 | TACLR;
+    call();
+    return static_cast<uint32_t>(TA0R) << 3;
+}
+
+static void __attribute__((noinline)) run(bench_result_t* result, void (*call)(), uint32_t (*input)())
+{
+    result->min = UINT32_MAX;
+    for (input_index = 0; input_index < BENCH_CALLS; input_index++) {
+        input_epoch = input();
+        input_local = DateTime::getLocalDateTimeFromUtc(input_epoch);
+        DateTime::setDateTimeFromEpoch(input_epoch, &input_date, &input_time);
+
+        uint32_t cycles = measure(call);
+        cycles = (cycles > overhead) ? cycles - overhead : 0;
+        if (cycles < result->min) result->min = cycles;
+        if (cycles > result->max) result->max = cycles;
+        result->sum += cycles;
+        result->calls++;
+    }
+}
+
+BENCH_RESULT(setDateTimeFromEpoch);
+BENCH_RESULT(getEpochFromDateTime);
+BENCH_RESULT(isHoliday_uniform);
+BENCH_RESULT(isHoliday_holiday);
+BENCH_RESULT(getDayTypeFromEpoch);
+BENCH_RESULT(isUtcInDstTime_uniform);
+BENCH_RESULT(isUtcInDstTime_dst);
+BENCH_RESULT(getLocalDateTimeFromUtc);
+BENCH_RESULT(getUtcDateTimeFromLocal);
+BENCH_RESULT(getDateFromStr);
+BENCH_RESULT(getNextOnTime_uniform);
+BENCH_RESULT(getNextOnTime_holiday);
+BENCH_RESULT(DS3231_setDateTime);
+BENCH_RESULT(DS3231_readSnapshot);
+BENCH_RESULT(DS3231_setAlarm1);
+
+int main()
+{
+    WDTCTL = WDTPW | WDTHOLD;
+
+    overhead = UINT32_MAX;
+    for (uint8_t i = 0; i < 8; i++) {
+        uint32_t cycles = measure(emptyCall);
+        if (cycles < overhead) overhead = cycles;
+    }
+
+    run(&bench_result_setDateTimeFromEpoch,    setDateTimeFromEpoch,    uniformEpoch);
+    run(&bench_result_getEpochFromDateTime,    getEpochFromDateTime,    uniformEpoch);
+    run(&bench_result_isHoliday_uniform,       isHoliday,               uniformEpoch);
+    run(&bench_result_isHoliday_holiday,       isHoliday,               holidayEpoch);
+    run(&bench_result_getDayTypeFromEpoch,     getDayTypeFromEpoch,     uniformEpoch);
+    run(&bench_result_isUtcInDstTime_uniform,  isUtcInDstTime,          uniformEpoch);
+    run(&bench_result_isUtcInDstTime_dst,      isUtcInDstTime,          dstEpoch);
+    run(&bench_result_getLocalDateTimeFromUtc, getLocalDateTimeFromUtc, dstEpoch);
+    run(&bench_result_getUtcDateTimeFromLocal, getUtcDateTimeFromLocal, dstEpoch);
+    run(&bench_result_getDateFromStr,          getDateFromStr,          uniformEpoch);
+    run(&bench_result_getNextOnTime_uniform,   getNextOnTime,           uniformEpoch);
+    run(&bench_result_getNextOnTime_holiday,   getNextOnTime,           holidayEpoch);
+
+    MemoryI2cBus::reset(0x68);
+    Drv::begin();
+    run(&bench_result_DS3231_setDateTime,      setDateTime,             uniformEpoch);
+    run(&bench_result_DS3231_readSnapshot,     readSnapshot,            uniformEpoch);
+    run(&bench_result_DS3231_setAlarm1,        setAlarm1,               uniformEpoch);
+
+    bench_done();
+    for (;;) {}
+}
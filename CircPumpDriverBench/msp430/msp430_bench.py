@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+"""
+Builds bench_main.cpp with the core modules for MSP430G2553 and runs it in mspdebug simulator.
+Reports cycles per call and flash/RAM footprint of every function and variable of the image.
+
+    msp430_bench.py [--prefix msp430-elf-] [--cflags "-I/path/to/msp430/include -L/path/to/msp430/include"]
+                    [--mspdebug mspdebug] [--out msp430.json]
+
+Needs msp430-gcc (TI msp430-elf-gcc or the older mspgcc with --prefix msp430-) and mspdebug with simio timer.
+The JSON has Google Benchmark layout with mean cycles as cpu_time, so ../compare_baseline.py compares two runs.
+"""
+import argparse
+import json
+import os
+import re
+import shlex
+import struct
+import subprocess
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+FIRMWARE = os.path.join(HERE, '..', '..', 'CircPumpDriver')
+SOURCES = [os.path.join(HERE, 'bench_main.cpp')] + \
+          [os.path.join(FIRMWARE, name) for name in ('DateTime.cpp', 'CircShedule.cpp', 'DS3231Drv.cpp',
+                                                     'I2cBus.cpp', 'TwiAsync.cpp')]
+# As built by Energia, plus in-memory DS3231 bus
+CFLAGS = ['-mmcu=msp430g2553', '-Os', '-std=gnu++11', '-fno-exceptions', '-fno-rtti', '-ffunction-sections',
+          '-fdata-sections', '-Wl,--gc-sections', '-DMEMORY_I2C_BUS', '-DMEMORY_I2C_BUS_SIZE=32', '-I' + FIRMWARE]
+RESULT_PREFIX = 'bench_result_'
+RESULT_FORMAT = '<HIII'     # bench_result_t: calls, min, max, sum
+TIMER0_A3_BASE = 0x160
+
+FLASH_TYPES = 'TtRrDd'      # Initialized data takes both
+RAM_TYPES = 'DdBb'
+
+
+def run(command):
+    result = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+    if result.returncode:
+        sys.stderr.write(result.stdout)
+        sys.exit('Failed: ' + ' '.join(command))
+    return result.stdout
+
+
+def symbols(prefix, elf):
+    """(address, size, type, name) of every sized symbol"""
+    out = []
+    for line in run([prefix + 'nm', '-S', '-C', '--size-sort', elf]).splitlines():
+        fields = line.split(None, 3)
+        if len(fields) == 4:
+            out.append((int(fields[0], 16), int(fields[1], 16), fields[2], fields[3]))
+    return out
+
+
+def memory_dump(text):
+    """Bytes by address from mspdebug "md" output: "    0200: 40 00 ... |@.|" """
+    memory = {}
+    for line in text.splitlines():
+        match = re.match(r'\s*(?:0x)?([0-9a-fA-F]+):((?:\s[0-9a-fA-F]{2})+)', line)
+        if not match:
+            continue
+        address = int(match.group(1), 16)
+        for offset, byte in enumerate(match.group(2).split()):
+            memory[address + offset] = int(byte, 16)
+    return memory
+
+
+def simulate(mspdebug, elf, results):
+    commands = ['simio add timer ta0', 'simio config ta0 base 0x%x' % TIMER0_A3_BASE,
+                'prog ' + elf, 'setbreak bench_done', 'run']
+    commands += ['md 0x%x %d' % (address, size) for address, size, _, _ in results]
+    memory = memory_dump(run([mspdebug, '-q', 'sim'] + commands))
+
+    benchmarks = []
+    for address, size, _, name in results:
+        data = bytes(memory.get(address + i, 0) for i in range(size))
+        calls, minimum, maximum, total = struct.unpack(RESULT_FORMAT, data)
+        benchmarks.append({'name': name[len(RESULT_PREFIX):], 'run_type': 'iteration', 'iterations': calls,
+                           'cpu_time': float(total) / calls if calls else 0.0, 'real_time': 0.0,
+                           'min_cycles': minimum, 'max_cycles': maximum, 'time_unit': 'cycles'})
+    if not any(b['iterations'] for b in benchmarks):
+        sys.exit('bench_done() not reached')
+    if not any(b['cpu_time'] for b in benchmarks):
+        sys.exit('Timer0_A not counting, check "simio add timer" support of mspdebug')
+    return benchmarks
+
+
+def main():
+    parser = argparse.ArgumentParser(description='MSP430 cycle and footprint benchmark in mspdebug simulator')
+    parser.add_argument('--prefix', default='msp430-elf-', help='toolchain prefix')
+    parser.add_argument('--cflags', default='', help='extra compiler and linker flags')
+    parser.add_argument('--mspdebug', default='mspdebug')
+    parser.add_argument('--elf', default='msp430_bench.elf')
+    parser.add_argument('--out', help='JSON results')
+    args = parser.parse_args()
+
+    run([args.prefix + 'g++'] + CFLAGS + shlex.split(args.cflags) + SOURCES + ['-o', args.elf])
+    image = symbols(args.prefix, args.elf)
+
+    results = sorted(s for s in image if s[3].startswith(RESULT_PREFIX))
+    if any(size != struct.calcsize(RESULT_FORMAT) for _, size, _, _ in results):
+        sys.exit('bench_result_t layout differs from ' + RESULT_FORMAT)
+    benchmarks = simulate(args.mspdebug, args.elf, results)
+
+    print('%-32s %10s %10s %10s' % ('Benchmark', 'Mean', 'Min', 'Max'))
+    for b in benchmarks:
+        print('%-32s %10.0f %10d %10d' % (b['name'], b['cpu_time'], b['min_cycles'], b['max_cycles']))
+
+    footprint = [{'name': name, 'type': kind,
+                  'flash': size if kind in FLASH_TYPES else 0, 'ram': size if kind in RAM_TYPES else 0}
+                 for _, size, kind, name in sorted(image, key=lambda s: -s[1])]
+    print('\n%-64s %6s %6s' % ('Symbol', 'Flash', 'RAM'))
+    for f in footprint:
+        print('%-64s %6d %6d' % (f['name'][:64], f['flash'], f['ram']))
+    print('%-64s %6d %6d' % ('Total', sum(f['flash'] for f in footprint), sum(f['ram'] for f in footprint)))
+
+    if args.out:
+        with open(args.out, 'w') as f:
+            json.dump({'context': {'executable': args.elf, 'mcu': 'msp430g2553'},
+                       'benchmarks': benchmarks, 'footprint': footprint}, f, indent=2)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,146 @@
+/*
+ * CircAdaptive_test.cpp
+ *
+ *  Learning of on-windows from demands, on flash emulated by FlashStore
+ */
+
+#include <gtest/gtest.h>
+#include "CircAdaptive.h"
+#include "FlashStore.h"
+
+static const circ_adaptive_config_t config = { 8, 2, 1, 10 * 60 };
+
+static const circ_shedule_table_t default_table = {
+        /* Monday */    { { CT( 6, 0, 0 ), CT( 22, 0, 0 ) }, },
+        /* Tuesday */   { { CT( 6, 0, 0 ), CT( 22, 0, 0 ) }, },
+        /* Wednesday */ { { CT( 6, 0, 0 ), CT( 22, 0, 0 ) }, },
+        /* Thursay */   { { CT( 6, 0, 0 ), CT( 22, 0, 0 ) }, },
+        /* Friday */    { { CT( 6, 0, 0 ), CT( 22, 0, 0 ) }, },
+        /* Saturday */  { { CT( 8, 0, 0 ), CT( 22, 0, 0 ) }, },
+        /* Sunday */    { { CT( 8, 0, 0 ), CT( 22, 0, 0 ) }, },
+        /* Holiday */   { { CT( 8, 0, 0 ), CT( 22, 0, 0 ) }, }
+};
+
+static void compact()
+{
+    ASSERT_TRUE(CircAdaptive::startCompaction());
+    for (int i = 0; i < DateTime::DAYS_COUNT; i++) ASSERT_FALSE(CircAdaptive::compactStep());
+    ASSERT_TRUE(CircAdaptive::compactStep());
+}
+
+TEST(CircAdaptive,fitDay)
+{
+    uint8_t counts[CIRC_ADAPTIVE_BINS] = {};
+    circ_shedule_day_t windows;
+
+    // 0:00-0:30 and 7:00-8:00 with one bin gap merged, 19:00 not enough demands
+    counts[0] = 2;
+    counts[14] = 3;
+    counts[16] = 2;
+    counts[38] = 1;
+    CircAdaptive::fitDay(counts, &config, windows);
+    EXPECT_EQ(0, windows[0].beg);
+    EXPECT_EQ(CT( 0, 30, 0), windows[0].end);
+    EXPECT_EQ(CT( 6, 50, 0), windows[1].beg);
+    EXPECT_EQ(CT( 8, 30, 0), windows[1].end);
+    EXPECT_EQ(0, windows[2].end);
+
+    // Fourth window, the two closest are merged
+    counts[38] = 2;
+    counts[44] = 8;
+    counts[47] = 8;
+    CircAdaptive::fitDay(counts, &config, windows);
+    EXPECT_EQ(CT( 6, 50, 0), windows[1].beg);
+    EXPECT_EQ(CT(18, 50, 0), windows[2].beg);
+    EXPECT_EQ(CT(24,  0, 0), windows[2].end);
+
+    // Nothing to learn
+    for (auto& c : counts) c = 1;
+    CircAdaptive::fitDay(counts, &config, windows);
+    EXPECT_EQ(0, windows[0].beg);
+    EXPECT_EQ(0, windows[0].end);
+}
+
+TEST(CircAdaptive,learning)
+{
+    FlashStore::reset();
+    ASSERT_TRUE(CircAdaptive::begin(&default_table, &config));
+    ASSERT_EQ(0, memcmp(CircAdaptive::getTable(), &default_table, sizeof(default_table)));
+
+    // Four Mondays 2017-01-09 .. 2017-01-30, 7:10 and 19:40, compacted every day
+    for (int week = 0; week < 4; week++) {
+        const uint32_t monday = DateTime::getEpochFromDateTime(2017, 1, 9 + 7 * week, 0, 0, 0);
+        ASSERT_TRUE(CircAdaptive::record(monday + 7 * DateTime::ONE_HOUR + 10 * 60));
+        ASSERT_TRUE(CircAdaptive::record(monday + 19 * DateTime::ONE_HOUR + 40 * 60));
+        compact();
+    }
+    EXPECT_EQ(4, CircAdaptive::getCount(DateTime::MONDAY, 14));
+    EXPECT_TRUE(CircAdaptive::isLearned(DateTime::MONDAY));
+    EXPECT_FALSE(CircAdaptive::isLearned(DateTime::TUESDAY));
+
+    const circ_shedule_table_t* table = CircAdaptive::getTable();
+    EXPECT_EQ(CT( 7,  0, 0) - CT(0, 10, 0), (*table)[DateTime::MONDAY][0].beg);
+    EXPECT_EQ(CT( 7, 30, 0), (*table)[DateTime::MONDAY][0].end);
+    EXPECT_EQ(CT(19, 20, 0), (*table)[DateTime::MONDAY][1].beg);
+    EXPECT_EQ(CT(20,  0, 0), (*table)[DateTime::MONDAY][1].end);
+    EXPECT_EQ(0, memcmp(&(*table)[DateTime::TUESDAY], &default_table[DateTime::TUESDAY], sizeof(circ_shedule_day_t)));
+
+    // Unary counters never need erase, one erase per compaction
+    EXPECT_EQ(0u, FlashStore::overwrites);
+    EXPECT_EQ(5u, FlashStore::erases);
+}
+
+TEST(CircAdaptive,power_loss)
+{
+    FlashStore::reset();
+    ASSERT_TRUE(CircAdaptive::begin(&default_table, &config));
+    const uint32_t monday = DateTime::getEpochFromDateTime(2017, 1, 9, 7, 10, 0);
+    compact();
+    const circ_adaptive_page_t* page = CircAdaptive::getPage();
+
+    // Demand recorded during compaction goes to both pages, whatever the compaction has done with its day
+    ASSERT_TRUE(CircAdaptive::startCompaction());
+    ASSERT_FALSE(CircAdaptive::compactStep());
+    ASSERT_FALSE(CircAdaptive::compactStep());
+    ASSERT_TRUE(CircAdaptive::record(monday));
+    ASSERT_TRUE(CircAdaptive::record(monday + DateTime::ONE_DAY));
+    ASSERT_TRUE(CircAdaptive::record(monday + DateTime::ONE_DAY + DateTime::ONE_HOUR));
+    EXPECT_EQ(1, CircAdaptive::getCount(DateTime::TUESDAY, 16));
+
+    // Reset before the new page is complete, demand of the current bin is lost
+    ASSERT_TRUE(CircAdaptive::begin(&default_table, &config));
+    EXPECT_EQ(page, CircAdaptive::getPage());
+    EXPECT_EQ(1, CircAdaptive::getCount(DateTime::MONDAY, 14));
+    EXPECT_EQ(1, CircAdaptive::getCount(DateTime::TUESDAY, 14));
+    EXPECT_EQ(0, CircAdaptive::getCount(DateTime::TUESDAY, 16));
+
+    compact();
+    EXPECT_NE(page, CircAdaptive::getPage());
+    EXPECT_EQ(1, CircAdaptive::getCount(DateTime::MONDAY, 14));
+    EXPECT_EQ(1, CircAdaptive::getCount(DateTime::TUESDAY, 14));
+
+    // Saturated bin halves all counts
+    for (int i = 0; i < 8; i++) CircAdaptive::record(monday);
+    EXPECT_FALSE(CircAdaptive::record(monday));
+    EXPECT_EQ(CIRC_ADAPTIVE_MAX_COUNT, CircAdaptive::getCount(DateTime::MONDAY, 14));
+    compact();
+    EXPECT_EQ(4, CircAdaptive::getCount(DateTime::MONDAY, 14));
+    EXPECT_EQ(1, CircAdaptive::getCount(DateTime::TUESDAY, 14));
+    EXPECT_EQ(0u, FlashStore::overwrites);
+}
+
+TEST(CircAdaptive,flash_wear)
+{
+    FlashStore::reset();
+    ASSERT_TRUE(CircAdaptive::begin(&default_table, &config));
+
+    // Flow switch chattering all day long for two weeks, compacted every night
+    const uint32_t monday = DateTime::getEpochFromDateTime(2017, 1, 9, 0, 0, 0);
+    for (uint32_t time = monday; time < monday + 14 * DateTime::ONE_DAY; time += 20) {
+        CircAdaptive::record(time);
+        if (time % DateTime::ONE_DAY == 3 * DateTime::ONE_HOUR) compact();
+    }
+    EXPECT_EQ(CIRC_ADAPTIVE_MAX_COUNT, CircAdaptive::getCount(DateTime::SUNDAY, 14));
+    EXPECT_LE(FlashStore::max_block_writes, static_cast<uint16_t>(FlashStore::BLOCK_WRITES_MAX));
+    EXPECT_EQ(0u, FlashStore::overwrites);
+}
@@ -0,0 +1,77 @@
+/*
+ * CircEventQueue_test.cpp
+ *
+ *  Ordering of pump events of several zones and selection of the alarm which signals them
+ */
+
+#include <gtest/gtest.h>
+#include "CircEventQueue.h"
+
+static const uint32_t T0 = 1509235200UL;   // 2017-10-29 00:00:00
+
+TEST(CircEventQueue,order)
+{
+    circ_event_queue_t queue;
+    CircEventQueue::clear(&queue);
+    ASSERT_EQ(nullptr, CircEventQueue::getHead(&queue));
+
+    ASSERT_TRUE(CircEventQueue::insert(&queue, T0 + 600, true, 0));
+    ASSERT_TRUE(CircEventQueue::insert(&queue, T0 + 300, false, 1));
+    ASSERT_TRUE(CircEventQueue::insert(&queue, T0 + 600, false, 1));
+    ASSERT_FALSE(CircEventQueue::insert(&queue, DateTime::EPOCH_ERROR, true, 0));
+    ASSERT_EQ(3, queue.count);
+    ASSERT_EQ(2, CircEventQueue::getZoneCount(&queue, 1));
+
+    // Same time keeps insertion order
+    ASSERT_EQ(T0 + 300, CircEventQueue::getHead(&queue)->time);
+    ASSERT_EQ(1, queue.events[0].zone);
+    ASSERT_EQ(0, queue.events[1].zone);
+    ASSERT_EQ(1, queue.events[2].zone);
+    ASSERT_FALSE(queue.events[2].on);
+
+    ASSERT_TRUE(CircEventQueue::insert(&queue, T0 + 900, true, 0));
+    ASSERT_TRUE(CircEventQueue::isFull(&queue));
+    ASSERT_FALSE(CircEventQueue::insert(&queue, T0 + 1200, true, 0));
+
+    CircEventQueue::pop(&queue);
+    ASSERT_EQ(T0 + 300, queue.last_time);
+    ASSERT_EQ(0, CircEventQueue::getHead(&queue)->zone);
+    ASSERT_EQ(1, CircEventQueue::getZoneCount(&queue, 1));
+    ASSERT_EQ(T0 + 900, queue.events[2].time);
+}
+
+TEST(CircEventQueue,minute_alarm)
+{
+    circ_event_queue_t queue;
+    CircEventQueue::clear(&queue);
+
+    // Nothing fired before the first event, it needs Alarm1 (seconds and minutes after register address)
+    ASSERT_TRUE(CircEventQueue::insert(&queue, T0 + 240, false, 0));
+    ASSERT_FALSE(queue.events[0].minute_alarm);
+    ASSERT_EQ(0x00, queue.events[0].alarm.buf[1]);
+    ASSERT_EQ(0x04, queue.events[0].alarm.buf[2]);
+
+    ASSERT_TRUE(CircEventQueue::insert(&queue, T0 + 600, true, 0));
+    ASSERT_TRUE(queue.events[1].minute_alarm);
+    // Other zone in the same minute: Alarm2 flag is already cleared by then
+    ASSERT_TRUE(CircEventQueue::insert(&queue, T0 + 630, true, 1));
+    ASSERT_FALSE(queue.events[2].minute_alarm);
+    // Event in between is signalled after the first one, the following one after it
+    ASSERT_TRUE(CircEventQueue::insert(&queue, T0 + 590, false, 1));
+    ASSERT_TRUE(queue.events[1].minute_alarm);
+    ASSERT_EQ(T0 + 600, queue.events[2].time);
+    ASSERT_TRUE(queue.events[2].minute_alarm);
+    ASSERT_FALSE(queue.events[3].minute_alarm);
+
+    // Predecessor of a new head is the last popped event
+    CircEventQueue::pop(&queue);
+    CircEventQueue::pop(&queue);
+    CircEventQueue::pop(&queue);
+    CircEventQueue::pop(&queue);
+    ASSERT_TRUE(CircEventQueue::insert(&queue, T0 + 700, false, 0));
+    ASSERT_TRUE(queue.events[0].minute_alarm);
+    // More than an hour later
+    CircEventQueue::pop(&queue);
+    ASSERT_TRUE(CircEventQueue::insert(&queue, T0 + 700 + DateTime::ONE_HOUR, true, 0));
+    ASSERT_FALSE(queue.events[0].minute_alarm);
+}
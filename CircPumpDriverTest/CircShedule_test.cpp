@@ -37,3 +37,47 @@ TEST(Check_getNextOnTime,positive)
    ASSERT_EQ(CircShedule::getNextOnTime(&shedule_table, DateTime::getEpochFromDateTime(2017, 1, 10, 22, 40, 2)) /* Tue */, DateTime::getEpochFromDateTime(2017, 1,11, 23, 55, 0) );
 }
 
+
+TEST(Check_getNextPulseTime,positive)
+{
+    const circ_shedule_table_t shedule_table = {
+            /* Monday */    { { CT( 6, 0, 0 ), CT( 22, 0, 0 ) }, },
+            /* Tuesday */   { { CT( 6, 0, 0 ), CT( 22, 0, 0 ) }, },
+            /* Wednesday */ { { CT( 6, 0, 0 ), CT( 22, 0, 0 ) }, },
+            /* Thursay */   { { CT( 6, 0, 0 ), CT( 22, 0, 0 ) }, },
+            /* Friday */    { { CT( 6, 0, 0 ), CT( 22, 0, 0 ) }, },
+            /* Saturday */  { { CT( 8, 0, 0 ), CT( 22, 0, 0 ) }, },
+            /* Sunday */    { { CT( 8, 0, 0 ), CT( 22, 0, 0 ) }, },
+            /* Holiday */   { { CT( 8, 0, 0 ), CT( 22, 0, 0 ) }, }
+    };
+    const circ_pulse_config_t pulse = { 4*60, 6*60, 1*60, 9*60 };
+    // Thu 2017-01-05 12:00 local
+    const uint32_t now = DateTime::getUtcDateTimeFromLocal(DateTime::getEpochFromDateTime(2017, 1, 5, 12, 0, 0));
+
+    // Longer first pulse after break
+    ASSERT_EQ(CircShedule::getNextPulseOffTime(&pulse, now, now - 2*6*60 - 1), now + 4*60 );
+    ASSERT_EQ(CircShedule::getNextPulseOffTime(&pulse, now, now - 2*6*60), now + 1*60 );
+    ASSERT_EQ(CircShedule::getNextPulseOnTime(&shedule_table, &pulse, now, now - 1*60), now + 9*60 );
+    ASSERT_EQ(CircShedule::getNextPulseOnTime(&shedule_table, &pulse, now, now - 12*60 - 1), now + 6*60 );
+
+    // Break at the end of on-window till the next one
+    const uint32_t late = DateTime::getUtcDateTimeFromLocal(DateTime::getEpochFromDateTime(2017, 1, 5, 21, 55, 0));
+    ASSERT_EQ(CircShedule::getNextPulseOnTime(&shedule_table, &pulse, late, late - 1*60),
+              DateTime::getUtcDateTimeFromLocal(DateTime::getEpochFromDateTime(2017, 1, 6, 8, 0, 0)) /* Hol */ );
+}
+
+TEST(Check_getNextOnTime,empty_days)
+{
+    // Learned tables may have days without on-window
+    const circ_shedule_table_t shedule_table = {
+            /* Monday */    { { CT( 7, 0, 0 ), CT(  7,30, 0 ) }, },
+            /* Tuesday */   { },
+            /* Wednesday */ { },
+            /* Thursay */   { { CT(19, 0, 0 ), CT( 20, 0, 0 ) }, },
+    };
+    const circ_shedule_table_t empty_table = { };
+
+    ASSERT_EQ(CircShedule::getNextOnTime(&shedule_table, DateTime::getEpochFromDateTime(2017, 1, 9, 8, 0, 1)) /* Mon */, DateTime::getEpochFromDateTime(2017, 1, 12, 19, 0, 1) );
+    ASSERT_EQ(CircShedule::getNextOnTime(&shedule_table, DateTime::getEpochFromDateTime(2017, 1, 12, 21, 0, 0)) /* Thu */, DateTime::getEpochFromDateTime(2017, 1, 16, 7, 0, 0) );
+    ASSERT_EQ(CircShedule::getNextOnTime(&empty_table, DateTime::getEpochFromDateTime(2017, 1, 9, 8, 0, 0)), (uint32_t)DateTime::EPOCH_ERROR );
+}
@@ -0,0 +1,64 @@
+/*
+ * CircThermal_test.cpp
+ *
+ *  NTC conversion checked against its B equation, pulse gating by return temperature
+ */
+
+#include <gtest/gtest.h>
+#include "CircThermal.h"
+#include "PipeModel.h"
+
+static const circ_thermal_config_t config = { CIRC_TEMP(40), CIRC_TEMP(45), 0x01 };
+
+TEST(CircThermal,getTemperature)
+{
+    // Within half a degree and ADC step from 0 to 100 degrees
+    for (int deg = 0; deg <= 100; deg++) {
+        int16_t temperature = CircThermal::getTemperature(PipeModel::getNtcAdc(deg));
+        EXPECT_NEAR(CIRC_TEMP(deg), temperature, 3) << deg;
+    }
+    EXPECT_EQ(0, CircThermal::getTemperature(PipeModel::getNtcAdc(-10)));
+    EXPECT_EQ(CIRC_TEMP(100), CircThermal::getTemperature(PipeModel::getNtcAdc(110)));
+
+    EXPECT_EQ(CircThermal::TEMP_ERROR, CircThermal::getTemperature(1023));
+    EXPECT_EQ(CircThermal::TEMP_ERROR, CircThermal::getTemperature(0));
+}
+
+TEST(CircThermal,updatePulse)
+{
+    // Cold loop, pulse runs till stop temperature
+    circ_pulse_state_t state = CircThermal::updatePulse(&config, CIRC_PULSE_IDLE, true, CIRC_TEMP(30));
+    EXPECT_EQ(CIRC_PULSE_RUNNING, state);
+    state = CircThermal::updatePulse(&config, state, true, CIRC_TEMP(44));
+    EXPECT_EQ(CIRC_PULSE_RUNNING, state);
+    state = CircThermal::updatePulse(&config, state, true, CIRC_TEMP(45));
+    EXPECT_EQ(CIRC_PULSE_DONE, state);
+    // Stays off till the end of the pulse
+    state = CircThermal::updatePulse(&config, state, true, CIRC_TEMP(30));
+    EXPECT_EQ(CIRC_PULSE_DONE, state);
+    EXPECT_EQ(CIRC_PULSE_IDLE, CircThermal::updatePulse(&config, state, false, CIRC_TEMP(30)));
+
+    // Warm loop
+    EXPECT_EQ(CIRC_PULSE_DONE, CircThermal::updatePulse(&config, CIRC_PULSE_IDLE, true, CIRC_TEMP(40)));
+
+    // No sensor
+    EXPECT_EQ(CIRC_PULSE_RUNNING, CircThermal::updatePulse(&config, CIRC_PULSE_IDLE, true, CircThermal::TEMP_ERROR));
+    EXPECT_EQ(CIRC_PULSE_RUNNING, CircThermal::updatePulse(&config, CIRC_PULSE_RUNNING, true, CircThermal::TEMP_ERROR));
+    EXPECT_EQ(CIRC_PULSE_IDLE, CircThermal::updatePulse(&config, CIRC_PULSE_IDLE, false, CircThermal::TEMP_ERROR));
+}
+
+TEST(CircThermal,sensor_zones)
+{
+    EXPECT_TRUE(CircThermal::hasSensor(&config, 0));
+    EXPECT_FALSE(CircThermal::hasSensor(&config, 1));
+    EXPECT_FALSE(CircThermal::hasSensor(&config, 7));
+
+    // Hot loop of zone 1 is not read, as firmware does, pulse runs through
+    const uint8_t zone = 1;
+    circ_pulse_state_t state = CIRC_PULSE_IDLE;
+    for (int deg : { 50, 60, 30 }) {
+        int16_t temperature = CircThermal::hasSensor(&config, zone) ? CIRC_TEMP(deg) : CircThermal::TEMP_ERROR;
+        state = CircThermal::updatePulse(&config, state, true, temperature);
+        EXPECT_EQ(CIRC_PULSE_RUNNING, state) << deg;
+    }
+}
@@ -0,0 +1,117 @@
+/*
+ * DS3231Drv_test.cpp
+ *
+ *  Driver logic checked against in-memory bus
+ */
+
+#include <stdio.h>
+#include <gtest/gtest.h>
+#include "DateTime.h"
+#include "DS3231Drv.h"
+
+typedef DS3231DrvT<MemoryI2cBus> Drv;
+
+static void resetRtc()
+{
+    MemoryI2cBus::reset(0x68);
+    // OSF, A2F, A1F in status register
+    MemoryI2cBus::flags_reg = 0x0F;
+    MemoryI2cBus::flags_mask = 0x83;
+    Drv::begin();
+}
+
+TEST(DS3231Drv,datetime_round_trip)
+{
+    resetRtc();
+    uint32_t epoch = DateTime::getEpochFromDateTime(2017, 10, 29, 1, 59, 58);
+    ASSERT_TRUE( Drv::setDateTime(epoch) );
+    // BCD in registers
+    ASSERT_EQ( MemoryI2cBus::regs[0x00], 0x58 );
+    ASSERT_EQ( MemoryI2cBus::regs[0x01], 0x59 );
+    ASSERT_EQ( MemoryI2cBus::regs[0x05], 0x10 );
+    ASSERT_EQ( MemoryI2cBus::regs[0x06], 0x17 );
+
+    DS3231_snapshot_t snapshot;
+    MemoryI2cBus::regs[0x11] = 0x19;
+    MemoryI2cBus::regs[0x12] = 0x40;
+    ASSERT_TRUE( Drv::readSnapshot(&snapshot, true) );
+    ASSERT_EQ( DateTime::getEpochFromDateTime(&snapshot.date, &snapshot.time), epoch );
+    ASSERT_EQ( snapshot.temperature, 25*4 + 1 );
+}
+
+TEST(DS3231Drv,alarm_set_in_single_write)
+{
+    resetRtc();
+    MemoryI2cBus::regs[0x0F] = 0x03; // A1F, A2F
+    unsigned writes = MemoryI2cBus::writes;
+
+    ASSERT_TRUE( Drv::setAlarm1(0, 6, 30, 0, DS3231_MATCH_H_M_S) );
+    ASSERT_EQ( MemoryI2cBus::writes - writes, 1u );
+    ASSERT_EQ( MemoryI2cBus::regs[0x07], 0x00 );
+    ASSERT_EQ( MemoryI2cBus::regs[0x08], 0x30 );
+    ASSERT_EQ( MemoryI2cBus::regs[0x09], 0x06 );
+    ASSERT_EQ( MemoryI2cBus::regs[0x0A], 0x80 );
+    ASSERT_EQ( MemoryI2cBus::regs[0x0E] & 0x01, 0x01 ); // A1IE
+    ASSERT_EQ( MemoryI2cBus::regs[0x0F], 0x02 );        // Only A1F cleared
+    ASSERT_TRUE( Drv::isArmed1() );
+
+    // Nothing changed, nothing to write
+    writes = MemoryI2cBus::writes;
+    ASSERT_TRUE( Drv::armAlarm1(true) );
+    ASSERT_EQ( MemoryI2cBus::writes, writes );
+}
+
+TEST(DS3231Drv,osf_kept_by_alarm_clear)
+{
+    resetRtc();
+    ASSERT_TRUE( Drv::setDateTime(DateTime::getEpochFromDateTime(2017, 10, 29, 6, 30, 0)) );
+    MemoryI2cBus::regs[0x0F] = 0x01; // A1F
+    DS3231_snapshot_t snapshot;
+    ASSERT_TRUE( Drv::readSnapshot(&snapshot, true) );
+    // Oscillator stopped after the snapshot
+    MemoryI2cBus::regs[0x0F] |= 0x80;
+    unsigned reads = MemoryI2cBus::reads;
+
+    ASSERT_TRUE( Drv::clearAlarm1() );
+    ASSERT_EQ( MemoryI2cBus::reads, reads );            // Written from shadow
+    ASSERT_EQ( MemoryI2cBus::regs[0x0F] & 0x81, 0x80 ); // OSF kept, A1F cleared
+}
+
+TEST(DS3231Drv,bus_error_reported)
+{
+    resetRtc();
+    MemoryI2cBus::fail_countdown = 1;
+    dt_date_t d;
+    dt_time_t t;
+    ASSERT_FALSE( Drv::getDateTime(&d, &t) );
+    MemoryI2cBus::address = 0x50;
+    ASSERT_FALSE( Drv::clearAlarm1() );
+    Drv::recoverBus();
+
+    i2c_bus_stats_t stats;
+    Drv::getBusStats(&stats);
+    ASSERT_EQ( stats.nacks, 2u );
+    ASSERT_EQ( stats.timeouts, 0u );
+    ASSERT_EQ( stats.recoveries, 1u );
+}
+
+TEST(DS3231Drv,aging_offset)
+{
+    resetRtc();
+    MemoryI2cBus::regs[0x10] = 0xF6;
+    int8_t offset = 0;
+    ASSERT_TRUE( Drv::readAgingOffset(&offset) );
+    ASSERT_EQ( offset, -10 );
+
+    // New offset is used after forced conversion
+    ASSERT_TRUE( Drv::writeAgingOffset(25) );
+    ASSERT_EQ( MemoryI2cBus::regs[0x10], 25 );
+    ASSERT_EQ( MemoryI2cBus::regs[0x0E] & 0x20, 0x20 );
+
+    // 0.1ppm per LSB, fast clock needs bigger offset
+    ASSERT_EQ( Drv::computeAgingOffset(0, 3449), 34 );
+    ASSERT_EQ( Drv::computeAgingOffset(0, 3450), 35 );
+    ASSERT_EQ( Drv::computeAgingOffset(10, -1260), -3 );
+    ASSERT_EQ( Drv::computeAgingOffset(120, 2000), 127 );
+    ASSERT_EQ( Drv::computeAgingOffset(-120, -2000), -128 );
+}
@@ -0,0 +1,184 @@
+/*
+ * DS3231Emu_test.cpp
+ *
+ *  DS3231Drv over TwiAsync/TwiFake against DS3231 model
+ */
+
+#include <stdio.h>
+#include <gtest/gtest.h>
+#include "DateTime.h"
+#include "DS3231Drv.h"
+#include "DS3231Emu.h"
+
+typedef DS3231DrvT<TwiAsyncBus> Drv;
+
+static DS3231Emu rtc;
+
+static void resetRtc(uint32_t epoch)
+{
+    rtc.powerOn();
+    rtc.setDateTime(epoch);
+    TwiFake::detachAll();
+    TwiFake::setLatency(0);
+    TwiFake::attach(DS3231Emu::ADDRESS, &rtc);
+    Drv::begin();
+}
+
+static uint32_t readEpoch()
+{
+    dt_date_t d;
+    dt_time_t t;
+    EXPECT_TRUE( Drv::getDateTime(&d, &t) );
+    return DateTime::getEpochFromDateTime(&d, &t);
+}
+
+TEST(DS3231Emu,timekeeping_rollover)
+{
+    // Leap day, end of year
+    resetRtc( DateTime::getEpochFromDateTime(2024, 2, 28, 23, 59, 59) );
+    rtc.advance(1000);
+    ASSERT_EQ( readEpoch(), DateTime::getEpochFromDateTime(2024, 2, 29, 0, 0, 0) );
+
+    resetRtc( DateTime::getEpochFromDateTime(2017, 12, 31, 23, 59, 58) );
+    rtc.advance(2500);
+    ASSERT_EQ( readEpoch(), DateTime::getEpochFromDateTime(2018, 1, 1, 0, 0, 0) );
+    rtc.advance(500);
+    ASSERT_EQ( readEpoch(), DateTime::getEpochFromDateTime(2018, 1, 1, 0, 0, 1) );
+}
+
+TEST(DS3231Emu,osf_survives_until_cleared)
+{
+    resetRtc( DateTime::getEpochFromDateTime(2017, 10, 29, 0, 50, 0) );
+    bool osf = false;
+    ASSERT_TRUE( Drv::readOscilatorStopFlag(osf) );
+    ASSERT_TRUE( osf );
+    ASSERT_TRUE( Drv::clearOscilatorStopFlag() );
+    ASSERT_TRUE( Drv::readOscilatorStopFlag(osf) );
+    ASSERT_FALSE( osf );
+
+    rtc.stopOscillator();
+    rtc.advance(5000);
+    ASSERT_TRUE( Drv::readOscilatorStopFlag(osf) );
+    ASSERT_TRUE( osf );
+    ASSERT_EQ( readEpoch(), DateTime::getEpochFromDateTime(2017, 10, 29, 0, 50, 0) );
+}
+
+TEST(DS3231Emu,alarm1_match_modes)
+{
+    resetRtc( DateTime::getEpochFromDateTime(2017, 10, 29, 6, 29, 58) );   // Sunday
+    ASSERT_TRUE( Drv::clearOscilatorStopFlag() );
+
+    ASSERT_TRUE( Drv::setAlarm1(29, 6, 30, 0, DS3231_MATCH_DT_H_M_S) );
+    rtc.advance(1000);
+    ASSERT_FALSE( Drv::isAlarm1() );
+    ASSERT_FALSE( rtc.isInterrupt() );
+    rtc.advance(1000);
+    ASSERT_TRUE( rtc.isInterrupt() );
+    ASSERT_TRUE( Drv::isAlarm1() );
+    ASSERT_FALSE( rtc.isInterrupt() );
+
+    // Day of week: Sunday is 7
+    ASSERT_TRUE( Drv::setAlarm1(6, 6, 30, 5, DS3231_MATCH_DY_H_M_S) );
+    rtc.advance(5000);
+    ASSERT_FALSE( Drv::isAlarm1() );
+    ASSERT_TRUE( Drv::setAlarm1(7, 6, 30, 10, DS3231_MATCH_DY_H_M_S) );
+    rtc.advance(5000);
+    ASSERT_TRUE( Drv::isAlarm1() );
+
+    ASSERT_TRUE( Drv::setAlarm1(0, 0, 0, 0, DS3231_EVERY_SECOND) );
+    rtc.advance(1000);
+    ASSERT_TRUE( Drv::isAlarm1() );
+    rtc.advance(1000);
+    ASSERT_TRUE( Drv::isAlarm1() );
+}
+
+TEST(DS3231Emu,alarm2_match_modes)
+{
+    resetRtc( DateTime::getEpochFromDateTime(2017, 10, 29, 6, 29, 30) );
+    ASSERT_TRUE( Drv::setAlarm2(0, 0, 0, DS3231_EVERY_MINUTE) );
+    ASSERT_EQ( rtc.getReg(0x0B), 0x80 );
+    ASSERT_EQ( rtc.getReg(0x0C), 0x80 );
+    ASSERT_EQ( rtc.getReg(0x0D), 0x80 );
+    rtc.advance(29000);
+    ASSERT_FALSE( Drv::isAlarm2() );
+    rtc.advance(1000);
+    ASSERT_TRUE( rtc.isInterrupt() );
+    ASSERT_TRUE( Drv::isAlarm2() );
+
+    // Minute match: once per hour, Alarm1 is not affected
+    ASSERT_TRUE( Drv::setAlarm2(0, 0, 32, DS3231_MATCH_M) );
+    rtc.advance(60000);
+    ASSERT_FALSE( Drv::isAlarm2() );
+    rtc.advance(60000);
+    ASSERT_TRUE( Drv::isAlarm2() );
+    ASSERT_FALSE( Drv::isAlarm1() );
+
+    // Disarmed alarm still sets its flag, only interrupt output is masked
+    ASSERT_TRUE( Drv::setAlarm2(0, 0, 0, DS3231_EVERY_MINUTE, false) );
+    rtc.advance(60000);
+    ASSERT_FALSE( rtc.isInterrupt() );
+    ASSERT_TRUE( Drv::isAlarm2() );
+}
+
+TEST(DS3231Emu,failed_batch_is_repeated_after_recovery)
+{
+    resetRtc( DateTime::getEpochFromDateTime(2017, 10, 29, 6, 29, 30) );
+    ASSERT_TRUE( Drv::clearOscilatorStopFlag() );
+    ASSERT_FALSE( Drv::isArmed1() );
+
+    Drv::beginBatch();
+    ASSERT_TRUE( Drv::armAlarm1(true) );
+    ASSERT_TRUE( Drv::armAlarm2(true) );
+    TwiFake::stickBus();
+    ASSERT_FALSE( Drv::commitBatch() );
+    ASSERT_EQ( rtc.getReg(0x0E) & 0x03, 0x00 );
+
+    Drv::recoverBus();
+    ASSERT_TRUE( Drv::commitBatch() );
+    ASSERT_EQ( rtc.getReg(0x0E) & 0x03, 0x03 );
+
+    // Glitch on address byte
+    TwiFake::failNext(1);
+    dt_date_t d;
+    dt_time_t t;
+    ASSERT_FALSE( Drv::getDateTime(&d, &t) );
+    Drv::recoverBus();
+    ASSERT_EQ( readEpoch(), DateTime::getEpochFromDateTime(2017, 10, 29, 6, 29, 30) );
+}
+
+TEST(DS3231Emu,bus_cost)
+{
+    resetRtc( DateTime::getEpochFromDateTime(2017, 10, 29, 6, 29, 30) );
+    rtc.resetStats();
+    DS3231_snapshot_t snapshot;
+    ASSERT_TRUE( Drv::readSnapshot(&snapshot) );
+    // START+addr, reg, RESTART+addr, 16 bytes, STOP
+    ASSERT_EQ( rtc.transactions, 2u );
+    ASSERT_EQ( rtc.bytes_read, 16u );
+    ASSERT_EQ( rtc.bus_clocks, 10u + 9u + 10u + 16u * 9u + 1u );
+    ASSERT_EQ( rtc.getBusTimeUs(), 1740u );
+}
+
+TEST(DS3231Emu,state_restore_continues_identically)
+{
+    resetRtc( DateTime::getEpochFromDateTime(2017, 10, 29, 0, 59, 30) );
+    rtc.setDrift(12345);
+    rtc.setReg(0x10, 0x05);     // Aging offset
+    ASSERT_TRUE( Drv::setAlarm2(0, 0, 0, DS3231_EVERY_MINUTE, false) );
+    rtc.advance(65432);
+
+    ds3231_emu_state_t state;
+    rtc.getState(&state);
+    DS3231Emu copy;
+    copy.setState(&state);
+
+    // Drift remainder and conversion phase are carried over
+    rtc.advance(3600 * 1000 + 777);
+    copy.advance(3600 * 1000 + 777);
+    ASSERT_EQ( copy.getDateTime(), rtc.getDateTime() );
+    ASSERT_EQ( copy.getSubSecondMs(), rtc.getSubSecondMs() );
+    ASSERT_EQ( copy.getUptimeMs(), rtc.getUptimeMs() );
+    for (uint8_t reg = 0; reg < DS3231Emu::REG_COUNT; reg++) {
+        ASSERT_EQ( copy.getReg(reg), rtc.getReg(reg) ) << "register " << int(reg);
+    }
+}
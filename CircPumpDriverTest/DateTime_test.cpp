@@ -167,6 +167,20 @@ TEST(Check_setDateTimeFromEpoch,positive)
     ASSERT_EQ(    3 , time.hour );
     ASSERT_EQ(   14 , time.minute );
     ASSERT_EQ(    7 , time.second );
+
+    // After 2100, which is not leap
+    DateTime::setDateTimeFromEpoch(4133980800UL, &date, &time);
+    ASSERT_EQ( 2101 , date.year );
+    ASSERT_EQ(    1 , date.month );
+    ASSERT_EQ(    1 , date.day );
+
+    DateTime::setDateTimeFromEpoch(4294967295UL, &date, &time);
+    ASSERT_EQ( 2106 , date.year );
+    ASSERT_EQ(    2 , date.month );
+    ASSERT_EQ(    7 , date.day );
+    ASSERT_EQ(    6 , time.hour );
+    ASSERT_EQ(   28 , time.minute );
+    ASSERT_EQ(   15 , time.second );
 }
 TEST(Check_isHoliday,positive)
 {
@@ -0,0 +1,107 @@
+/*
+ * Dcf77_test.cpp
+ *
+ *  Frames and edges from the synthetic receiver output of the simulator
+ */
+
+#include <gtest/gtest.h>
+#include "Dcf77.h"
+#include "Dcf77Signal.h"
+
+static const uint32_t FROM = DateTime::getEpochFromDateTime(2017, 10, 28, 22, 0, 0);
+
+TEST(Dcf77,decodeFrame)
+{
+    // Across the end of DST and New Year
+    for (uint32_t time = FROM; time < FROM + 2 * DateTime::ONE_DAY; time += 7 * 60) {
+        ASSERT_EQ(time, Dcf77::decodeFrame(Dcf77Signal::encodeFrame(time)));
+    }
+    uint32_t new_year = DateTime::getEpochFromDateTime(2018, 12, 31, 22, 59, 0);
+    ASSERT_EQ(new_year, Dcf77::decodeFrame(Dcf77Signal::encodeFrame(new_year)));
+
+    // Every single bit error is found, except in weather, call and announcement bits
+    const uint64_t frame = Dcf77Signal::encodeFrame(FROM);
+    for (uint8_t bit = 0; bit < Dcf77::FRAME_BITS; bit++) {
+        uint32_t time = Dcf77::decodeFrame(frame ^ (static_cast<uint64_t>(1) << bit));
+        if (bit == 0 || (bit >= 17 && bit != 19)) EXPECT_EQ(UINT32_MAX, time) << static_cast<int>(bit);
+        else                       EXPECT_EQ(FROM, time) << static_cast<int>(bit);
+    }
+}
+
+// Edges of "minutes" minutes from "from_ms", every confirmed time is checked. Returns confirmed minutes.
+static unsigned feed(Dcf77Signal* signal, uint64_t from_ms, unsigned minutes, uint64_t* first_ms)
+{
+    unsigned confirmed = 0;
+    *first_ms = UINT64_MAX;
+    Dcf77::begin();
+    while (signal->getNextEdgeMs() < from_ms + minutes * 60000ULL) {
+        uint64_t ms = signal->getNextEdgeMs();
+        Dcf77::onEdge(static_cast<uint32_t>(ms), signal->popEdge());
+        if (!Dcf77::process()) continue;
+
+        // Pulse starts at the second, delayed by the receiver
+        const dcf77_minute_t* minute = Dcf77::getConfirmed();
+        uint64_t minute_ms = ms - static_cast<uint32_t>(static_cast<uint32_t>(ms) - minute->ms);
+        EXPECT_EQ(minute_ms / 60000 * 60, minute->time);
+        EXPECT_LT(minute_ms % 60000, 100u);
+        if (!confirmed++) *first_ms = ms;
+    }
+    return confirmed;
+}
+
+TEST(Dcf77,clean)
+{
+    Dcf77Signal signal;
+    const uint64_t from_ms = static_cast<uint64_t>(FROM) * 1000 + 12345;
+    signal.begin(from_ms, &Dcf77Signal::CLEAN);
+
+    // Started in the middle of minute, two full frames are needed
+    uint64_t first_ms;
+    EXPECT_EQ(58u, feed(&signal, from_ms, 60, &first_ms));
+    EXPECT_EQ(static_cast<uint64_t>(FROM + 3 * 60 + 1) * 1000, first_ms);
+    EXPECT_EQ(59u, Dcf77::stats.frames);
+    EXPECT_EQ(0u, Dcf77::stats.glitches);
+}
+
+TEST(Dcf77,noisy)
+{
+    Dcf77Signal signal;
+    const uint64_t from_ms = static_cast<uint64_t>(FROM) * 1000;
+    signal.begin(from_ms, &Dcf77Signal::NOISY);
+
+    uint64_t first_ms;
+    EXPECT_GT(feed(&signal, from_ms, 60, &first_ms), 10u);
+    EXPECT_LT(first_ms, from_ms + 15 * 60000);
+    EXPECT_GT(Dcf77::stats.glitches, 0u);
+    EXPECT_EQ(0u, Dcf77::stats.overflows);
+}
+
+TEST(Dcf77,majority)
+{
+    // Second frame differs from the first one, third one agrees with the first one
+    const uint32_t minutes[] = { FROM + 60, FROM + 3 * 60, FROM + 3 * 60, 0 };
+    Dcf77::begin();
+
+    // Last pulse of the minute before, so the first frame is complete
+    uint32_t ms = 1000;
+    Dcf77::onEdge(ms, true);
+    Dcf77::onEdge(ms + 100, false);
+    Dcf77::process();
+    ms += 2000;
+    // Frame is decoded when the second pulse of the next minute starts
+    for (unsigned i = 0; i < 4; i++) {
+        const uint64_t frame = minutes[i] ? Dcf77Signal::encodeFrame(minutes[i]) : 0;
+        bool confirmed = false;
+        for (uint8_t bit = 0; bit < Dcf77::FRAME_BITS; bit++, ms += 1000) {
+            Dcf77::onEdge(ms, true);
+            Dcf77::onEdge(ms + (((frame >> bit) & 1) ? 200 : 100), false);
+            confirmed |= Dcf77::process();
+        }
+        ms += 1000;
+        EXPECT_EQ(i == 3, confirmed) << i;
+    }
+    EXPECT_EQ(FROM + 3 * 60, Dcf77::getConfirmed()->time);
+    EXPECT_EQ(3u, Dcf77::stats.frames);
+    // Incomplete frame before the first minute mark
+    EXPECT_EQ(1u, Dcf77::stats.errors);
+}
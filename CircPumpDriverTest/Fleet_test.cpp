@@ -0,0 +1,112 @@
+/*
+ * Fleet_test.cpp
+ *
+ *  Lockstep fleet checked against plain pulse planner run for every controller
+ */
+
+#include <stdio.h>
+#include <gtest/gtest.h>
+#include "DateTime.h"
+#include "CircShedule.h"
+#include "Fleet.h"
+
+static const circ_shedule_table_t long_windows = {
+        /* Monday */    { { CT( 0, 0, 0 ), CT( 1, 0, 0 ) }, { CT( 3,55, 0 ), CT( 4,55, 0 ) }, { CT(  6,00 , 0 ), CT( 24, 0, 0 ) }, },
+        /* Tuesday */   { { CT( 0, 0, 0 ), CT( 1, 0, 0 ) }, { CT( 3,55, 0 ), CT( 4,55, 0 ) }, { CT(  6,00 , 0 ), CT( 24, 0, 0 ) }, },
+        /* Wednesday */ { { CT( 0, 0, 0 ), CT( 1, 0, 0 ) }, { CT( 3,55, 0 ), CT( 4,55, 0 ) }, { CT(  6,00 , 0 ), CT( 24, 0, 0 ) }, },
+        /* Thursay */   { { CT( 0, 0, 0 ), CT( 1, 0, 0 ) }, { CT( 3,55, 0 ), CT( 4,55, 0 ) }, { CT(  6,00 , 0 ), CT( 24, 0, 0 ) }, },
+        /* Friday */    { { CT( 0, 0, 0 ), CT( 1, 0, 0 ) }, { CT( 3,55, 0 ), CT( 4,55, 0 ) }, { CT(  6,00 , 0 ), CT( 24, 0, 0 ) }, },
+        /* Saturday */  { { CT( 0, 0, 0 ), CT( 3, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, },
+        /* Sunday */    { { CT( 0, 0, 0 ), CT( 2, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, },
+        /* Holiday */   { { CT( 0, 0, 0 ), CT( 3, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 24, 0, 0 ) }, }
+};
+
+static const circ_shedule_table_t short_windows = {
+        /* Monday */    { { CT( 3,55, 0 ), CT( 4,55, 0 ) }, { CT(  6,00 , 0 ), CT(  8,35, 0 ) }, { CT( 16,40, 0 ), CT( 22,40, 0 ) },  },
+        /* Tuesday */   { { CT( 3,55, 0 ), CT( 4,55, 0 ) }, { CT( 16,40 , 0 ), CT( 22,40, 0 ) }, },
+        /* Wednesday */ { { CT(23,55, 0 ), CT(24, 0, 0 ) }, },
+        /* Thursay */   { { CT( 3,55, 0 ), CT( 4,55, 0 ) }, { CT( 16,40 , 0 ), CT( 23,59,59 ) }, },
+        /* Friday */    { { CT( 0, 0, 0 ), CT( 1, 0, 0 ) }, { CT(  3,55 , 0 ), CT(  4,55, 0 ) }, { CT(  7, 0, 0 ), CT( 23,59,59 ) },  },
+        /* Saturday */  { { CT( 0, 0, 0 ), CT( 2, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 23,59,59 ) }, },
+        /* Sunday */    { { CT( 0, 0, 0 ), CT( 2, 0, 0 ) }, { CT(  2,30 , 0 ), CT( 23,59,59 ) }, },
+        /* Holiday */   { { CT( 0, 0, 0 ), CT( 2, 0, 0 ) }, { CT(  8,00 , 0 ), CT( 23,59,59 ) }, }
+};
+
+// Same sequence as setupFirstOn() followed by planNextEvent() of the firmware
+static uint32_t runPlanner(const fleet_profile_t* p, int32_t offset, uint32_t from, uint32_t until, bool* on)
+{
+    uint32_t events = 0;
+    uint32_t rtc = from + offset;
+    uint32_t local = DateTime::getLocalDateTimeFromUtc(rtc);
+    uint32_t on_time = CircShedule::getNextOnTime(p->table, local);
+    uint32_t last_off = 0;
+    *on = (on_time == local);
+    events += *on;
+    uint32_t next = *on ? CircShedule::getNextPulseOffTime(&p->pulse, rtc, 0) : DateTime::getUtcDateTimeFromLocal(on_time);
+
+    while (next - offset < until) {
+        uint32_t now = next;
+        if (*on) {
+            next = CircShedule::getNextPulseOnTime(p->table, &p->pulse, now, last_off);
+            last_off = now;
+        } else {
+            next = CircShedule::getNextPulseOffTime(&p->pulse, now, last_off);
+        }
+        *on = !*on;
+        events++;
+    }
+    return events;
+}
+
+static void checkFleet(uint32_t from, uint32_t days)
+{
+    const fleet_profile_t profiles[] = {
+        { &long_windows,  { 4*60, 6*60, 1*60, 9*60 } },
+        { &short_windows, { 4*60, 6*60, 1*60, 9*60 } },
+        { &long_windows,  { 2*60, 3*60,   30, 5*60 } },
+        { &short_windows, {    7,   11,    3,   13 } },
+    };
+    const int32_t offsets[] = { 0, -30, 17, 3600 };
+    const uint32_t boot_delays[] = { 0, 1, 599, 12345 };
+
+    Fleet fleet;
+    for (const auto& profile : profiles) fleet.addProfile(&profile);
+    for (uint8_t p = 0; p < 4; p++) {
+        for (int32_t offset : offsets) {
+            for (uint32_t boot : boot_delays) fleet.add(p, offset, boot);
+        }
+    }
+
+    const uint32_t until = from + days * DateTime::ONE_DAY;
+    fleet.start(from);
+    fleet.run(until);
+
+    uint64_t total = 0;
+    size_t i = 0;
+    for (uint8_t p = 0; p < 4; p++) {
+        for (int32_t offset : offsets) {
+            for (uint32_t boot : boot_delays) {
+                bool on;
+                uint32_t events = runPlanner(&profiles[p], offset, from + boot, until, &on);
+                ASSERT_EQ( fleet.getRelayEvents(i), events ) << "controller " << i;
+                ASSERT_EQ( fleet.isPumpOn(i), on ) << "controller " << i;
+                total += events;
+                i++;
+            }
+        }
+    }
+    // Switch on at power up is not counted by run()
+    ASSERT_LE( fleet.getStats().relay_events, total );
+    ASSERT_GT( fleet.getStats().relay_events, total - fleet.size() );
+    ASSERT_EQ( fleet.getTime(), until );
+}
+
+TEST(Fleet,matches_planner_over_dst_end)
+{
+    checkFleet(DateTime::getEpochFromDateTime(2017, 10, 25, 12, 0, 0), 10);
+}
+
+TEST(Fleet,matches_planner_over_dst_start)
+{
+    checkFleet(DateTime::getEpochFromDateTime(2018, 3, 22, 0, 0, 0), 10);
+}
@@ -0,0 +1,29 @@
+/*
+ * PipeModel_test.cpp
+ *
+ *  Loop heat loss model of the simulator
+ */
+
+#include <math.h>
+#include <gtest/gtest.h>
+#include "PipeModel.h"
+
+TEST(PipeModel,heat_and_cool)
+{
+    static const pipe_config_t pipe = { 55.0, 20.0, 90.0, 45 * 60.0 };
+    PipeModel model;
+    model.begin(&pipe);
+    EXPECT_DOUBLE_EQ(20.0, model.getReturnTemp());
+
+    // Hot water reaches the tap before the return, loop is hot after a few loop times
+    model.advance(60 * 1000, true);
+    EXPECT_GT(model.getTapTemp(), model.getReturnTemp());
+    model.advance(5 * 60 * 1000, true);
+    EXPECT_NEAR(55.0, model.getTapTemp(), 2.0);
+    EXPECT_NEAR(55.0, model.getReturnTemp(), 3.0);
+
+    // Exponential cooling to ambient
+    double tap = model.getTapTemp();
+    model.advance(45 * 60 * 1000, false);
+    EXPECT_NEAR(20.0 + (tap - 20.0) / M_E, model.getTapTemp(), 0.01);
+}
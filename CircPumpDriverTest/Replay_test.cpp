@@ -0,0 +1,144 @@
+/*
+ * Replay_test.cpp
+ *
+ *  Serial capture parsing and matching of simulated pump transitions
+ */
+
+#include <stdio.h>
+#include <gtest/gtest.h>
+#include "DateTime.h"
+#include "Replay.h"
+
+static uint32_t epoch(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second)
+{
+    return DateTime::getEpochFromDateTime(year, month, day, hour, minute, second);
+}
+
+TEST(Replay,parse_capture)
+{
+    Replay replay;
+    replay.addLine("Initializing Circulation Pump Driver...");
+    replay.addLine("Build date:  2017-Oct-29, Sun, 0:0:0");
+    replay.addLine("RTC date:    2017-Oct-29, Sun, 2:10:0");
+    replay.addLine("Pump is ON:  2017-Oct-29, Sun, 2:10:0");
+    replay.addLine("Temperature: 25.00");
+    replay.addLine("Pump is OFF: 2017-Oct-29, Sun, 2:14:0");
+    // Repeated hour after the end of DST
+    replay.addLine("Pump is ON:  2017-Oct-29, Sun, 2:5:0");
+    replay.addLine("Switching to vacations mode...");
+    replay.addLine("Pump is OFF: 2017-Oct-29, Sun, 2:5:1");
+    replay.addLine("[2017-10-29 08:00:02.250] Switching to work week mode...");
+    replay.addLine("[2017-10-29 08:00:02.250] Pump is ON:  2017-Oct-29, Sun, 8:0:2");
+    replay.addLine("Pump is ON:  2017-Abc-29, Sun, 8:0:2");
+
+    const std::vector<replay_event_t>& events = replay.getEvents();
+    ASSERT_EQ(10u, events.size());
+    EXPECT_EQ(12u, replay.getLines());
+
+    EXPECT_EQ(REPLAY_COLD_BOOT, events[0].type);
+    EXPECT_EQ(REPLAY_BUILD_DATE, events[1].type);
+    EXPECT_EQ(epoch(2017, 10, 29, 0, 0, 0), events[1].time);     // Local
+    EXPECT_EQ(REPLAY_RTC_DATE, events[2].type);
+    EXPECT_EQ(epoch(2017, 10, 29, 0, 10, 0), events[2].time);
+
+    EXPECT_EQ(REPLAY_PUMP, events[3].type);
+    EXPECT_TRUE(events[3].on);
+    EXPECT_EQ(4u, events[3].line);
+    EXPECT_EQ(epoch(2017, 10, 29, 0, 10, 0), events[3].time);
+    EXPECT_EQ(epoch(2017, 10, 29, 0, 14, 0), events[4].time);
+    EXPECT_EQ(epoch(2017, 10, 29, 1, 5, 0), events[5].time);
+
+    EXPECT_EQ(REPLAY_MODE, events[6].type);
+    EXPECT_TRUE(events[6].on);
+    EXPECT_EQ(epoch(2017, 10, 29, 1, 5, 1), events[6].time);
+    EXPECT_EQ(REPLAY_MODE, events[8].type);
+    EXPECT_FALSE(events[8].on);
+    EXPECT_EQ(epoch(2017, 10, 29, 7, 0, 2), events[8].time);
+    EXPECT_EQ(11u, events[9].line);
+
+    EXPECT_EQ(epoch(2017, 10, 29, 0, 10, 0), replay.getFirstTime());
+    EXPECT_EQ(epoch(2017, 10, 29, 7, 0, 2), replay.getLastTime());
+}
+
+// RTC 30s fast corrected by DCF77, pump state is printed again at the corrected time
+TEST(Replay,rtc_set)
+{
+    const uint32_t boot = epoch(2017, 10, 29, 4, 0, 30);
+    Replay replay;
+    replay.addLine("Initializing Circulation Pump Driver...");
+    replay.addLine("RTC date:    2017-Oct-29, Sun, 5:0:30");
+    replay.addLine("Pump is OFF: 2017-Oct-29, Sun, 5:0:30");
+    replay.addLine("DCF77 date:  2017-Oct-29, Sun, 5:0:2");
+    replay.addLine("Pump is OFF: 2017-Oct-29, Sun, 5:0:2");
+    replay.addLine("Pump is ON:  2017-Oct-29, Sun, 8:0:0");
+
+    const std::vector<replay_event_t>& events = replay.getEvents();
+    ASSERT_EQ(6u, events.size());
+    EXPECT_EQ(REPLAY_RTC_SET, events[3].type);
+    EXPECT_EQ(boot - 28, events[3].time);
+    EXPECT_EQ(boot - 28, events[4].time);
+
+    // Transition printed after the correction is earlier than the one before it
+    replay.startMatching(0, 0);
+    EXPECT_TRUE(replay.matchTransition(boot, false));
+    EXPECT_TRUE(replay.matchTransition(boot - 28, false));
+    EXPECT_TRUE(replay.matchUntil(boot + 3600));
+    EXPECT_TRUE(replay.matchTransition(epoch(2017, 10, 29, 7, 0, 0), true));
+    EXPECT_EQ(3u, replay.getMatched());
+    EXPECT_EQ(nullptr, replay.getDivergence());
+}
+
+static void addTransitions(Replay* replay)
+{
+    replay->addLine("Pump is ON:  2017-Nov-6, Mon, 6:0:0");
+    replay->addLine("Pump is OFF: 2017-Nov-6, Mon, 6:4:0");
+    replay->addLine("Pump is ON:  2017-Nov-6, Mon, 6:10:0");
+}
+
+TEST(Replay,match_transitions)
+{
+    const uint32_t on = epoch(2017, 11, 6, 5, 0, 0);
+    Replay replay;
+    addTransitions(&replay);
+
+    replay.startMatching(0, 0);
+    EXPECT_TRUE(replay.matchTransition(on, true));
+    EXPECT_TRUE(replay.matchUntil(on + 240));
+    EXPECT_TRUE(replay.matchTransition(on + 240, false));
+    EXPECT_TRUE(replay.matchTransition(on + 600, true));
+    // After the capture
+    EXPECT_TRUE(replay.matchTransition(on + 840, false));
+    EXPECT_TRUE(replay.matchUntil(on + 1000));
+    EXPECT_EQ(3u, replay.getMatched());
+    EXPECT_EQ(nullptr, replay.getDivergence());
+
+    // Late by one second
+    replay.startMatching(0, 0);
+    EXPECT_TRUE(replay.matchTransition(on, true));
+    EXPECT_FALSE(replay.matchTransition(on + 241, false));
+    ASSERT_NE(nullptr, replay.getDivergence());
+    EXPECT_EQ(2u, replay.getDivergence()->line);
+    EXPECT_EQ(on + 240, replay.getDivergence()->expected_time);
+    EXPECT_EQ(on + 241, replay.getDivergence()->simulated_time);
+    // Further transitions are not matched
+    EXPECT_FALSE(replay.matchTransition(on + 600, true));
+
+    replay.startMatching(1, 0);
+    EXPECT_TRUE(replay.matchTransition(on, true));
+    EXPECT_TRUE(replay.matchTransition(on + 241, false));
+
+    // Missed
+    replay.startMatching(0, 0);
+    EXPECT_TRUE(replay.matchTransition(on, true));
+    EXPECT_FALSE(replay.matchUntil(on + 300));
+    EXPECT_EQ(2u, replay.getDivergence()->line);
+    EXPECT_EQ(UINT32_MAX, replay.getDivergence()->simulated_time);     // EPOCH_ERROR
+
+    // Wrong state, transitions before the capture are ignored
+    replay.startMatching(0, on);
+    EXPECT_TRUE(replay.matchTransition(on - 60, false));
+    EXPECT_FALSE(replay.matchTransition(on, false));
+    EXPECT_EQ(1u, replay.getDivergence()->line);
+    EXPECT_TRUE(replay.getDivergence()->expected_on);
+    EXPECT_FALSE(replay.getDivergence()->simulated_on);
+}
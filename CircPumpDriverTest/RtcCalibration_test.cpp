@@ -0,0 +1,52 @@
+/*
+ * RtcCalibration_test.cpp
+ *
+ *  Drift measurement and aging offset trimming against DS3231 model with drift
+ */
+
+#include <stdio.h>
+#include <gtest/gtest.h>
+#include "DateTime.h"
+#include "DS3231Drv.h"
+#include "DS3231Emu.h"
+#include "RtcCalibration.h"
+
+typedef DS3231DrvT<TwiAsyncBus> Drv;
+
+static DS3231Emu rtc;
+
+static uint64_t nowUs() { return rtc.getUptimeMs() * 1000; }
+static void sleepMs(uint32_t ms) { rtc.advance(ms); }
+static const rtc_reference_t reference = { nowUs, sleepMs };
+
+static void resetRtc(int32_t drift_ppb)
+{
+    rtc.powerOn();
+    rtc.setDateTime( DateTime::getEpochFromDateTime(2017, 10, 29, 0, 50, 0) );
+    rtc.setDrift(drift_ppb);
+    TwiFake::detachAll();
+    TwiFake::setLatency(0);
+    TwiFake::attach(DS3231Emu::ADDRESS, &rtc);
+    Drv::begin();
+}
+
+TEST(RtcCalibration,drift_is_trimmed)
+{
+    rtc_calibration_t result;
+    resetRtc(-4230);
+    rtc.setTemperature(22 * 4);
+
+    ASSERT_TRUE( RtcCalibration<Drv>::measure(&reference, 6 * 3600, &result) );
+    // Seconds edges are found with 1ms resolution
+    ASSERT_NEAR( result.drift_ppb, -4230, 100 );
+    ASSERT_EQ( result.aging_offset, 0 );
+    ASSERT_EQ( result.new_aging_offset, -42 );
+    // Starts at the last conversion before temperature change
+    ASSERT_EQ( result.temperature_min, 22 * 4 );
+    ASSERT_EQ( result.temperature_max, 25 * 4 );
+
+    ASSERT_TRUE( RtcCalibration<Drv>::apply(&result) );
+    ASSERT_TRUE( RtcCalibration<Drv>::measure(&reference, 6 * 3600, &result) );
+    ASSERT_NEAR( result.drift_ppb, 0, 100 );
+    ASSERT_EQ( result.aging_offset, -42 );
+}
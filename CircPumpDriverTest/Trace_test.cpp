@@ -0,0 +1,105 @@
+/*
+ * Trace_test.cpp
+ *
+ *  Trace written and read back, time range lookup through the sparse index
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <gtest/gtest.h>
+#include "Trace.h"
+
+static const char* TRACE_NAME = "Trace_test.trc";
+
+TEST(Trace,round_trip_and_find)
+{
+    TraceWriter writer;
+    ASSERT_TRUE(writer.open(TRACE_NAME));
+    writer.setPinName(2, "PUMP RELAY");
+
+    // Several index strides, two records every 10ms
+    const uint64_t start = 1500000000000ULL;
+    const uint32_t count = 5000;
+    for (uint32_t i = 0; i < count; i++) {
+        writer.pin(start + i * 10, 2, i & 1);
+        const uint8_t data[] = { 0x00, static_cast<uint8_t>(i) };
+        writer.i2c(start + i * 10, 0xD0, true, data, sizeof(data));
+    }
+    const char* text = "Pump is ON:  2017-Nov-6, Mon, 6:0:0";
+    writer.log(start + count * 10, text, strlen(text));
+    writer.alarm(start + count * 10 + 5, 2);
+    ASSERT_TRUE(writer.close());
+
+    TraceReader reader;
+    ASSERT_TRUE(reader.open(TRACE_NAME));
+    EXPECT_STREQ("PUMP RELAY", reader.getPinName(2));
+    // Log text takes 3 records
+    ASSERT_EQ(2 * count + 3 + 1, reader.size());
+
+    for (uint32_t i : { 0u, 1u, 511u, 512u, 513u, 1024u, 4999u }) {
+        uint64_t found = reader.find(start + i * 10);
+        ASSERT_EQ(2 * i, found) << i;
+        EXPECT_EQ(TRACE_PIN, reader[found].type);
+        EXPECT_EQ(i & 1, reader[found].value);
+        EXPECT_EQ(TRACE_I2C, reader[found + 1].type);
+        EXPECT_EQ(2, reader[found + 1].value);
+        EXPECT_EQ(static_cast<uint8_t>(i), reader[found + 1].data[1]);
+    }
+    // Between records
+    EXPECT_EQ(2 * 101u, reader.find(start + 1005));
+    EXPECT_EQ(0u, reader.find(0));
+    EXPECT_EQ(reader.size(), reader.find(start + count * 100));
+
+    char line[64];
+    uint64_t log = reader.find(start + count * 10);
+    EXPECT_EQ(log + 3, reader.getLog(log, line, sizeof(line)));
+    EXPECT_STREQ(text, line);
+    EXPECT_EQ(TRACE_ALARM, reader[log + 3].type);
+    EXPECT_EQ(2, reader[log + 3].arg);
+
+    reader.close();
+    remove(TRACE_NAME);
+}
+
+// RTC set back keeps records in true time order
+TEST(Trace,rtc_set)
+{
+    TraceWriter writer;
+    ASSERT_TRUE(writer.open(TRACE_NAME));
+    const uint64_t start = 1509271200000ULL;
+    writer.pin(start, 2, 1);
+    writer.rtcSet(start + 100, start + 100 - 30000);
+    writer.pin(start + 200, 2, 0);
+    ASSERT_TRUE(writer.close());
+
+    TraceReader reader;
+    ASSERT_TRUE(reader.open(TRACE_NAME));
+    ASSERT_EQ(3u, reader.size());
+    EXPECT_EQ(TRACE_RTC_SET, reader[1].type);
+    EXPECT_EQ(start + 100, reader[1].time_ms);
+    EXPECT_EQ(start + 100 - 30000, TraceReader::getRtcTime(reader[1]));
+    EXPECT_EQ(1u, reader.find(start + 1));
+    EXPECT_EQ(2u, reader.find(start + 200));
+
+    reader.close();
+    remove(TRACE_NAME);
+}
+
+// Only memory mapped traces are readable while being written
+#if defined(__unix__) || defined(__APPLE__)
+TEST(Trace,readable_without_close)
+{
+    {
+        TraceWriter writer;
+        ASSERT_TRUE(writer.open(TRACE_NAME));
+        for (uint32_t i = 0; i < 3000; i++) writer.pin(i * 1000ULL, 0, i & 1);
+        // Writer is still open as after a crash, index is not written
+        TraceReader reader;
+        ASSERT_TRUE(reader.open(TRACE_NAME));
+        EXPECT_EQ(3000u, reader.size());
+        EXPECT_EQ(2048u, reader.find(2048000));
+        EXPECT_EQ(2049u, reader.find(2048001));
+    }
+    remove(TRACE_NAME);
+}
+#endif
@@ -0,0 +1,130 @@
+/*
+ * TwiAsync_test.cpp
+ *
+ *  Request queue and state machine checked against TwiFake backend
+ */
+
+#include <stdio.h>
+#include <gtest/gtest.h>
+#include "TwiAsync.h"
+#include "TwiFake.h"
+
+static TwiFakeRegisters slave;
+static const uint8_t SLAVE_ADDRESS = 0x68;
+
+static unsigned completed_count;
+static twi_async_req_t* completed[8];
+
+static void onDone(twi_async_req_t* req)
+{
+    completed[completed_count++] = req;
+}
+
+static void resetBus(unsigned latency)
+{
+    TwiFake::detachAll();
+    TwiFake::attach(SLAVE_ADDRESS, &slave);
+    TwiFake::setLatency(latency);
+    TwiFake::resetStats();
+    TwiAsync::begin();
+    completed_count = 0;
+}
+
+TEST(TwiAsync,write_then_read_back)
+{
+    resetBus(0);
+    const uint8_t out[3] = { 0x11, 0x22, 0x33 };
+    uint8_t in[3] = {};
+    twi_async_req_t wr, rd;
+
+    TwiAsync::setupWrite(&wr, SLAVE_ADDRESS, 0x07, out, sizeof(out));
+    TwiAsync::setupRead(&rd, SLAVE_ADDRESS, 0x07, in, sizeof(in));
+    ASSERT_TRUE( TwiAsync::transfer(&wr) );
+    ASSERT_TRUE( TwiAsync::transfer(&rd) );
+
+    ASSERT_EQ( slave.regs[0x07], 0x11 );
+    ASSERT_EQ( slave.regs[0x09], 0x33 );
+    ASSERT_EQ( in[0], 0x11 );
+    ASSERT_EQ( in[1], 0x22 );
+    ASSERT_EQ( in[2], 0x33 );
+    // Write: START, read: START + repeated START
+    ASSERT_EQ( TwiFake::transactions, 3u );
+}
+
+TEST(TwiAsync,single_byte_read)
+{
+    resetBus(0);
+    slave.regs[0x0F] = 0x88;
+    slave.regs[0x10] = 0x55;
+    uint8_t in = 0;
+    twi_async_req_t rd;
+
+    TwiAsync::setupRead(&rd, SLAVE_ADDRESS, 0x0F, &in, 1);
+    ASSERT_TRUE( TwiAsync::transfer(&rd) );
+    ASSERT_EQ( in, 0x88 );
+    // Register pointer + one data byte only
+    ASSERT_EQ( TwiFake::bytes, 2u );
+}
+
+TEST(TwiAsync,does_not_block_and_completes_in_order)
+{
+    resetBus(3);
+    const uint8_t a = 0xA5;
+    uint8_t b = 0;
+    twi_async_req_t wr, rd, missing;
+
+    TwiAsync::setupWrite(&wr, SLAVE_ADDRESS, 0x20, &a, 1, onDone);
+    TwiAsync::setupRead(&rd, SLAVE_ADDRESS, 0x20, &b, 1, onDone);
+    TwiAsync::setupWrite(&missing, 0x50, 0x00, &a, 1, onDone);
+
+    ASSERT_TRUE( TwiAsync::submit(&wr) );
+    ASSERT_TRUE( TwiAsync::submit(&rd) );
+    ASSERT_TRUE( TwiAsync::submit(&missing) );
+    ASSERT_FALSE( TwiAsync::submit(&rd) );
+
+    // Every bus event is delayed, so submit() only starts the first transfer
+    ASSERT_EQ( completed_count, 0u );
+    ASSERT_EQ( wr.status, TWI_ASYNC_BUSY );
+    ASSERT_EQ( rd.status, TWI_ASYNC_QUEUED );
+    ASSERT_FALSE( TwiAsync::isIdle() );
+
+    for (unsigned i = 0; i < 100 && !TwiAsync::isIdle(); i++) {
+        TwiAsync::service();
+    }
+
+    ASSERT_TRUE( TwiAsync::isIdle() );
+    ASSERT_EQ( completed_count, 3u );
+    ASSERT_EQ( completed[0], &wr );
+    ASSERT_EQ( completed[1], &rd );
+    ASSERT_EQ( completed[2], &missing );
+    ASSERT_EQ( wr.status, TWI_ASYNC_DONE );
+    ASSERT_EQ( rd.status, TWI_ASYNC_DONE );
+    ASSERT_EQ( missing.status, TWI_ASYNC_NACK );
+    ASSERT_EQ( b, 0xA5 );
+}
+
+TEST(TwiAsync,stuck_bus_is_recovered)
+{
+    resetBus(0);
+    uint8_t in[2];
+    twi_async_req_t rd, queued;
+    twi_async_stats_t stats = TwiAsync::stats;
+
+    TwiFake::stickBus();
+    TwiAsync::setupRead(&rd, SLAVE_ADDRESS, 0x00, in, sizeof(in));
+    TwiAsync::setupRead(&queued, SLAVE_ADDRESS, 0x00, in, sizeof(in), onDone);
+    ASSERT_TRUE( TwiAsync::submit(&rd) );
+    ASSERT_TRUE( TwiAsync::submit(&queued) );
+
+    // Times out, recovery aborts also queued requests
+    ASSERT_FALSE( TwiAsync::wait(&rd) );
+    ASSERT_EQ( rd.status, TWI_ASYNC_ERROR );
+    ASSERT_EQ( queued.status, TWI_ASYNC_ERROR );
+    ASSERT_EQ( completed_count, 1u );
+    ASSERT_FALSE( TwiFake::isStuck() );
+    ASSERT_EQ( TwiFake::recoveries, 1u );
+    ASSERT_EQ( TwiAsync::stats.timeouts, stats.timeouts + 1 );
+    ASSERT_EQ( TwiAsync::stats.recoveries, stats.recoveries + 1 );
+
+    ASSERT_TRUE( TwiAsync::transfer(&rd) );
+}
@@ -0,0 +1,47 @@
+/*
+ * Verify_test.cpp
+ *
+ *  DateTime checked against the reference algorithms around DST changes and February 29
+ */
+
+#include <stdio.h>
+#include <gtest/gtest.h>
+#include "DateTime.h"
+#include "Verify.h"
+
+static void expectPassed(const verify_result_t& result)
+{
+    for (int check = 0; check < VERIFY_CHECKS; check++) {
+        EXPECT_EQ(0u, result.failures[check]) << Verify::getCheckName(static_cast<verify_check_t>(check))
+                                              << " first at " << result.first_failure[check];
+    }
+}
+
+TEST(Verify,dst_changes)
+{
+    verify_result_t result;
+    // 2017-03-25 .. 2017-03-27
+    Verify::checkRange(1490400000UL, 1490659199UL, &result);
+    EXPECT_EQ(3u * DateTime::ONE_DAY, result.seconds);
+    expectPassed(result);
+
+    // 2017-10-28 .. 2017-10-30, in two threads
+    Verify::checkRangeParallel(1509148800UL, 1509407999UL, 2, &result);
+    EXPECT_EQ(3u * DateTime::ONE_DAY, result.seconds);
+    expectPassed(result);
+}
+
+TEST(Verify,leap_days)
+{
+    verify_result_t result;
+    // 2100-02-28 .. 2100-03-01
+    Verify::checkRange(4107456000UL, 4107628799UL, &result);
+    expectPassed(result);
+    // 2104-02-28 12:00 .. 2104-03-01 12:00
+    Verify::checkRange(4233643200UL, 4233816000UL, &result);
+    EXPECT_EQ(2u * DateTime::ONE_DAY + 1, result.seconds);
+    expectPassed(result);
+    // End of the range, local time does not fit
+    Verify::checkRange(UINT32_MAX - DateTime::ONE_HOUR, UINT32_MAX, &result);
+    expectPassed(result);
+}